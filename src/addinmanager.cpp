@@ -111,6 +111,7 @@ namespace {
   AddinManager::~AddinManager()
   {
     sharp::map_delete_all_second(m_app_addins);
+    sharp::map_delete_all_second(m_note_addin_hooks);
     for(NoteAddinMap::const_iterator iter = m_note_addins.begin();
         iter != m_note_addins.end(); ++iter) {
       sharp::map_delete_all_second(iter->second);
@@ -178,6 +179,14 @@ namespace {
       m_note_addin_infos.erase(iter);
     }
 
+    {
+      const IdHookMap::iterator iter = m_note_addin_hooks.find(id);
+      if(m_note_addin_hooks.end() != iter) {
+        delete iter->second;
+        m_note_addin_hooks.erase(iter);
+      }
+    }
+
     {
       for(NoteAddinMap::iterator iter = m_note_addins.begin();
           iter != m_note_addins.end(); ++iter) {
@@ -267,12 +276,14 @@ namespace {
     }
     if(settings->get_boolean(Preferences::ENABLE_AUTO_LINKS)) {
       REGISTER_BUILTIN_NOTE_ADDIN(NoteLinkWatcher);
+      add_note_addin_hook(typeid(NoteLinkWatcher).name(), NoteLinkWatcher::create_manager_hook(m_note_manager));
     }
     if(settings->get_boolean(Preferences::ENABLE_WIKIWORDS)) {
       REGISTER_BUILTIN_NOTE_ADDIN(NoteWikiWatcher);
     }
     REGISTER_BUILTIN_NOTE_ADDIN(MouseHandWatcher);
     REGISTER_BUILTIN_NOTE_ADDIN(NoteTagsWatcher);
+    add_note_addin_hook(typeid(NoteTagsWatcher).name(), NoteTagsWatcher::create_manager_hook(m_note_manager));
     REGISTER_BUILTIN_NOTE_ADDIN(notebooks::NotebookNoteAddin);
    
     REGISTER_APP_ADDIN(notebooks::NotebookApplicationAddin);
@@ -343,10 +354,22 @@ namespace {
     return AddinInfo();
   }
 
+  void AddinManager::add_note_addin_hook(const std::string & id, NoteAddinManagerHook *hook)
+  {
+    IdHookMap::iterator iter = m_note_addin_hooks.find(id);
+    if(m_note_addin_hooks.end() != iter) {
+      delete iter->second;
+      iter->second = hook;
+    }
+    else {
+      m_note_addin_hooks.insert(std::make_pair(id, hook));
+    }
+  }
+
   void AddinManager::load_addins_for_note(const Note::Ptr & note)
   {
+    // Addins are loaded on demand, so this is called repeatedly
     if(m_note_addins.find(note) != m_note_addins.end()) {
-      ERR_OUT(_("Trying to load addins when they are already loaded"));
       return;
     }
     IdAddinMap loaded_addins;
@@ -370,6 +393,19 @@ namespace {
     }
   }
 
+  NoteAddin *AddinManager::get_note_addin(const Note::Ptr & note, const std::string & id) const
+  {
+    NoteAddinMap::const_iterator iter = m_note_addins.find(note);
+    if(m_note_addins.end() == iter) {
+      return NULL;
+    }
+    IdAddinMap::const_iterator addin = iter->second.find(id);
+    if(iter->second.end() == addin) {
+      return NULL;
+    }
+    return addin->second;
+  }
+
   ApplicationAddin * AddinManager::get_application_addin(
                                      const std::string & id) const
   {
@@ -558,6 +594,10 @@ namespace {
   {
     SETUP_NOTE_ADDIN(key, Preferences::ENABLE_URL_LINKS, NoteUrlWatcher);
     SETUP_NOTE_ADDIN(key, Preferences::ENABLE_AUTO_LINKS, NoteLinkWatcher);
+    if(key == Preferences::ENABLE_AUTO_LINKS && Preferences::obj()
+         .get_schema_settings(Preferences::SCHEMA_GNOTE)->get_boolean(key)) {
+      add_note_addin_hook(typeid(NoteLinkWatcher).name(), NoteLinkWatcher::create_manager_hook(m_note_manager));
+    }
     SETUP_NOTE_ADDIN(key, Preferences::ENABLE_WIKIWORDS, NoteWikiWatcher);
   }
 }
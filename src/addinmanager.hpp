@@ -63,7 +63,9 @@ public:
       return m_addins_prefs_dir;
     }
 
+  /** Create addins for %note, unless already done. */
   void load_addins_for_note(const Note::Ptr &);
+  NoteAddin *get_note_addin(const Note::Ptr & note, const std::string & id) const;
   ApplicationAddin *get_application_addin(const std::string & id) const;
   sync::SyncServiceAddin *get_sync_service_addin(const std::string & id) const;
   void get_preference_tab_addins(std::list<PreferenceTabAddin *> &) const;
@@ -88,6 +90,7 @@ private:
   void load_addin_infos(const std::string & global_path, const std::string & local_path);
   void load_addin_infos(const std::string & path);
   void load_note_addin(const std::string & id, sharp::IfaceFactoryBase *const f);
+  void add_note_addin_hook(const std::string & id, NoteAddinManagerHook *hook);
   void get_enabled_addins(std::list<std::string> & addins) const;
   void initialize_sharp_addins();
   void add_module_addins(const std::string & mod_id, sharp::DynamicModule * dmod);
@@ -112,6 +115,8 @@ private:
   /// TODO: make sure it is removed if the dynamic module is unloaded.
   typedef std::map<std::string, sharp::IfaceFactoryBase*> IdInfoMap;
   IdInfoMap                                m_note_addin_infos;
+  typedef std::map<std::string, NoteAddinManagerHook*> IdHookMap;
+  IdHookMap                                m_note_addin_hooks;
   typedef std::map<std::string, PreferenceTabAddin*> IdPrefTabAddinMap;
   IdPrefTabAddinMap                        m_pref_tab_addins;
   typedef std::map<std::string, sync::SyncServiceAddin*> IdSyncServiceAddinMap;
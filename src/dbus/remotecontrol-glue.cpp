@@ -52,13 +52,16 @@ RemoteControl_adaptor::RemoteControl_adaptor(const Glib::RefPtr<Gio::DBus::Conne
   m_stubs["GetNoteContents"] = &RemoteControl_adaptor::GetNoteContents_stub;
   m_stubs["GetNoteContentsXml"] = &RemoteControl_adaptor::GetNoteContentsXml_stub;
   m_stubs["GetNoteCreateDate"] = &RemoteControl_adaptor::GetNoteCreateDate_stub;
+  m_stubs["GetNoteLinks"] = &RemoteControl_adaptor::GetNoteLinks_stub;
   m_stubs["GetNoteTitle"] = &RemoteControl_adaptor::GetNoteTitle_stub;
+  m_stubs["GetNotesLinkingTo"] = &RemoteControl_adaptor::GetNotesLinkingTo_stub;
   m_stubs["GetTagsForNote"] = &RemoteControl_adaptor::GetTagsForNote_stub;
   m_stubs["HideNote"] = &RemoteControl_adaptor::HideNote_stub;
   m_stubs["ListAllNotes"] = &RemoteControl_adaptor::ListAllNotes_stub;
   m_stubs["NoteExists"] = &RemoteControl_adaptor::NoteExists_stub;
   m_stubs["RemoveTagFromNote"] = &RemoteControl_adaptor::RemoveTagFromNote_stub;
   m_stubs["SearchNotes"] = &RemoteControl_adaptor::SearchNotes_stub;
+  m_stubs["SearchNotesLimited"] = &RemoteControl_adaptor::SearchNotesLimited_stub;
   m_stubs["SetNoteCompleteXml"] = &RemoteControl_adaptor::SetNoteCompleteXml_stub;
   m_stubs["SetNoteContents"] = &RemoteControl_adaptor::SetNoteContents_stub;
   m_stubs["SetNoteContentsXml"] = &RemoteControl_adaptor::SetNoteContentsXml_stub;
@@ -222,12 +225,24 @@ Glib::VariantContainerBase RemoteControl_adaptor::GetNoteCreateDate_stub(const G
 }
 
 
+Glib::VariantContainerBase RemoteControl_adaptor::GetNoteLinks_stub(const Glib::VariantContainerBase & parameters)
+{
+  return stub_vectorstring_string(parameters, &RemoteControl_adaptor::GetNoteLinks);
+}
+
+
 Glib::VariantContainerBase RemoteControl_adaptor::GetNoteTitle_stub(const Glib::VariantContainerBase & parameters)
 {
   return stub_string_string(parameters, &RemoteControl_adaptor::GetNoteTitle);
 }
 
 
+Glib::VariantContainerBase RemoteControl_adaptor::GetNotesLinkingTo_stub(const Glib::VariantContainerBase & parameters)
+{
+  return stub_vectorstring_string(parameters, &RemoteControl_adaptor::GetNotesLinkingTo);
+}
+
+
 Glib::VariantContainerBase RemoteControl_adaptor::GetTagsForNote_stub(const Glib::VariantContainerBase & parameters)
 {
   return stub_vectorstring_string(parameters, &RemoteControl_adaptor::GetTagsForNote);
@@ -264,6 +279,12 @@ Glib::VariantContainerBase RemoteControl_adaptor::SearchNotes_stub(const Glib::V
 }
 
 
+Glib::VariantContainerBase RemoteControl_adaptor::SearchNotesLimited_stub(const Glib::VariantContainerBase & parameters)
+{
+  return stub_vectorstring_string_bool_int(parameters, &RemoteControl_adaptor::SearchNotesLimited);
+}
+
+
 Glib::VariantContainerBase RemoteControl_adaptor::SetNoteCompleteXml_stub(const Glib::VariantContainerBase & parameters)
 {
   return stub_bool_string_string(parameters, &RemoteControl_adaptor::SetNoteCompleteXml);
@@ -412,3 +433,25 @@ Glib::VariantContainerBase RemoteControl_adaptor::stub_vectorstring_string_bool(
   return Glib::VariantContainerBase::create_tuple(Glib::Variant<std::vector<Glib::ustring> >::create(res));
 }
 
+
+Glib::VariantContainerBase RemoteControl_adaptor::stub_vectorstring_string_bool_int(const Glib::VariantContainerBase & parameters,
+                                                                                    vectorstring_string_bool_int_func func)
+{
+  std::vector<Glib::ustring> res;
+  if(parameters.get_n_children() == 3) {
+    Glib::Variant<Glib::ustring> param1;
+    parameters.get_child(param1, 0);
+    Glib::Variant<bool> param2;
+    parameters.get_child(param2, 1);
+    Glib::Variant<int> param3;
+    parameters.get_child(param3, 2);
+    std::vector<std::string> result = (this->*func)(param1.get(), param2.get(), param3.get());
+
+    //work-around glibmm bug 657030
+    for(unsigned i = 0; i < result.size(); ++i) {
+      res.push_back(result[i]);
+    }
+  }
+
+  return Glib::VariantContainerBase::create_tuple(Glib::Variant<std::vector<Glib::ustring> >::create(res));
+}
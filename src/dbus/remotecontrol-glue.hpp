@@ -51,13 +51,17 @@ public:
   virtual std::string GetNoteContents(const std::string& uri) = 0;
   virtual std::string GetNoteContentsXml(const std::string& uri) = 0;
   virtual int32_t GetNoteCreateDate(const std::string& uri) = 0;
+  virtual std::vector<std::string> GetNoteLinks(const std::string& uri) = 0;
   virtual std::string GetNoteTitle(const std::string& uri) = 0;
+  virtual std::vector<std::string> GetNotesLinkingTo(const std::string& uri) = 0;
   virtual std::vector<std::string> GetTagsForNote(const std::string& uri) = 0;
   virtual bool HideNote(const std::string& uri) = 0;
   virtual std::vector<std::string> ListAllNotes() = 0;
   virtual bool NoteExists(const std::string& uri) = 0;
   virtual bool RemoveTagFromNote(const std::string& uri, const std::string& tag_name) = 0;
   virtual std::vector<std::string> SearchNotes(const std::string& query, const bool& case_sensitive) = 0;
+  virtual std::vector<std::string> SearchNotesLimited(const std::string& query, const bool& case_sensitive,
+                                                      const int& max_results) = 0;
   virtual bool SetNoteCompleteXml(const std::string& uri, const std::string& xml_contents) = 0;
   virtual bool SetNoteContents(const std::string& uri, const std::string& text_contents) = 0;
   virtual bool SetNoteContentsXml(const std::string& uri, const std::string& xml_contents) = 0;
@@ -91,13 +95,16 @@ private:
   Glib::VariantContainerBase GetNoteContents_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase GetNoteContentsXml_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase GetNoteCreateDate_stub(const Glib::VariantContainerBase &);
+  Glib::VariantContainerBase GetNoteLinks_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase GetNoteTitle_stub(const Glib::VariantContainerBase &);
+  Glib::VariantContainerBase GetNotesLinkingTo_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase GetTagsForNote_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase HideNote_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase ListAllNotes_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase NoteExists_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase RemoveTagFromNote_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase SearchNotes_stub(const Glib::VariantContainerBase &);
+  Glib::VariantContainerBase SearchNotesLimited_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase SetNoteCompleteXml_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase SetNoteContents_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase SetNoteContentsXml_stub(const Glib::VariantContainerBase &);
@@ -119,6 +126,8 @@ private:
   Glib::VariantContainerBase stub_vectorstring_string(const Glib::VariantContainerBase &, vectorstring_string_func);
   typedef std::vector<std::string> (RemoteControl_adaptor::*vectorstring_string_bool_func)(const std::string &, const bool &);
   Glib::VariantContainerBase stub_vectorstring_string_bool(const Glib::VariantContainerBase &, vectorstring_string_bool_func);
+  typedef std::vector<std::string> (RemoteControl_adaptor::*vectorstring_string_bool_int_func)(const std::string &, const bool &, const int &);
+  Glib::VariantContainerBase stub_vectorstring_string_bool_int(const Glib::VariantContainerBase &, vectorstring_string_bool_int_func);
 
   typedef Glib::VariantContainerBase (RemoteControl_adaptor::*stub_func)(const Glib::VariantContainerBase &);
   std::map<Glib::ustring, stub_func> m_stubs;
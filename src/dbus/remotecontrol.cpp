@@ -226,6 +226,20 @@ namespace gnote {
   }
 
 
+  std::vector< std::string > RemoteControl::GetNoteLinks(const std::string& uri)
+  {
+    std::vector< std::string > linked_note_uris;
+    if (!m_manager.find_by_uri(uri))
+      return linked_note_uris;
+    FOREACH(const std::string & title, m_manager.link_graph().get_links(uri)) {
+      NoteBase::Ptr linked_note = m_manager.find(title);
+      if (linked_note && linked_note->uri() != uri)
+        linked_note_uris.push_back(linked_note->uri());
+    }
+    return linked_note_uris;
+  }
+
+
   std::string RemoteControl::GetNoteTitle(const std::string& uri)
   {
     NoteBase::Ptr note = m_manager.find_by_uri(uri);
@@ -235,6 +249,20 @@ namespace gnote {
   }
 
 
+  std::vector< std::string > RemoteControl::GetNotesLinkingTo(const std::string& uri)
+  {
+    std::vector< std::string > linking_note_uris;
+    NoteBase::Ptr note = m_manager.find_by_uri(uri);
+    if (!note)
+      return linking_note_uris;
+    NoteBase::List notes = m_manager.get_notes_linking_to(note->get_title());
+    FOREACH(const NoteBase::Ptr & iter, notes) {
+      linking_note_uris.push_back(iter->uri());
+    }
+    return linking_note_uris;
+  }
+
+
   std::vector< std::string > RemoteControl::GetTagsForNote(const std::string& uri)
   {
     NoteBase::Ptr note = m_manager.find_by_uri(uri);
@@ -303,19 +331,28 @@ bool RemoteControl::RemoveTagFromNote(const std::string& uri,
 
 std::vector< std::string > RemoteControl::SearchNotes(const std::string& query,
                                                       const bool& case_sensitive)
+{
+  return SearchNotesLimited(query, case_sensitive, 0);
+}
+
+
+std::vector< std::string > RemoteControl::SearchNotesLimited(const std::string& query,
+                                                             const bool& case_sensitive,
+                                                             const int& max_results)
 {
   if (query.empty())
     return std::vector< std::string >();
 
   Search search(m_manager);
+  search.set_max_results(max_results > 0 ? max_results : 0);
   std::vector< std::string > list;
   Search::ResultsPtr results =
     search.search_notes(query, case_sensitive, notebooks::Notebook::Ptr());
 
-  for(Search::Results::const_reverse_iterator iter = results->rbegin();
-      iter != results->rend(); iter++) {
+  for(Search::Results::const_iterator iter = results->begin();
+      iter != results->end(); iter++) {
 
-    list.push_back(iter->second->uri());
+    list.push_back(iter->note->uri());
   }
 
   return list;
@@ -60,13 +60,17 @@ public:
   virtual std::string GetNoteContents(const std::string& uri) override;
   virtual std::string GetNoteContentsXml(const std::string& uri) override;
   virtual int32_t GetNoteCreateDate(const std::string& uri) override;
+  virtual std::vector< std::string > GetNoteLinks(const std::string& uri) override;
   virtual std::string GetNoteTitle(const std::string& uri) override;
+  virtual std::vector< std::string > GetNotesLinkingTo(const std::string& uri) override;
   virtual std::vector< std::string > GetTagsForNote(const std::string& uri) override;
   virtual bool HideNote(const std::string& uri) override;
   virtual std::vector< std::string > ListAllNotes() override;
   virtual bool NoteExists(const std::string& uri) override;
   virtual bool RemoveTagFromNote(const std::string& uri, const std::string& tag_name) override;
   virtual std::vector< std::string > SearchNotes(const std::string& query, const bool& case_sensitive) override;
+  virtual std::vector< std::string > SearchNotesLimited(const std::string& query, const bool& case_sensitive,
+                                                        const int& max_results) override;
   virtual bool SetNoteCompleteXml(const std::string& uri, const std::string& xml_contents) override;
   virtual bool SetNoteContents(const std::string& uri, const std::string& text_contents) override;
   virtual bool SetNoteContentsXml(const std::string& uri, const std::string& xml_contents) override;
@@ -21,13 +21,14 @@
 #include <giomm/dbusconnection.h>
 #include <giomm/dbuserror.h>
 
-#include <set>
+#include <map>
 
 #include "debug.hpp"
 #include "iconmanager.hpp"
 #include "ignote.hpp"
 #include "search.hpp"
 #include "searchprovider.hpp"
+#include "searchrank.hpp"
 
 
 namespace org {
@@ -41,6 +42,7 @@ SearchProvider::SearchProvider(const Glib::RefPtr<Gio::DBus::Connection> & conn,
                                gnote::NoteManager & manager)
   : Gio::DBus::InterfaceVTable(sigc::mem_fun(*this, &SearchProvider::on_method_call))
   , m_manager(manager)
+  , m_search_cache(manager)
 {
   conn->register_object(object_path, search_interface, *this);
 
@@ -87,19 +89,40 @@ void SearchProvider::on_method_call(const Glib::RefPtr<Gio::DBus::Connection> &,
 
 std::vector<Glib::ustring> SearchProvider::GetInitialResultSet(const std::vector<Glib::ustring> & terms)
 {
-  std::set<gnote::Note::Ptr> final_result;
-  gnote::Search search(m_manager);
+  return find_notes(terms, NULL);
+}
+
+std::vector<Glib::ustring> SearchProvider::find_notes(const std::vector<Glib::ustring> & terms,
+                                                      const gnote::SearchIndex::UriSet *candidates)
+{
+  // Best score of every note for any of the terms
+  std::map<gnote::Note::Ptr, double> final_result;
+  gnote::Search search(m_manager, &m_search_cache);
+  search.set_max_results(MAX_RESULTS);
   gnote::notebooks::Notebook::Ptr notebook;
   for(std::vector<Glib::ustring>::const_iterator query = terms.begin(); query != terms.end(); ++query) {
-    gnote::Search::ResultsPtr results = search.search_notes(*query, false, notebook);
+    gnote::Search::ResultsPtr results = candidates
+      ? search.search_notes(*query, false, notebook, *candidates)
+      : search.search_notes(*query, false, notebook);
     for(gnote::Search::Results::iterator iter = results->begin(); iter != results->end(); ++iter) {
-      final_result.insert(iter->second);
+      std::pair<std::map<gnote::Note::Ptr, double>::iterator, bool> res
+        = final_result.insert(std::make_pair(iter->note, iter->score));
+      if(!res.second && res.first->second < iter->score) {
+        res.first->second = iter->score;
+      }
     }
   }
 
+  gnote::TopHits<gnote::Note::Ptr> best(MAX_RESULTS);
+  for(std::map<gnote::Note::Ptr, double>::iterator iter = final_result.begin(); iter != final_result.end(); ++iter) {
+    best.push(iter->second, iter->first);
+  }
+  std::vector<gnote::TopHits<gnote::Note::Ptr>::Hit> hits;
+  best.take_sorted(hits);
+
   std::vector<Glib::ustring> ret;
-  for(std::set<gnote::Note::Ptr>::iterator iter = final_result.begin(); iter != final_result.end(); ++iter) {
-    ret.push_back((*iter)->uri());
+  for(std::vector<gnote::TopHits<gnote::Note::Ptr>::Hit>::iterator iter = hits.begin(); iter != hits.end(); ++iter) {
+    ret.push_back(iter->second->uri());
   }
 
   return ret;
@@ -120,20 +143,17 @@ Glib::VariantContainerBase SearchProvider::GetInitialResultSet_stub(const Glib::
 std::vector<Glib::ustring> SearchProvider::GetSubsearchResultSet(
     const std::vector<Glib::ustring> & previous_results, const std::vector<Glib::ustring> & terms)
 {
-  std::set<Glib::ustring> previous(previous_results.begin(), previous_results.end());
+  // Only the previous results can match the refined terms
+  gnote::SearchIndex::UriSet previous(previous_results.begin(), previous_results.end());
   if(previous.size() == 0) {
     return std::vector<Glib::ustring>();
   }
-
-  std::vector<Glib::ustring> final_result;
-  std::vector<Glib::ustring> new_result = GetInitialResultSet(terms);
-  for(std::vector<Glib::ustring>::iterator iter = new_result.begin(); iter != new_result.end(); ++iter) {
-    if(previous.find(*iter) != previous.end()) {
-      final_result.push_back(*iter);
-    }
+  // Previous results were cut to the best ones, the rest can match too
+  if(previous.size() >= MAX_RESULTS) {
+    return find_notes(terms, NULL);
   }
 
-  return final_result;
+  return find_notes(terms, &previous);
 }
 
 Glib::VariantContainerBase SearchProvider::GetSubsearchResultSet_stub(const Glib::VariantContainerBase & params)
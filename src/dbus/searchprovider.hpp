@@ -25,6 +25,7 @@
 #include <giomm/dbusinterfacevtable.h>
 
 #include "notemanager.hpp"
+#include "search.hpp"
 
 
 namespace org {
@@ -60,11 +61,17 @@ private:
   Glib::VariantContainerBase ActivateResult_stub(const Glib::VariantContainerBase &);
   Glib::VariantContainerBase LaunchSearch_stub(const Glib::VariantContainerBase &);
   gchar *get_icon();
+  std::vector<Glib::ustring> find_notes(const std::vector<Glib::ustring> & terms,
+                                        const gnote::SearchIndex::UriSet *candidates);
+
+  // The shell only shows a few results, the best ones are enough
+  static const unsigned MAX_RESULTS = 100;
 
   typedef Glib::VariantContainerBase (SearchProvider::*stub_func)(const Glib::VariantContainerBase &);
   std::map<Glib::ustring, stub_func> m_stubs;
 
   gnote::NoteManager & m_manager;
+  gnote::SearchCache m_search_cache;
   Glib::RefPtr<Gio::Icon> m_note_icon;
 };
 
@@ -32,9 +32,11 @@
 #include <gtkmm/button.h>
 #include <gtkmm/stock.h>
 
+#include "addinmanager.hpp"
 #include "mainwindow.hpp"
 #include "note.hpp"
 #include "notemanager.hpp"
+#include "notesavequeue.hpp"
 #include "noterenamedialog.hpp"
 #include "notetag.hpp"
 #include "notewindow.hpp"
@@ -96,22 +98,6 @@ namespace gnote {
 
   namespace {
     
-    void show_io_error_dialog (Gtk::Window * parent)
-    {
-      utils::HIGMessageDialog dialog(
-                              parent,
-                              GTK_DIALOG_DESTROY_WITH_PARENT,
-                              Gtk::MESSAGE_ERROR,
-                              Gtk::BUTTONS_OK,
-                              _("Error saving note data."),
-                              _("An error occurred while saving your notes. "
-                                "Please check that you have sufficient disk "
-                                "space, and that you have appropriate rights "
-                                "on ~/.local/share/gnote. Error details can be found in "
-                                "~/.gnote.log."));
-      dialog.run();
-    }
-
     void place_cursor_and_selection(const NoteData & data, const Glib::RefPtr<NoteBuffer> & buffer)
     {
       Gtk::TextIter cursor;
@@ -146,6 +132,7 @@ namespace gnote {
     , m_selection_bound_pos(s_noPosition)
     , m_width(0)
     , m_height(0)
+    , m_text_failed(false)
   {
   }
 
@@ -164,9 +151,28 @@ namespace gnote {
     return (m_width != 0) && (m_height != 0);
   }
 
+  void NoteData::read_text_file() const
+  {
+    std::string file;
+    file.swap(m_text_file);
+    m_text = NoteArchiver::read_text(file);
+    if(m_text.empty()) {
+      // Saving the empty text would overwrite the contents in the file
+      ERR_OUT(_("Failed to read contents of note %s"), file.c_str());
+      m_text_failed = true;
+    }
+  }
+
+  NoteDataBufferSynchronizer::~NoteDataBufferSynchronizer()
+  {
+    delete m_archiver;
+  }
+
   void NoteDataBufferSynchronizer::set_buffer(const Glib::RefPtr<NoteBuffer> & b)
   {
+    delete m_archiver;
     m_buffer = b;
+    m_archiver = new NoteBufferBlockArchiver(*(m_buffer.operator->()));
     m_buffer->signal_changed().connect(sigc::mem_fun(*this, &NoteDataBufferSynchronizer::buffer_changed));
     m_buffer->signal_apply_tag()
       .connect(sigc::mem_fun(*this, &NoteDataBufferSynchronizer::buffer_tag_applied));
@@ -178,6 +184,14 @@ namespace gnote {
     invalidate_text();
   }
 
+  void NoteDataBufferSynchronizer::release_buffer()
+  {
+    synchronize_text();
+    delete m_archiver;
+    m_archiver = NULL;
+    m_buffer.reset();
+  }
+
   const Glib::ustring & NoteDataBufferSynchronizer::text()
   {
     synchronize_text();
@@ -187,12 +201,24 @@ namespace gnote {
   void NoteDataBufferSynchronizer::set_text(const Glib::ustring & t)
   {
     data().text() = t;
+    data().clear_text_failed();
+    invalidate_plain_text();
     synchronize_buffer();
   }
 
+  const Glib::ustring & NoteDataBufferSynchronizer::plain_text()
+  {
+    // Buffer already has the text, no need to parse the XML
+    if(m_buffer && !is_plain_text_valid()) {
+      set_plain_text(m_buffer->get_slice(m_buffer->begin(), m_buffer->end()));
+    }
+    return NoteDataBufferSynchronizerBase::plain_text();
+  }
+
   void NoteDataBufferSynchronizer::invalidate_text()
   {
     data().text() = "";
+    invalidate_plain_text();
   }
 
   bool NoteDataBufferSynchronizer::is_text_invalid() const
@@ -203,7 +229,8 @@ namespace gnote {
   void NoteDataBufferSynchronizer::synchronize_text() const
   {
     if(is_text_invalid() && m_buffer) {
-      const_cast<NoteData&>(data()).text() = NoteBufferArchiver::serialize(m_buffer);
+      // Only paragraphs changed since the last time are serialized again
+      const_cast<NoteData&>(data()).text() = m_archiver->serialize();
     }
   }
 
@@ -374,13 +401,9 @@ namespace gnote {
 
     DBG_OUT("Saving '%s'...", m_data.data().title().c_str());
 
-    try {
-      NoteArchiver::write(file_path(), m_data.synchronized_data());
-    } 
-    catch (const sharp::Exception & e) {
-      // Probably IOException or UnauthorizedAccessException?
-      ERR_OUT(_("Exception while saving note: %s"), e.what());
-      show_io_error_dialog(dynamic_cast<Gtk::Window*>(m_window->host()));
+    // Written on a background thread, failures are reported by NoteManager
+    if(!manager().save_queue().queue(file_path(), m_data.synchronized_data())) {
+      return;
     }
 
     signal_saved(shared_from_this());
@@ -458,8 +481,11 @@ namespace gnote {
     // Replace the existing save timeout.  Wait 4 seconds
     // before saving...
     m_save_timeout->reset(4000);
-    if (!m_is_deleting)
+    if (!m_is_deleting) {
       m_save_needed = true;
+      // Links may have changed, before the note is saved
+      manager().queue_links_update(uri());
+    }
     set_change_type(changeType);
   }
 
@@ -539,6 +565,7 @@ namespace gnote {
 
       Glib::ustring old_title = m_data.data().title();
       m_data.data().title() = new_title;
+      manager().note_title_changed(shared_from_this());
 
       if (from_user_action) {
         process_rename_link_update(old_title);
@@ -617,9 +644,7 @@ namespace gnote {
 
   bool Note::contains_text(const Glib::ustring & text)
   {
-    const std::string text_lower = text.lowercase();
-    const std::string text_content_lower = text_content().lowercase();
-    return text_content_lower.find(text_lower) != Glib::ustring::npos;
+    return sharp::string_contains_nocase(text_content(), text);
   }
 
 
@@ -682,14 +707,6 @@ namespace gnote {
     }
   }
 
-  Glib::ustring Note::text_content()
-  {
-    if(!m_buffer) {
-      get_buffer();
-    }
-    return m_buffer->get_slice(m_buffer->begin(), m_buffer->end());
-  }
-
   void Note::set_text_content(const std::string & text)
   {
     if(m_buffer) {
@@ -714,6 +731,12 @@ namespace gnote {
   const Glib::RefPtr<NoteBuffer> & Note::get_buffer()
   {
     if(!m_buffer) {
+      bool was_loaded = is_body_loaded();
+      load_addins();
+      // Addins can ask for the buffer while they are initialized
+      if(m_buffer) {
+        return m_buffer;
+      }
       DBG_OUT("Creating buffer for %s", m_data.data().title().c_str());
       m_buffer = NoteBuffer::create(get_tag_table(), *this);
       m_data.set_buffer(m_buffer);
@@ -728,14 +751,52 @@ namespace gnote {
         sigc::mem_fun(*this, &Note::on_buffer_mark_set));
       m_mark_deleted_conn = m_buffer->signal_mark_deleted().connect(
         sigc::mem_fun(*this, &Note::on_buffer_mark_deleted));
+      body_accessed(was_loaded);
     }
     return m_buffer;
   }
 
+  void Note::load_addins()
+  {
+    AddinManager & addin_manager = static_cast<NoteManager&>(manager()).get_addin_manager();
+    addin_manager.load_addins_for_note(static_pointer_cast<Note>(shared_from_this()));
+  }
+
+  gsize Note::body_size() const
+  {
+    gsize size = NoteBase::body_size();
+    if(m_buffer) {
+      // Rough estimate of text, tag toggles and line data
+      size += 4 * m_buffer->size();
+    }
+    return size;
+  }
+
+  bool Note::unload_body()
+  {
+    if(m_save_needed || m_is_deleting || m_window || !m_child_widget_queue.empty()
+       || manager().save_queue().is_pending(file_path())) {
+      return false;
+    }
+    if(m_buffer) {
+      // Addins connect to buffer when note is opened, so keep it then.
+      // Also keep it, if anyone else holds a reference to it.
+      if(m_note_window_embedded || G_OBJECT(m_buffer->gobj())->ref_count > 2) {
+        return false;
+      }
+      m_mark_set_conn.disconnect();
+      m_mark_deleted_conn.disconnect();
+      m_data.release_buffer();
+      m_buffer.reset();
+    }
+    return NoteBase::unload_body();
+  }
+
 
   NoteWindow * Note::get_window()
   {
     if(!m_window) {
+      load_addins();
       m_window = new NoteWindow(*this);
       m_window->signal_delete_event().connect(
         sigc::mem_fun(*this, &Note::on_window_destroyed));
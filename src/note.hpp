@@ -49,8 +49,10 @@ public:
   // takes ownership
   NoteDataBufferSynchronizer(NoteData * _data)
     : NoteDataBufferSynchronizerBase(_data)
+    , m_archiver(NULL)
     {
     }
+  ~NoteDataBufferSynchronizer();
 
   virtual const NoteData & synchronized_data() const override
     {
@@ -67,8 +69,11 @@ public:
       return m_buffer;
     }
   void set_buffer(const Glib::RefPtr<NoteBuffer> & b);
+  /** Store buffer contents and stop using the buffer. */
+  void release_buffer();
   virtual const Glib::ustring & text() override;
   virtual void set_text(const Glib::ustring & t) override;
+  virtual const Glib::ustring & plain_text() override;
 
 private:
   void invalidate_text();
@@ -84,6 +89,7 @@ private:
                           const Gtk::TextBuffer::iterator &);
 
   Glib::RefPtr<NoteBuffer> m_buffer;
+  NoteBufferBlockArchiver *m_archiver;
 };
 
 
@@ -118,7 +124,6 @@ public:
   virtual void set_title(const Glib::ustring & new_title, bool from_user_action) override;
   virtual void rename_without_link_update(const Glib::ustring & newTitle) override;
   virtual void set_xml_content(const Glib::ustring & xml) override;
-  Glib::ustring text_content();
   void set_text_content(const std::string & text);
 
   const Glib::RefPtr<NoteTagTable> & get_tag_table();
@@ -145,6 +150,8 @@ public:
   void set_pinned(bool pinned) const;
   using NoteBase::enabled;
   virtual void enabled(bool is_enabled) override;
+  virtual gsize body_size() const override;
+  virtual bool unload_body() override;
 
   sigc::signal<void,Note&> & signal_opened()
     { return m_signal_opened; }
@@ -179,6 +186,7 @@ private:
                                       const std::string & old_title, const Note::Ptr & self);
   void on_note_window_embedded();
   void on_note_window_foregrounded();
+  void load_addins();
 
   Note(NoteData * data, const Glib::ustring & filepath, NoteManager & manager);
 
@@ -42,6 +42,20 @@ namespace gnote {
 
   class NoteManager;
 
+/**
+ * Note addins are only created for a note, when it is first opened or
+ * gets a buffer. Addin types, that have to react to events of notes,
+ * that have not been opened, provide one manager hook instead. It
+ * watches the note manager and loads addins only for the notes,
+ * that need them.
+ */
+class NoteAddinManagerHook
+{
+public:
+  virtual ~NoteAddinManagerHook() {}
+};
+
+
 /// <summary>
 /// A NoteAddin extends the functionality of a note and a NoteWindow.
 /// If you wish to extend Tomboy in a more broad sense, perhaps you
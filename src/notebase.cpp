@@ -19,6 +19,8 @@
  */
 
 
+#include <vector>
+
 #include <boost/format.hpp>
 #include <glibmm/i18n.h>
 
@@ -26,6 +28,7 @@
 #include "itagmanager.hpp"
 #include "notebase.hpp"
 #include "notemanagerbase.hpp"
+#include "notesavequeue.hpp"
 #include "sharp/exception.hpp"
 #include "sharp/files.hpp"
 #include "sharp/map.hpp"
@@ -45,6 +48,22 @@
 
 namespace gnote {
 
+namespace {
+
+// Same bullets as NoteBuffer uses for list items, so that the text
+// matches the one of the note buffer.
+const char *INDENT_BULLETS[] = { "\xe2\x80\xa2 ", "\xe2\x88\x98 ", "\xe2\x80\xa3 " };
+const int NUM_INDENT_BULLETS = sizeof(INDENT_BULLETS) / sizeof(INDENT_BULLETS[0]);
+
+struct ListItem
+{
+  std::string::size_type start;
+  int depth;
+  bool has_content;
+};
+
+}
+
 NoteDataBufferSynchronizerBase::~NoteDataBufferSynchronizerBase()
 {
   delete m_data;
@@ -58,6 +77,34 @@ const Glib::ustring & NoteDataBufferSynchronizerBase::text()
 void NoteDataBufferSynchronizerBase::set_text(const Glib::ustring & t)
 {
   data().text() = t;
+  data().clear_text_failed();
+  invalidate_plain_text();
+}
+
+const Glib::ustring & NoteDataBufferSynchronizerBase::plain_text()
+{
+  if(!m_plain_text_valid) {
+    set_plain_text(NoteArchiver::get_text_from_note_content(text()));
+  }
+  return m_plain_text;
+}
+
+void NoteDataBufferSynchronizerBase::unload_text(const std::string & file)
+{
+  m_data->set_text_file(file);
+  invalidate_plain_text();
+}
+
+void NoteDataBufferSynchronizerBase::set_plain_text(const Glib::ustring & t)
+{
+  m_plain_text = t;
+  m_plain_text_valid = true;
+}
+
+void NoteDataBufferSynchronizerBase::invalidate_plain_text()
+{
+  m_plain_text.clear();
+  m_plain_text_valid = false;
 }
 
 
@@ -92,9 +139,15 @@ NoteBase::NoteBase(NoteData *, const Glib::ustring & filepath, NoteManagerBase &
   : m_manager(_manager)
   , m_file_path(filepath)
   , m_enabled(true)
+  , m_dense_id(NoteBitmap::allocate_id())
 {
 }
 
+NoteBase::~NoteBase()
+{
+  NoteBitmap::release_id(m_dense_id);
+}
+
 int NoteBase::get_hash_code() const
 {
   hash<std::string> h;
@@ -126,6 +179,7 @@ void NoteBase::set_title(const Glib::ustring & new_title, bool from_user_action)
   if(data_synchronizer().data().title() != new_title) {
     Glib::ustring old_title = data_synchronizer().data().title();
     data_synchronizer().data().title() = new_title;
+    m_manager.note_title_changed(shared_from_this());
 
     if(from_user_action) {
       process_rename_link_update(old_title);
@@ -155,6 +209,7 @@ void NoteBase::rename_without_link_update(const Glib::ustring & newTitle)
 {
   if(data_synchronizer().data().title() != newTitle) {
     data_synchronizer().data().title() = newTitle;
+    m_manager.note_title_changed(shared_from_this());
 
     // HACK:
     signal_renamed(shared_from_this(), newTitle);
@@ -191,12 +246,8 @@ void NoteBase::set_change_type(ChangeType c)
 
 void NoteBase::save()
 {
-  try {
-    NoteArchiver::write(m_file_path, data_synchronizer().data());
-  } 
-  catch (const sharp::Exception & e) {
-    // Probably IOException or UnauthorizedAccessException?
-    ERR_OUT(_("Exception while saving note: %s"), e.what());
+  if(!m_manager.save_queue().queue(m_file_path, data_synchronizer().data())) {
+    return;
   }
 
   signal_saved(shared_from_this());
@@ -286,11 +337,59 @@ Glib::ustring NoteBase::get_complete_note_xml()
   return NoteArchiver::write_string(data_synchronizer().synchronized_data());
 }
 
+const Glib::ustring & NoteBase::xml_content()
+{
+  bool was_loaded = is_body_loaded();
+  const Glib::ustring & content = data_synchronizer().text();
+  body_accessed(was_loaded);
+  return content;
+}
+
 void NoteBase::set_xml_content(const Glib::ustring & xml)
 {
   data_synchronizer().set_text(xml);
 }
 
+const Glib::ustring & NoteBase::text_content()
+{
+  bool was_loaded = is_body_loaded();
+  const Glib::ustring & content = data_synchronizer().plain_text();
+  body_accessed(was_loaded);
+  return content;
+}
+
+bool NoteBase::is_body_loaded() const
+{
+  return data_synchronizer().data().is_text_loaded();
+}
+
+gsize NoteBase::body_size() const
+{
+  if(!is_body_loaded()) {
+    return 0;
+  }
+  // XML contents and the plain text extracted from them
+  return 2 * data_synchronizer().data().text().bytes();
+}
+
+bool NoteBase::unload_body()
+{
+  if(!is_body_loaded() || !sharp::file_exists(file_path())) {
+    return false;
+  }
+  // Contents are read back from the file, so it has to be written first
+  if(m_manager.save_queue().is_pending(file_path())) {
+    return false;
+  }
+  data_synchronizer().unload_text(file_path());
+  return true;
+}
+
+void NoteBase::body_accessed(bool was_loaded)
+{
+  m_manager.body_cache().note_accessed(shared_from_this(), was_loaded);
+}
+
 void NoteBase::load_foreign_note_xml(const Glib::ustring & foreignNoteXml, ChangeType changeType)
 {
   if(foreignNoteXml.empty())
@@ -426,6 +525,20 @@ void NoteArchiver::read(const Glib::ustring & read_file, NoteData & data)
   return obj().read_file(read_file, data);
 }
 
+Glib::ustring NoteArchiver::read_text(const Glib::ustring & read_file)
+{
+  Glib::ustring text;
+  sharp::XmlReader xml(read_file);
+  while(xml.read()) {
+    if(xml.get_node_type() == XML_READER_TYPE_ELEMENT && xml.get_name() == "text") {
+      text = xml.read_inner_xml();
+      break;
+    }
+  }
+  xml.close();
+  return text;
+}
+
 void NoteArchiver::read_file(const Glib::ustring & file, NoteData & data)
 {
   Glib::ustring version;
@@ -670,6 +783,61 @@ Glib::ustring NoteArchiver::get_title_from_note_xml(const Glib::ustring & noteXm
 
   return "";
 }
+
+Glib::ustring NoteArchiver::get_text_from_note_content(const Glib::ustring & content_xml)
+{
+  std::string text;
+  if(content_xml.empty()) {
+    return text;
+  }
+
+  int curr_depth = -1;
+  std::vector<ListItem> list_items;
+  sharp::XmlReader xml;
+  xml.load_buffer(content_xml);
+  while(xml.read()) {
+    switch(xml.get_node_type()) {
+    case XML_READER_TYPE_ELEMENT:
+      if(xml.get_name() == "list") {
+        ++curr_depth;
+      }
+      else if(xml.get_name() == "list-item" && curr_depth >= 0) {
+        ListItem item;
+        item.start = text.size();
+        item.depth = curr_depth;
+        item.has_content = false;
+        list_items.push_back(item);
+      }
+      break;
+    case XML_READER_TYPE_TEXT:
+    case XML_READER_TYPE_WHITESPACE:
+    case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+      text += xml.get_value();
+      if(!list_items.empty()) {
+        list_items.back().has_content = true;
+      }
+      break;
+    case XML_READER_TYPE_END_ELEMENT:
+      if(xml.get_name() == "list") {
+        --curr_depth;
+      }
+      else if(xml.get_name() == "list-item" && !list_items.empty()) {
+        // Bullet is only shown for list items with content
+        const ListItem & item = list_items.back();
+        if(item.has_content) {
+          text.insert(item.start, INDENT_BULLETS[item.depth % NUM_INDENT_BULLETS]);
+        }
+        list_items.pop_back();
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  xml.close();
+
+  return text;
+}
  
 }
 
@@ -63,12 +63,35 @@ public:
     }
   const Glib::ustring & text() const
     { 
+      load_text();
       return m_text;
     }
   Glib::ustring & text()
     { 
+      load_text();
       return m_text;
     }
+  /** Read text from %file when it is first needed. */
+  void set_text_file(const std::string & file)
+    {
+      m_text_file = file;
+      m_text.clear();
+      m_text_failed = false;
+    }
+  bool is_text_loaded() const
+    {
+      return m_text_file.empty();
+    }
+  /** Whether reading the text from file failed. Such note must not be saved. */
+  bool is_text_failed() const
+    {
+      return m_text_failed;
+    }
+  /** Text, that replaces the one failed to be read, can be saved. */
+  void clear_text_failed()
+    {
+      m_text_failed = false;
+    }
   const sharp::DateTime & create_date() const
     {
       return m_create_date;
@@ -139,9 +162,19 @@ public:
   bool has_extent();
 
 private:
+  void load_text() const
+    {
+      if(!m_text_file.empty()) {
+        read_text_file();
+      }
+    }
+  void read_text_file() const;
+
   const std::string m_uri;
   Glib::ustring     m_title;
-  Glib::ustring     m_text;
+  mutable Glib::ustring m_text;
+  mutable std::string   m_text_file;
+  mutable bool          m_text_failed;
   sharp::DateTime             m_create_date;
   sharp::DateTime             m_change_date;
   sharp::DateTime             m_metadata_change_date;
@@ -158,6 +191,7 @@ class NoteDataBufferSynchronizerBase
 public:
   NoteDataBufferSynchronizerBase(NoteData *_data)
     : m_data(_data)
+    , m_plain_text_valid(false)
     {}
   virtual ~NoteDataBufferSynchronizerBase();
   const NoteData & data() const
@@ -178,8 +212,20 @@ public:
     }
   virtual const Glib::ustring & text();
   virtual void set_text(const Glib::ustring & t);
+  virtual const Glib::ustring & plain_text();
+  /** Drop the text, to be read from %file when needed. */
+  void unload_text(const std::string & file);
+protected:
+  bool is_plain_text_valid() const
+    {
+      return m_plain_text_valid;
+    }
+  void set_plain_text(const Glib::ustring & t);
+  void invalidate_plain_text();
 private:
   NoteData *m_data;
+  Glib::ustring m_plain_text;
+  bool m_plain_text_valid;
 };
 
 
@@ -196,6 +242,7 @@ public:
   static void parse_tags(const xmlNodePtr tagnodes, std::list<Glib::ustring> & tags);
 
   NoteBase(NoteData *_data, const Glib::ustring & filepath, NoteManagerBase & manager);
+  virtual ~NoteBase();
 
   NoteManagerBase & manager()
     {
@@ -209,6 +256,11 @@ public:
   int get_hash_code() const;
   const std::string & uri() const;
   const std::string id() const;
+  /** Small number identifying the note in NoteBitmap. */
+  unsigned dense_id() const
+    {
+      return m_dense_id;
+    }
   const Glib::ustring & get_title() const;
   void set_title(const Glib::ustring & new_title);
   virtual void set_title(const Glib::ustring & new_title, bool from_user_action);
@@ -229,11 +281,18 @@ public:
       return m_file_path;
     }
   Glib::ustring get_complete_note_xml();
-  const Glib::ustring & xml_content()
-    {
-      return data_synchronizer().text();
-    }
+  const Glib::ustring & xml_content();
   virtual void set_xml_content(const Glib::ustring & xml);
+  const Glib::ustring & text_content();
+  /** Whether contents of the note are in memory. */
+  bool is_body_loaded() const;
+  /** Estimated memory used by contents of the note, in bytes. */
+  virtual gsize body_size() const;
+  /**
+   * Drop contents of the note from memory, to be read from the file
+   * again when needed. Returns false, if contents can not be dropped.
+   */
+  virtual bool unload_body();
   void load_foreign_note_xml(const Glib::ustring & foreignNoteXml, ChangeType changeType);
   void get_tags(std::list<Tag::Ptr> &) const;
   const NoteData & data() const;
@@ -262,6 +321,7 @@ public:
 protected:
   virtual const NoteDataBufferSynchronizerBase & data_synchronizer() const = 0;
   virtual NoteDataBufferSynchronizerBase & data_synchronizer() = 0;
+  void body_accessed(bool was_loaded);
   virtual void process_rename_link_update(const Glib::ustring & old_title);
   void set_change_type(ChangeType c);
   virtual void handle_link_rename(const Glib::ustring & old_title, const Ptr & renamed, bool rename);
@@ -269,6 +329,7 @@ private:
   NoteManagerBase & m_manager;
   Glib::ustring m_file_path;
   bool m_enabled;
+  unsigned m_dense_id;
 };
 
 
@@ -279,6 +340,8 @@ public:
   static const char *CURRENT_VERSION;
 
   static void read(const Glib::ustring & read_file, NoteData & data);
+  /** Read only the contents of the note in %read_file. */
+  static Glib::ustring read_text(const Glib::ustring & read_file);
   static Glib::ustring write_string(const NoteData & data);
   static void write(const Glib::ustring & write_file, const NoteData & data);
   void read_file(const Glib::ustring & file, NoteData & data);
@@ -288,6 +351,7 @@ public:
 
   Glib::ustring get_renamed_note_xml(const Glib::ustring &, const Glib::ustring &, const Glib::ustring &) const;
   Glib::ustring get_title_from_note_xml(const Glib::ustring & noteXml) const;
+  static Glib::ustring get_text_from_note_content(const Glib::ustring & content_xml);
 protected:
   void _read(sharp::XmlReader & xml, NoteData & data, Glib::ustring & version);
 
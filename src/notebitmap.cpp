@@ -0,0 +1,122 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <functional>
+
+#include "notebitmap.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+unsigned s_next_id = 0;
+// released ids, smallest on top
+std::vector<unsigned> s_free_ids;
+
+}
+
+
+unsigned NoteBitmap::allocate_id()
+{
+  if(s_free_ids.empty()) {
+    return s_next_id++;
+  }
+  std::pop_heap(s_free_ids.begin(), s_free_ids.end(), std::greater<unsigned>());
+  unsigned id = s_free_ids.back();
+  s_free_ids.pop_back();
+  return id;
+}
+
+void NoteBitmap::release_id(unsigned id)
+{
+  s_free_ids.push_back(id);
+  std::push_heap(s_free_ids.begin(), s_free_ids.end(), std::greater<unsigned>());
+}
+
+bool NoteBitmap::empty() const
+{
+  Word any = 0;
+  for(size_t i = 0; i < m_words.size(); ++i) {
+    any |= m_words[i];
+  }
+  return any == 0;
+}
+
+size_t NoteBitmap::count() const
+{
+  size_t result = 0;
+  for(size_t i = 0; i < m_words.size(); ++i) {
+    result += __builtin_popcountll(m_words[i]);
+  }
+  return result;
+}
+
+NoteBitmap & NoteBitmap::operator&=(const NoteBitmap & other)
+{
+  size_t size = std::min(m_words.size(), other.m_words.size());
+  m_words.resize(size);
+  Word *words = m_words.empty() ? NULL : &m_words[0];
+  const Word *other_words = other.m_words.empty() ? NULL : &other.m_words[0];
+  for(size_t i = 0; i < size; ++i) {
+    words[i] &= other_words[i];
+  }
+  return *this;
+}
+
+NoteBitmap & NoteBitmap::operator|=(const NoteBitmap & other)
+{
+  if(m_words.size() < other.m_words.size()) {
+    m_words.resize(other.m_words.size(), 0);
+  }
+  size_t size = other.m_words.size();
+  Word *words = m_words.empty() ? NULL : &m_words[0];
+  const Word *other_words = other.m_words.empty() ? NULL : &other.m_words[0];
+  for(size_t i = 0; i < size; ++i) {
+    words[i] |= other_words[i];
+  }
+  return *this;
+}
+
+NoteBitmap & NoteBitmap::and_not(const NoteBitmap & other)
+{
+  size_t size = std::min(m_words.size(), other.m_words.size());
+  Word *words = m_words.empty() ? NULL : &m_words[0];
+  const Word *other_words = other.m_words.empty() ? NULL : &other.m_words[0];
+  for(size_t i = 0; i < size; ++i) {
+    words[i] &= ~other_words[i];
+  }
+  return *this;
+}
+
+void NoteBitmap::get_ids(std::vector<unsigned> & ids) const
+{
+  ids.clear();
+  for(size_t i = 0; i < m_words.size(); ++i) {
+    Word word = m_words[i];
+    while(word) {
+      ids.push_back(i * WORD_BITS + __builtin_ctzll(word));
+      word &= word - 1;
+    }
+  }
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __NOTEBITMAP_HPP_
+#define __NOTEBITMAP_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace gnote {
+
+/**
+ * Set of notes, one bit per dense note id. Combining sets is done a
+ * word at a time in plain loops, that compilers can vectorize.
+ */
+class NoteBitmap
+{
+public:
+  typedef uint64_t Word;
+  static const unsigned WORD_BITS = 64;
+
+  /**
+   * Dense id for a new note. Ids of released notes are reused, so ids
+   * stay close to the number of notes.
+   */
+  static unsigned allocate_id();
+  static void release_id(unsigned id);
+
+  void set(unsigned id)
+  {
+    unsigned word = id / WORD_BITS;
+    if (word >= m_words.size())
+      m_words.resize(word + 1, 0);
+    m_words[word] |= Word(1) << (id % WORD_BITS);
+  }
+
+  void reset(unsigned id)
+  {
+    unsigned word = id / WORD_BITS;
+    if (word < m_words.size())
+      m_words[word] &= ~(Word(1) << (id % WORD_BITS));
+  }
+
+  bool test(unsigned id) const
+  {
+    unsigned word = id / WORD_BITS;
+    return word < m_words.size() && (m_words[word] >> (id % WORD_BITS)) & 1;
+  }
+
+  void clear()
+  {
+    m_words.clear();
+  }
+
+  bool empty() const;
+  size_t count() const;
+
+  /** Keep only the notes, that are in %other too. */
+  NoteBitmap & operator&=(const NoteBitmap & other);
+  /** Add the notes from %other. */
+  NoteBitmap & operator|=(const NoteBitmap & other);
+  /** Remove the notes, that are in %other. */
+  NoteBitmap & and_not(const NoteBitmap & other);
+
+  /** Ids in the set, in increasing order. */
+  void get_ids(std::vector<unsigned> & ids) const;
+
+private:
+  std::vector<Word> m_words;
+};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "debug.hpp"
+#include "notebodycache.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+// Contents are dropped from an idle handler, so that references to note
+// contents held by the caller stay valid
+const guint TRIM_TIMEOUT = 1000;
+
+}
+
+
+NoteBodyCache::NoteBodyCache()
+  : m_budget(0)
+  , m_size(0)
+  , m_hits(0)
+  , m_misses(0)
+  , m_evictions(0)
+{
+  m_trim_timeout.signal_timeout.connect(sigc::mem_fun(*this, &NoteBodyCache::trim));
+}
+
+void NoteBodyCache::set_budget(gsize budget)
+{
+  m_budget = budget;
+  queue_trim();
+}
+
+void NoteBodyCache::note_accessed(const NoteBase::Ptr & note, bool was_loaded)
+{
+  if(was_loaded) {
+    ++m_hits;
+  }
+  else {
+    ++m_misses;
+  }
+  touch(note);
+}
+
+void NoteBodyCache::note_loaded(const NoteBase::Ptr & note)
+{
+  touch(note);
+}
+
+void NoteBodyCache::touch(const NoteBase::Ptr & note)
+{
+  EntryMap::iterator iter = m_entry_map.find(note->uri());
+  if(iter == m_entry_map.end()) {
+    Entry entry;
+    entry.uri = note->uri();
+    entry.note = note;
+    entry.size = 0;
+    m_entries.push_front(entry);
+    iter = m_entry_map.insert(std::make_pair(entry.uri, m_entries.begin())).first;
+  }
+  else if(iter->second != m_entries.begin()) {
+    m_entries.splice(m_entries.begin(), m_entries, iter->second);
+  }
+
+  Entry & entry = *iter->second;
+  m_size -= entry.size;
+  entry.size = note->body_size();
+  m_size += entry.size;
+  queue_trim();
+}
+
+void NoteBodyCache::remove_note(const std::string & uri)
+{
+  EntryMap::iterator iter = m_entry_map.find(uri);
+  if(iter == m_entry_map.end()) {
+    return;
+  }
+  m_size -= iter->second->size;
+  m_entries.erase(iter->second);
+  m_entry_map.erase(iter);
+}
+
+void NoteBodyCache::trim()
+{
+  m_trim_timeout.cancel();
+  if(m_budget == 0) {
+    return;
+  }
+
+  EntryList::iterator iter = m_entries.end();
+  while(m_size > m_budget && iter != m_entries.begin()) {
+    --iter;
+    NoteBase::Ptr note = iter->note.lock();
+    if(note) {
+      // Notes being edited keep their contents
+      gsize size = note->body_size();
+      if(!note->unload_body()) {
+        m_size -= iter->size;
+        iter->size = size;
+        m_size += size;
+        continue;
+      }
+      ++m_evictions;
+    }
+    m_size -= iter->size;
+    m_entry_map.erase(iter->uri);
+    iter = m_entries.erase(iter);
+  }
+
+  DBG_OUT("note contents: %lu bytes, %llu hits, %llu misses, %llu evictions",
+          (unsigned long) m_size, (unsigned long long) m_hits,
+          (unsigned long long) m_misses, (unsigned long long) m_evictions);
+}
+
+void NoteBodyCache::queue_trim()
+{
+  if(m_budget > 0 && m_size > m_budget) {
+    m_trim_timeout.reset(TRIM_TIMEOUT);
+  }
+}
+
+}
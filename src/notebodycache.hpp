@@ -0,0 +1,104 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _NOTEBODYCACHE_HPP_
+#define _NOTEBODYCACHE_HPP_
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "base/macros.hpp"
+#include "notebase.hpp"
+#include "utils.hpp"
+
+
+namespace gnote {
+
+/**
+ * Keeps track of notes, that have their contents in memory, in least
+ * recently used order. When the estimated memory use goes over the
+ * budget, contents of the least recently used notes are dropped; they
+ * are read from the note file again when needed.
+ */
+class NoteBodyCache
+{
+public:
+  NoteBodyCache();
+
+  /** Memory budget in bytes, 0 for unlimited. */
+  void set_budget(gsize budget);
+  gsize budget() const
+    {
+      return m_budget;
+    }
+  /** Estimated memory used by the contents of notes. */
+  gsize size() const
+    {
+      return m_size;
+    }
+
+  /** Contents of %note were accessed, %was_loaded tells whether they were in memory. */
+  void note_accessed(const NoteBase::Ptr & note, bool was_loaded);
+  /** Contents of %note were loaded without being requested. */
+  void note_loaded(const NoteBase::Ptr & note);
+  void remove_note(const std::string & uri);
+  /** Drop contents of least recently used notes until back under budget. */
+  void trim();
+
+  guint64 hits() const
+    {
+      return m_hits;
+    }
+  guint64 misses() const
+    {
+      return m_misses;
+    }
+  guint64 evictions() const
+    {
+      return m_evictions;
+    }
+private:
+  struct Entry
+  {
+    std::string uri;
+    NoteBase::WeakPtr note;
+    gsize size;
+  };
+  // most recently used first
+  typedef std::list<Entry> EntryList;
+  typedef std::map<std::string, EntryList::iterator> EntryMap;
+
+  void touch(const NoteBase::Ptr & note);
+  void queue_trim();
+
+  EntryList m_entries;
+  EntryMap m_entry_map;
+  gsize m_budget;
+  gsize m_size;
+  guint64 m_hits;
+  guint64 m_misses;
+  guint64 m_evictions;
+  utils::InterruptableTimeout m_trim_timeout;
+};
+
+}
+
+#endif
@@ -52,7 +52,7 @@ namespace notebooks {
     if(tag == NULL) {
       return false;
     }
-    return note->contains_tag(tag);
+    return tag->has_note(*note);
   }
 
   /// <summary>
@@ -202,11 +202,17 @@ namespace notebooks {
   /// </returns>
   bool Notebook::contains_note(const Note::Ptr & note, bool include_system)
   {
-    bool contains = note->contains_tag(m_tag);
-    if(!contains || include_system) {
+    return contains_note(m_tag, include_system ? Tag::Ptr() : template_tag(), *note, include_system);
+  }
+
+  bool Notebook::contains_note(const Tag::Ptr & tag, const Tag::Ptr & template_tag,
+                               const NoteBase & note, bool include_system)
+  {
+    bool contains = tag && tag->has_note(note);
+    if(!contains || include_system || !template_tag) {
       return contains;
     }
-    return !is_template_note(note);
+    return !template_tag->has_note(note);
   }
 
   bool Notebook::add_note(const Note::Ptr & note)
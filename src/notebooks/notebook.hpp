@@ -53,6 +53,9 @@ public:
   virtual Note::Ptr   get_template_note() const;
   Note::Ptr create_notebook_note();
   virtual bool contains_note(const Note::Ptr & note, bool include_system = false);
+  /** Whether %note has notebook %tag, and is not a template unless %include_system. */
+  static bool contains_note(const Tag::Ptr & tag, const Tag::Ptr & template_tag,
+                            const NoteBase & note, bool include_system);
   virtual bool add_note(const Note::Ptr &);
   static std::string normalize(const std::string & s);
 ////
@@ -1179,24 +1179,18 @@ namespace gnote {
   }
 
   
-  // This is taken almost directly from GAIM.  There must be a
-  // better way to do this...
   void NoteBufferArchiver::serialize(const Glib::RefPtr<Gtk::TextBuffer> & buffer, 
                                      const Gtk::TextIter & start,
                                      const Gtk::TextIter & end, sharp::XmlWriter & xml)
   {
-    std::stack<Glib::RefPtr<const Gtk::TextTag> > tag_stack;
-    std::stack<Glib::RefPtr<const Gtk::TextTag> > replay_stack;
-    std::stack<Glib::RefPtr<const Gtk::TextTag> > continue_stack;
-
-    Gtk::TextIter iter = start;
-    Gtk::TextIter next_iter = start;
-    next_iter.forward_char();
+    write_content_start(xml);
+    serialize_content(buffer, start, end, xml);
+    xml.write_end_element (); // </note-content>
+  }
 
-    bool line_has_depth = false;
-    int prev_depth_line = -1;
-    int prev_depth = -1;
 
+  void NoteBufferArchiver::write_content_start(sharp::XmlWriter & xml)
+  {
     xml.write_start_element ("", "note-content", "");
     xml.write_attribute_string ("", "version", "", "0.1");
     xml.write_attribute_string("xmlns",
@@ -1207,6 +1201,26 @@ namespace gnote {
                                "size",
                                "",
                                "http://beatniksoftware.com/tomboy/size");
+  }
+
+
+  // This is taken almost directly from GAIM.  There must be a
+  // better way to do this...
+  void NoteBufferArchiver::serialize_content(const Glib::RefPtr<Gtk::TextBuffer> & buffer,
+                                             const Gtk::TextIter & start,
+                                             const Gtk::TextIter & end, sharp::XmlWriter & xml)
+  {
+    std::stack<Glib::RefPtr<const Gtk::TextTag> > tag_stack;
+    std::stack<Glib::RefPtr<const Gtk::TextTag> > replay_stack;
+    std::stack<Glib::RefPtr<const Gtk::TextTag> > continue_stack;
+
+    Gtk::TextIter iter = start;
+    Gtk::TextIter next_iter = start;
+    next_iter.forward_char();
+
+    bool line_has_depth = false;
+    int prev_depth_line = -1;
+    int prev_depth = -1;
 
     // Insert any active tags at start into tag_stack...
     Glib::SListHandle<Glib::RefPtr<const Gtk::TextTag> > tag_list = start.get_tags();
@@ -1220,7 +1234,7 @@ namespace gnote {
     }
 
     while ((iter != end) && iter.get_char()) {
-      DepthNoteTag::Ptr depth_tag = NoteBuffer::Ptr::cast_static(buffer)->find_depth_tag (iter);
+      DepthNoteTag::Ptr depth_tag = NoteBuffer::find_depth_tag (iter);
 
       // If we are at a character with a depth tag we are at the
       // start of a bulleted line
@@ -1328,7 +1342,7 @@ namespace gnote {
       if (iter.get_line() < buffer->get_line_count() - 1) {
         Gtk::TextIter next_line = buffer->get_iter_at_line(iter.get_line()+1);
         next_line_has_depth =
-          NoteBuffer::Ptr::cast_static(buffer)->find_depth_tag (next_line);
+          NoteBuffer::find_depth_tag (next_line);
       }
 
       bool at_empty_line = iter.ends_line () && iter.starts_line ();
@@ -1417,8 +1431,6 @@ namespace gnote {
       tag_stack.pop();
       write_tag (tail_tag, xml, false);
     }
-
-    xml.write_end_element (); // </note-content>
   }
 
 
@@ -1578,4 +1590,244 @@ namespace gnote {
     }
   }
 
+
+  namespace {
+    // Edits only serialize blocks they touch, but smaller blocks cost more
+    // to keep track of
+    const int MIN_BLOCK_CHARS = 4096;
+  }
+
+  NoteBufferBlockArchiver::NoteBufferBlockArchiver(Gtk::TextBuffer & buffer)
+    : m_buffer(buffer)
+  {
+    m_connections.push_back(m_buffer.signal_insert()
+      .connect(sigc::mem_fun(*this, &NoteBufferBlockArchiver::on_insert)));
+    m_connections.push_back(m_buffer.signal_insert_child_anchor()
+      .connect(sigc::mem_fun(*this, &NoteBufferBlockArchiver::on_insert_anchor)));
+    m_connections.push_back(m_buffer.signal_insert_pixbuf()
+      .connect(sigc::mem_fun(*this, &NoteBufferBlockArchiver::on_insert_pixbuf)));
+    m_connections.push_back(m_buffer.signal_erase()
+      .connect(sigc::mem_fun(*this, &NoteBufferBlockArchiver::on_erase)));
+    m_connections.push_back(m_buffer.signal_apply_tag()
+      .connect(sigc::mem_fun(*this, &NoteBufferBlockArchiver::on_tag_changed)));
+    m_connections.push_back(m_buffer.signal_remove_tag()
+      .connect(sigc::mem_fun(*this, &NoteBufferBlockArchiver::on_tag_changed)));
+  }
+
+  NoteBufferBlockArchiver::~NoteBufferBlockArchiver()
+  {
+    FOREACH(sigc::connection & conn, m_connections) {
+      conn.disconnect();
+    }
+    FOREACH(const Block & block, m_blocks) {
+      m_buffer.delete_mark(block.start);
+    }
+  }
+
+  std::string NoteBufferBlockArchiver::serialize()
+  {
+    update_blocks();
+
+    std::string content;
+    FOREACH(const Block & block, m_blocks) {
+      content += block.xml;
+    }
+
+    sharp::XmlWriter xml;
+    NoteBufferArchiver::write_content_start(xml);
+    if(!content.empty()) {
+      xml.write_raw(content);
+    }
+    xml.write_end_element();
+    xml.close();
+    return xml.to_string();
+  }
+
+  bool NoteBufferBlockArchiver::tag_is_written(const Glib::RefPtr<const Gtk::TextTag> & tag)
+  {
+    return NoteTagTable::tag_is_serializable(tag);
+  }
+
+  bool NoteBufferBlockArchiver::is_block_boundary(const Gtk::TextIter & iter)
+  {
+    if(iter.is_start()) {
+      return true;
+    }
+    if(!iter.starts_line() || iter.is_end()) {
+      return false;
+    }
+
+    // Lists are written across lines
+    Gtk::TextIter line = iter;
+    if(NoteBuffer::find_depth_tag(line)) {
+      return false;
+    }
+    line.backward_line();
+    if(NoteBuffer::find_depth_tag(line)) {
+      return false;
+    }
+
+    // So are tags, that continue from the previous line
+    Gtk::TextIter prev = iter;
+    prev.backward_char();
+    Glib::SListHandle<Glib::RefPtr<const Gtk::TextTag> > tag_list = prev.get_tags();
+    for(Glib::SListHandle<Glib::RefPtr<const Gtk::TextTag> >::const_iterator tag_iter = tag_list.begin();
+        tag_iter != tag_list.end(); ++tag_iter) {
+      if(tag_is_written(*tag_iter) && iter.has_tag(*tag_iter)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::string NoteBufferBlockArchiver::serialize_block(const Gtk::TextIter & start, const Gtk::TextIter & end)
+  {
+    // Text writer escapes text only inside of an element
+    sharp::XmlWriter xml;
+    xml.write_start_element("", "block", "");
+    NoteBufferArchiver::serialize_content(start.get_buffer(), start, end, xml);
+    xml.write_end_element();
+    xml.close();
+    std::string block = xml.to_string();
+
+    const std::string start_tag = "<block>";
+    std::string::size_type end_tag = block.rfind("</block>");
+    if(block.compare(0, start_tag.size(), start_tag) != 0 || end_tag == std::string::npos) {
+      return ""; // <block/>
+    }
+    return block.substr(start_tag.size(), end_tag - start_tag.size());
+  }
+
+  void NoteBufferBlockArchiver::update_blocks()
+  {
+    if(m_blocks.empty()) {
+      Block block;
+      block.start = m_buffer.create_mark(m_buffer.begin(), true);
+      block.dirty = true;
+      m_blocks.push_back(block);
+    }
+
+    // Merge blocks emptied by erasing text or no longer starting
+    // at a boundary into the previous block
+    BlockList::size_type i = 1;
+    while(i < m_blocks.size()) {
+      Gtk::TextIter iter = m_blocks[i].start->get_iter();
+      bool check = m_blocks[i].dirty || m_blocks[i - 1].dirty;
+      if(iter.get_offset() <= m_blocks[i - 1].start->get_iter().get_offset()
+         || (check && !is_block_boundary(iter))) {
+        m_buffer.delete_mark(m_blocks[i].start);
+        m_blocks.erase(m_blocks.begin() + i);
+        m_blocks[i - 1].dirty = true;
+      }
+      else {
+        ++i;
+      }
+    }
+
+    BlockList blocks;
+    i = 0;
+    while(i < m_blocks.size()) {
+      if(!m_blocks[i].dirty) {
+        blocks.push_back(m_blocks[i++]);
+        continue;
+      }
+
+      // Serialize the run of dirty blocks again
+      BlockList::size_type next = i + 1;
+      while(next < m_blocks.size() && m_blocks[next].dirty) {
+        m_buffer.delete_mark(m_blocks[next++].start);
+      }
+      Gtk::TextIter end = next < m_blocks.size() ? m_blocks[next].start->get_iter() : m_buffer.end();
+      BlockList::size_type first = blocks.size();
+      split_blocks(m_blocks[i].start->get_iter(), end, blocks);
+      m_buffer.delete_mark(blocks[first].start);
+      blocks[first].start = m_blocks[i].start;
+      i = next;
+    }
+    m_blocks.swap(blocks);
+  }
+
+  void NoteBufferBlockArchiver::split_blocks(const Gtk::TextIter & start, const Gtk::TextIter & end,
+                                             BlockList & blocks)
+  {
+    Gtk::TextIter block_start = start;
+    Gtk::TextIter iter = start;
+    while(true) {
+      bool last = !iter.forward_line() || iter.compare(end) >= 0;
+      if(last || (iter.get_offset() - block_start.get_offset() >= MIN_BLOCK_CHARS
+                  && is_block_boundary(iter))) {
+        Block block;
+        Gtk::TextIter block_end = last ? end : iter;
+        block.start = m_buffer.create_mark(block_start, true);
+        block.xml = serialize_block(block_start, block_end);
+        block.dirty = false;
+        blocks.push_back(block);
+        if(last) {
+          break;
+        }
+        block_start = iter;
+      }
+    }
+  }
+
+  NoteBufferBlockArchiver::BlockList::size_type NoteBufferBlockArchiver::find_block(int offset) const
+  {
+    // last block starting at or before offset
+    BlockList::size_type low = 0, high = m_blocks.size();
+    while(high - low > 1) {
+      BlockList::size_type mid = (low + high) / 2;
+      if(m_blocks[mid].start->get_iter().get_offset() <= offset) {
+        low = mid;
+      }
+      else {
+        high = mid;
+      }
+    }
+    return low;
+  }
+
+  void NoteBufferBlockArchiver::mark_dirty(int start, int end)
+  {
+    if(m_blocks.empty()) {
+      return;
+    }
+    // Characters next to the change decide, whether block boundaries stay
+    BlockList::size_type last = find_block(end + 1);
+    for(BlockList::size_type i = find_block(std::max(start - 1, 0)); i <= last; ++i) {
+      m_blocks[i].dirty = true;
+    }
+  }
+
+  void NoteBufferBlockArchiver::on_insert(const Gtk::TextIter & pos, const Glib::ustring & text, int)
+  {
+    // pos is after the inserted text
+    int end = pos.get_offset();
+    mark_dirty(end - text.size(), end);
+  }
+
+  void NoteBufferBlockArchiver::on_insert_anchor(const Gtk::TextIter & pos,
+                                                 const Glib::RefPtr<Gtk::TextChildAnchor> &)
+  {
+    mark_dirty(pos.get_offset() - 1, pos.get_offset());
+  }
+
+  void NoteBufferBlockArchiver::on_insert_pixbuf(const Gtk::TextIter & pos, const Glib::RefPtr<Gdk::Pixbuf> &)
+  {
+    mark_dirty(pos.get_offset() - 1, pos.get_offset());
+  }
+
+  void NoteBufferBlockArchiver::on_erase(const Gtk::TextIter & start, const Gtk::TextIter &)
+  {
+    // Text is already erased, both iterators are at the same place
+    mark_dirty(start.get_offset(), start.get_offset());
+  }
+
+  void NoteBufferBlockArchiver::on_tag_changed(const Glib::RefPtr<Gtk::TextTag> & tag,
+                                               const Gtk::TextIter & start, const Gtk::TextIter & end)
+  {
+    if(tag_is_written(tag)) {
+      mark_dirty(start.get_offset(), end.get_offset());
+    }
+  }
+
 }
@@ -25,6 +25,7 @@
 #define __NOTE_BUFFER_HPP_
 
 #include <queue>
+#include <vector>
 
 #include <pangomm/context.h>
 
@@ -108,7 +109,7 @@ public:
   void remove_bullet(Gtk::TextIter & iter);
   void increase_depth(Gtk::TextIter & start);
   void decrease_depth(Gtk::TextIter & start);
-  DepthNoteTag::Ptr find_depth_tag(Gtk::TextIter &);
+  static DepthNoteTag::Ptr find_depth_tag(Gtk::TextIter &);
   static bool is_bullet(gunichar c);
   void select_note_body();
 protected: 
@@ -169,7 +170,11 @@ public:
   static void deserialize(const Glib::RefPtr<Gtk::TextBuffer> & buffer, 
                           const Gtk::TextIter & iter, sharp::XmlReader & xml);
 private:
+  friend class NoteBufferBlockArchiver;
 
+  static void write_content_start(sharp::XmlWriter & xml);
+  static void serialize_content(const Glib::RefPtr<Gtk::TextBuffer> & buffer, const Gtk::TextIter &,
+                                const Gtk::TextIter &, sharp::XmlWriter & xml);
   static void write_tag(const Glib::RefPtr<const Gtk::TextTag> & tag, sharp::XmlWriter & xml, 
                         bool start);
   static bool tag_ends_here (const Glib::RefPtr<const Gtk::TextTag> & tag,
@@ -180,6 +185,50 @@ private:
 };
 
 
+/**
+ * Serializes a buffer in blocks of paragraphs and keeps the XML of each
+ * block. Blocks are split only between lines, that no tag or list spans,
+ * so joined together they give the same XML as NoteBufferArchiver.
+ * Only blocks touched by edits since the last call are serialized again.
+ * Has to be deleted before the buffer.
+ */
+class NoteBufferBlockArchiver
+{
+public:
+  explicit NoteBufferBlockArchiver(Gtk::TextBuffer & buffer);
+  ~NoteBufferBlockArchiver();
+
+  std::string serialize();
+private:
+  struct Block
+  {
+    Glib::RefPtr<Gtk::TextMark> start;
+    std::string xml;
+    bool dirty;
+  };
+  typedef std::vector<Block> BlockList;
+
+  static bool tag_is_written(const Glib::RefPtr<const Gtk::TextTag> & tag);
+  bool is_block_boundary(const Gtk::TextIter & iter);
+  std::string serialize_block(const Gtk::TextIter & start, const Gtk::TextIter & end);
+  void update_blocks();
+  void split_blocks(const Gtk::TextIter & start, const Gtk::TextIter & end, BlockList & blocks);
+  BlockList::size_type find_block(int offset) const;
+  void mark_dirty(int start, int end);
+  void on_insert(const Gtk::TextIter & pos, const Glib::ustring & text, int bytes);
+  void on_insert_anchor(const Gtk::TextIter & pos, const Glib::RefPtr<Gtk::TextChildAnchor> & anchor);
+  void on_insert_pixbuf(const Gtk::TextIter & pos, const Glib::RefPtr<Gdk::Pixbuf> & pixbuf);
+  void on_erase(const Gtk::TextIter & start, const Gtk::TextIter & end);
+  void on_tag_changed(const Glib::RefPtr<Gtk::TextTag> & tag, const Gtk::TextIter & start,
+                      const Gtk::TextIter & end);
+
+  Gtk::TextBuffer & m_buffer;
+  // ordered by start, blocks emptied by erasing text are dropped on next update
+  BlockList m_blocks;
+  std::vector<sigc::connection> m_connections;
+};
+
+
 }
 
 #endif
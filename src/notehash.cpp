@@ -0,0 +1,204 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include <glibmm/checksum.h>
+
+#include "notehash.hpp"
+#include "notemanagerbase.hpp"
+#include "notemetadatacache.hpp"
+#include "sharp/string.hpp"
+#include "sharp/xmlreader.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+std::vector<std::string> tag_names(const NoteData & data)
+{
+  std::vector<std::string> tags;
+  for(NoteData::TagMap::const_iterator iter = data.tags().begin(); iter != data.tags().end(); ++iter) {
+    tags.push_back(iter->first);
+  }
+  return tags;
+}
+
+void append_escaped(std::string & out, const std::string & value)
+{
+  for(std::string::size_type i = 0; i < value.size(); ++i) {
+    switch(value[i]) {
+    case '&':
+      out += "&amp;";
+      break;
+    case '<':
+      out += "&lt;";
+      break;
+    case '>':
+      out += "&gt;";
+      break;
+    case '"':
+      out += "&quot;";
+      break;
+    case '\r':
+      // line ends are normalized, when a file is parsed
+      if(i + 1 < value.size() && value[i + 1] == '\n') {
+        break;
+      }
+      out += '\n';
+      break;
+    default:
+      out += value[i];
+    }
+  }
+}
+
+// Contents of the note-content element in one form, whatever escaping
+// the writer used: decoded text escaped the same way, tags without
+// namespace declarations and empty elements written in full.
+// Attributes of note-content are left out.
+bool canonical_content(const std::string & text, std::string & canonical)
+{
+  sharp::XmlReader xml;
+  xml.load_buffer(text);
+  if(!xml.read() || xml.get_node_type() != XML_READER_TYPE_ELEMENT || xml.get_name() != "note-content") {
+    return false;
+  }
+  if(xml.is_empty_element()) {
+    return true;
+  }
+  int depth = 0;
+  while(xml.read()) {
+    switch(xml.get_node_type()) {
+    case XML_READER_TYPE_ELEMENT:
+    {
+      std::string name = xml.get_name();
+      bool empty = xml.is_empty_element();
+      canonical += '<';
+      canonical += name;
+      while(xml.move_to_next_attribute()) {
+        std::string attribute = xml.get_name();
+        if(attribute != "xmlns" && attribute.compare(0, 6, "xmlns:") != 0) {
+          canonical += ' ';
+          canonical += attribute;
+          canonical += "=\"";
+          append_escaped(canonical, xml.get_value());
+          canonical += '"';
+        }
+      }
+      canonical += '>';
+      if(empty) {
+        canonical += "</" + name + '>';
+      }
+      else {
+        ++depth;
+      }
+      break;
+    }
+    case XML_READER_TYPE_END_ELEMENT:
+      if(depth == 0) {
+        // </note-content>
+        return true;
+      }
+      --depth;
+      canonical += "</" + xml.get_name() + '>';
+      break;
+    case XML_READER_TYPE_TEXT:
+    case XML_READER_TYPE_CDATA:
+    case XML_READER_TYPE_WHITESPACE:
+    case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+      append_escaped(canonical, xml.get_value());
+      break;
+    default:
+      break;
+    }
+  }
+  return false;
+}
+
+}
+
+
+std::string NoteHash::content_hash(const Glib::ustring & text)
+{
+  std::string canonical;
+  if(canonical_content(text.raw(), canonical)) {
+    return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, canonical);
+  }
+
+  // Not well-formed, hash the raw contents
+  const std::string & raw = text.raw();
+  std::string::size_type start = raw.find("<note-content");
+  std::string::size_type end = raw.rfind("</note-content>");
+  if(start != std::string::npos) {
+    start = raw.find('>', start);
+  }
+  if(start == std::string::npos) {
+    return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, raw);
+  }
+  if(end == std::string::npos || end < start) {
+    // empty element
+    return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, "");
+  }
+  ++start;
+  return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, raw.substr(start, end - start));
+}
+
+std::string NoteHash::note_hash(const Glib::ustring & title, const std::string & content_hash,
+                                const std::vector<std::string> & tags)
+{
+  std::vector<std::string> normalized_tags;
+  for(std::vector<std::string>::const_iterator iter = tags.begin(); iter != tags.end(); ++iter) {
+    normalized_tags.push_back(Glib::ustring(sharp::string_trim(*iter)).lowercase());
+  }
+  std::sort(normalized_tags.begin(), normalized_tags.end());
+
+  std::string data = sharp::string_trim(title);
+  data += '\n';
+  data += content_hash;
+  for(std::vector<std::string>::iterator iter = normalized_tags.begin(); iter != normalized_tags.end(); ++iter) {
+    data += '\n';
+    data += *iter;
+  }
+  return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_SHA1, data);
+}
+
+std::string NoteHash::note_hash(const NoteData & data)
+{
+  return note_hash(data.title(), content_hash(data.text()), tag_names(data));
+}
+
+std::string NoteHash::note_hash(const NoteBase::Ptr & note)
+{
+  const NoteData & data = note->data();
+  std::string hash;
+  if(!data.is_text_loaded()) {
+    // the text has not changed since it was saved or loaded
+    hash = note->manager().metadata_cache().content_hash(note->file_path());
+  }
+  if(hash.empty()) {
+    hash = content_hash(data.text());
+  }
+  // title and tags can change without loading the text
+  return note_hash(data.title(), hash, tag_names(data));
+}
+
+}
@@ -0,0 +1,60 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __NOTEHASH_HPP_
+#define __NOTEHASH_HPP_
+
+#include <string>
+#include <vector>
+
+#include <glibmm/ustring.h>
+
+#include "notebase.hpp"
+
+namespace gnote {
+
+/**
+ * Hash of what synchronization compares in notes: the title, the
+ * contents and the tags. Titles and tags are normalized, the attributes
+ * of the note-content element are left out, so that the hash does not
+ * depend on the program version, that wrote the note.
+ */
+class NoteHash
+{
+public:
+  /**
+   * Hash of note text, as in NoteData::text(). The contents are parsed,
+   * so text escaped by the editor and text read from a file hash the same.
+   */
+  static std::string content_hash(const Glib::ustring & text);
+  /** Hash of a note with %title, text with %content_hash and %tags. */
+  static std::string note_hash(const Glib::ustring & title, const std::string & content_hash,
+                               const std::vector<std::string> & tags);
+  static std::string note_hash(const NoteData & data);
+  /**
+   * Hash of %note. Contents of notes, that are not loaded, are not read,
+   * the hash computed when they were last saved or loaded is used.
+   */
+  static std::string note_hash(const NoteBase::Ptr & note);
+};
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NOTEINDEX_HPP_
+#define __NOTEINDEX_HPP_
+
+#include <string>
+
+#include <glibmm.h>
+
+#include "base/macros.hpp"
+
+namespace gnote {
+
+/**
+ * Constant time lookup of notes by URI and by title, ignoring case.
+ * Titles are not required to be unique, in which case any of the notes
+ * having the title is found.
+ */
+template<class value_t>
+class NoteIndex
+{
+private:
+
+  struct Entry
+  {
+    value_t value;
+    // lower case title, that note is indexed with
+    std::string title_key;
+  };
+
+  typedef unordered_map<std::string, Entry> UriMap;
+  typedef unordered_multimap<std::string, std::string> TitleMap;
+
+  UriMap m_by_uri;
+  // title key -> URI
+  TitleMap m_by_title;
+
+public:
+
+  void add(const std::string & uri, const Glib::ustring & title, const value_t & value)
+  {
+    remove(uri);
+    Entry & entry = m_by_uri[uri];
+    entry.value = value;
+    entry.title_key = title.lowercase();
+    m_by_title.insert(std::make_pair(entry.title_key, uri));
+  }
+
+  void remove(const std::string & uri)
+  {
+    typename UriMap::iterator iter = m_by_uri.find(uri);
+    if (m_by_uri.end() == iter)
+      return;
+
+    remove_title(iter->second.title_key, uri);
+    m_by_uri.erase(iter);
+  }
+
+  void rename(const std::string & uri, const Glib::ustring & title)
+  {
+    typename UriMap::iterator iter = m_by_uri.find(uri);
+    if (m_by_uri.end() == iter)
+      return;
+
+    std::string title_key = title.lowercase();
+    if (iter->second.title_key == title_key)
+      return;
+
+    remove_title(iter->second.title_key, uri);
+    iter->second.title_key = title_key;
+    m_by_title.insert(std::make_pair(title_key, uri));
+  }
+
+  void clear()
+  {
+    m_by_uri.clear();
+    m_by_title.clear();
+  }
+
+  value_t find_by_title(const Glib::ustring & title) const
+  {
+    typename TitleMap::const_iterator iter = m_by_title.find(title.lowercase());
+    if (m_by_title.end() == iter)
+      return value_t();
+
+    return find_by_uri(iter->second);
+  }
+
+  value_t find_by_uri(const std::string & uri) const
+  {
+    typename UriMap::const_iterator iter = m_by_uri.find(uri);
+    if (m_by_uri.end() == iter)
+      return value_t();
+
+    return iter->second.value;
+  }
+
+  size_t size() const
+  {
+    return m_by_uri.size();
+  }
+
+private:
+
+  void remove_title(const std::string & title_key, const std::string & uri)
+  {
+    std::pair<typename TitleMap::iterator, typename TitleMap::iterator> range
+      = m_by_title.equal_range(title_key);
+    for (typename TitleMap::iterator iter = range.first; range.second != iter; ++iter) {
+      if (iter->second == uri) {
+        m_by_title.erase(iter);
+        break;
+      }
+    }
+  }
+
+};
+
+}
+
+#endif
+
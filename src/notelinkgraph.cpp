@@ -0,0 +1,139 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "notelinkgraph.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+const std::string LINK_START = "<link:internal>";
+const std::string LINK_END = "</link:internal>";
+
+}
+
+
+void NoteLinkGraph::extract_links(const std::string & xml_content, LinkSet & links)
+{
+  links.clear();
+  std::string::size_type pos = 0;
+  while((pos = xml_content.find(LINK_START, pos)) != std::string::npos) {
+    pos += LINK_START.size();
+    std::string::size_type end = xml_content.find(LINK_END, pos);
+    if(end == std::string::npos) {
+      break;
+    }
+    // Formatted titles are not links to a note
+    std::string title = xml_content.substr(pos, end - pos);
+    if(title.find('<') == std::string::npos) {
+      links.insert(decode(title));
+    }
+    pos = end + LINK_END.size();
+  }
+}
+
+std::string NoteLinkGraph::decode(const std::string & text)
+{
+  if(text.find('&') == std::string::npos) {
+    return text;
+  }
+
+  std::string result;
+  std::string::size_type pos = 0;
+  while(pos < text.size()) {
+    std::string::size_type amp = text.find('&', pos);
+    std::string::size_type semicolon = amp == std::string::npos ? amp : text.find(';', amp);
+    if(semicolon == std::string::npos) {
+      result += text.substr(pos);
+      break;
+    }
+    result += text.substr(pos, amp - pos);
+    std::string entity = text.substr(amp + 1, semicolon - amp - 1);
+    if(entity == "amp") {
+      result += '&';
+    }
+    else if(entity == "lt") {
+      result += '<';
+    }
+    else if(entity == "gt") {
+      result += '>';
+    }
+    else if(entity == "quot") {
+      result += '"';
+    }
+    else if(entity == "apos") {
+      result += '\'';
+    }
+    else if(entity.size() > 1 && entity[0] == '#') {
+      gunichar c = entity[1] == 'x'
+        ? strtoul(entity.c_str() + 2, NULL, 16) : strtoul(entity.c_str() + 1, NULL, 10);
+      gchar buf[6];
+      result.append(buf, g_unichar_to_utf8(c, buf));
+    }
+    else {
+      result += text.substr(amp, semicolon - amp + 1);
+    }
+    pos = semicolon + 1;
+  }
+  return result;
+}
+
+void NoteLinkGraph::set_links(const std::string & uri, const LinkSet & links)
+{
+  LinkSet & old_links = m_links[uri];
+  for(LinkSet::const_iterator iter = old_links.begin(); iter != old_links.end(); ++iter) {
+    if(links.find(*iter) == links.end()) {
+      LinkMap::iterator backlinks = m_backlinks.find(*iter);
+      backlinks->second.erase(uri);
+      if(backlinks->second.empty()) {
+        m_backlinks.erase(backlinks);
+      }
+    }
+  }
+  for(LinkSet::const_iterator iter = links.begin(); iter != links.end(); ++iter) {
+    m_backlinks[*iter].insert(uri);
+  }
+  old_links = links;
+}
+
+void NoteLinkGraph::remove_note(const std::string & uri)
+{
+  set_links(uri, LinkSet());
+  m_links.erase(uri);
+}
+
+const NoteLinkGraph::LinkSet & NoteLinkGraph::get_links(const std::string & uri) const
+{
+  LinkMap::const_iterator iter = m_links.find(uri);
+  return iter != m_links.end() ? iter->second : m_empty;
+}
+
+const NoteLinkGraph::LinkSet & NoteLinkGraph::get_linking_notes(const std::string & title) const
+{
+  LinkMap::const_iterator iter = m_backlinks.find(title);
+  return iter != m_backlinks.end() ? iter->second : m_empty;
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _NOTELINKGRAPH_HPP_
+#define _NOTELINKGRAPH_HPP_
+
+#include <map>
+#include <set>
+#include <string>
+
+
+namespace gnote {
+
+/**
+ * Links between notes: titles each note links to and notes linking to
+ * each title. Notes are identified by URI. Links are by title, so they
+ * can point to notes, that do not exist.
+ */
+class NoteLinkGraph
+{
+public:
+  typedef std::set<std::string> LinkSet;
+
+  /** Titles of internal links in note %xml_content. */
+  static void extract_links(const std::string & xml_content, LinkSet & links);
+
+  /** Replace links of note %uri. */
+  void set_links(const std::string & uri, const LinkSet & links);
+  void remove_note(const std::string & uri);
+
+  /** Titles, that note %uri links to. */
+  const LinkSet & get_links(const std::string & uri) const;
+  /** URIs of notes, that link to %title. */
+  const LinkSet & get_linking_notes(const std::string & title) const;
+  bool contains(const std::string & uri) const
+    {
+      return m_links.find(uri) != m_links.end();
+    }
+private:
+  typedef std::map<std::string, LinkSet> LinkMap;
+
+  static std::string decode(const std::string & text);
+
+  // note URI -> linked titles
+  LinkMap m_links;
+  // title -> URIs of linking notes
+  LinkMap m_backlinks;
+  LinkSet m_empty;
+};
+
+}
+
+#endif
@@ -23,7 +23,12 @@
 #include <config.h>
 #endif
 
+#include <algorithm>
+#include <vector>
+
 #include <glibmm/i18n.h>
+#include <glibmm/threads.h>
+#include <libxml/parser.h>
 
 #include "applicationaddin.hpp"
 #include "debug.hpp"
@@ -31,12 +36,124 @@
 #include "addinmanager.hpp"
 #include "ignote.hpp"
 #include "itagmanager.hpp"
+#include "notemetadatacache.hpp"
+#include "notesavequeue.hpp"
+#include "notewindow.hpp"
 #include "preferences.hpp"
+#include "searchindex.hpp"
 #include "sharp/directory.hpp"
 #include "sharp/dynamicmodule.hpp"
 
 namespace gnote {
 
+  namespace {
+
+    // Maximum number of threads, reading notes at startup
+    const guint MAX_LOADER_THREADS = 8;
+
+    // Reads note files on worker threads. Note objects are created by the
+    // caller on the main thread, from batches of read note data.
+    class NoteLoader
+    {
+    public:
+      struct LoadedNote
+      {
+        std::string file_path;
+        NoteData *data;
+        std::string error;
+      };
+      typedef std::vector<LoadedNote> Batch;
+
+      NoteLoader(const std::list<std::string> & files);
+      ~NoteLoader();
+      // Wait for read notes, returns false when all notes are returned
+      bool next_batch(Batch & batch);
+    private:
+      void load_notes();
+
+      std::vector<std::string> m_files;
+      std::vector<std::string>::size_type m_next_file;
+      std::vector<std::string>::size_type m_returned;
+      Batch m_loaded;
+      std::vector<Glib::Threads::Thread*> m_threads;
+      Glib::Threads::Mutex m_mutex;
+      Glib::Threads::Cond m_cond;
+    };
+
+    NoteLoader::NoteLoader(const std::list<std::string> & files)
+      : m_files(files.begin(), files.end())
+      , m_next_file(0)
+      , m_returned(0)
+    {
+      // libxml has to be initialized before using it from several threads
+      xmlInitParser();
+      guint thread_count = std::min(std::min(g_get_num_processors(), MAX_LOADER_THREADS),
+                                    guint(m_files.size()));
+      for(guint i = 0; i < thread_count; ++i) {
+        m_threads.push_back(Glib::Threads::Thread::create(sigc::mem_fun(*this, &NoteLoader::load_notes)));
+      }
+    }
+
+    NoteLoader::~NoteLoader()
+    {
+      FOREACH(Glib::Threads::Thread *thread, m_threads) {
+        thread->join();
+      }
+      FOREACH(const LoadedNote & note, m_loaded) {
+        delete note.data;
+      }
+    }
+
+    bool NoteLoader::next_batch(Batch & batch)
+    {
+      batch.clear();
+      Glib::Threads::Mutex::Lock lock(m_mutex);
+      while(m_loaded.empty() && m_returned < m_files.size()) {
+        m_cond.wait(m_mutex);
+      }
+      if(m_loaded.empty()) {
+        return false;
+      }
+      batch.swap(m_loaded);
+      m_returned += batch.size();
+      return true;
+    }
+
+    void NoteLoader::load_notes()
+    {
+      while(true) {
+        LoadedNote note;
+        {
+          Glib::Threads::Mutex::Lock lock(m_mutex);
+          if(m_next_file == m_files.size()) {
+            return;
+          }
+          note.file_path = m_files[m_next_file++];
+        }
+
+        note.data = new NoteData(NoteBase::url_from_path(note.file_path));
+        try {
+          NoteArchiver::read(note.file_path, *note.data);
+        }
+        catch(const std::exception & e) {
+          delete note.data;
+          note.data = NULL;
+          note.error = e.what();
+        }
+        catch(...) {
+          delete note.data;
+          note.data = NULL;
+        }
+
+        Glib::Threads::Mutex::Lock lock(m_mutex);
+        m_loaded.push_back(note);
+        m_cond.signal();
+      }
+    }
+
+  }
+
+
   NoteManager::NoteManager(const Glib::ustring & directory)
     : NoteManagerBase(directory)
   {
@@ -59,6 +176,9 @@ namespace gnote {
     // StartNoteUri property doesn't generate a call to
     // Preferences.Get () each time it's accessed.
     m_start_note_uri = settings->get_string(Preferences::START_NOTE_URI);
+    update_body_cache_budget();
+    save_queue().set_sync_to_disk(settings->get_boolean(Preferences::SYNC_NOTE_FILES));
+    save_queue().signal_write_failed.connect(sigc::mem_fun(*this, &NoteManager::on_note_write_failed));
     settings->signal_changed().connect(sigc::mem_fun(*this, &NoteManager::on_setting_changed));
 
     m_addin_mgr = create_addin_manager ();
@@ -111,6 +231,47 @@ namespace gnote {
       m_start_note_uri = Preferences::obj()
         .get_schema_settings(Preferences::SCHEMA_GNOTE)->get_string(Preferences::START_NOTE_URI);
     }
+    else if(key == Preferences::NOTE_CONTENTS_MEMORY) {
+      update_body_cache_budget();
+    }
+    else if(key == Preferences::SYNC_NOTE_FILES) {
+      save_queue().set_sync_to_disk(Preferences::obj()
+        .get_schema_settings(Preferences::SCHEMA_GNOTE)->get_boolean(Preferences::SYNC_NOTE_FILES));
+    }
+  }
+
+  void NoteManager::update_body_cache_budget()
+  {
+    int megabytes = Preferences::obj().get_schema_settings(Preferences::SCHEMA_GNOTE)
+      ->get_int(Preferences::NOTE_CONTENTS_MEMORY);
+    body_cache().set_budget(std::max(megabytes, 0) * gsize(1024 * 1024));
+  }
+
+  void NoteManager::on_note_write_failed(const std::string & file_path)
+  {
+    Gtk::Window *parent = NULL;
+    FOREACH(const NoteBase::Ptr & iter, get_notes()) {
+      if(iter->file_path() == file_path) {
+        Note::Ptr note = static_pointer_cast<Note>(iter);
+        if(note->has_window() && note->get_window()->host()) {
+          parent = dynamic_cast<Gtk::Window*>(note->get_window()->host());
+        }
+        break;
+      }
+    }
+
+    utils::HIGMessageDialog dialog(
+                            parent,
+                            GTK_DIALOG_DESTROY_WITH_PARENT,
+                            Gtk::MESSAGE_ERROR,
+                            Gtk::BUTTONS_OK,
+                            _("Error saving note data."),
+                            _("An error occurred while saving your notes. "
+                              "Please check that you have sufficient disk "
+                              "space, and that you have appropriate rights "
+                              "on ~/.local/share/gnote. Error details can be found in "
+                              "~/.gnote.log."));
+    dialog.run();
   }
 
   AddinManager *NoteManager::create_addin_manager()
@@ -181,20 +342,44 @@ namespace gnote {
 
   void NoteManager::load_notes()
   {
-    std::list<std::string> files;
+    std::list<std::string> files, changed_files;
     sharp::directory_get_files_with_ext(notes_dir(), ".note", files);
 
-    for(std::list<std::string>::const_iterator iter = files.begin();
-        iter != files.end(); ++iter) {
-      const std::string & file_path(*iter);
-      try {
-        Note::Ptr note = Note::load(file_path, *this);
+    // Notes not modified since last run are created from the metadata
+    // cache, their contents are read when needed
+    NoteMetadataCache & cache = metadata_cache();
+    cache.load();
+    FOREACH(const std::string & file_path, files) {
+      NoteData *data = cache.create_note_data(file_path);
+      if(data) {
+        NoteBase::Ptr note = Note::create_existing_note(data, file_path, *this);
         add_note(note);
-      } 
-      catch (const std::exception & e) {
-        /* TRANSLATORS: first %s is file, second is error */
-        ERR_OUT(_("Error parsing note XML, skipping \"%s\": %s"),
-                file_path.c_str(), e.what());
+        NoteLinkGraph::LinkSet links;
+        cache.get_links(file_path, links);
+        link_graph().set_links(note->uri(), links);
+      }
+      else {
+        changed_files.push_back(file_path);
+      }
+    }
+
+    // Files are parsed in parallel, notes are added as they come.
+    // This still waits for every file: notebooks, synchronization, the
+    // start note and addins expect all notes to be here, once the
+    // manager is constructed.
+    NoteLoader loader(changed_files);
+    NoteLoader::Batch batch;
+    while(loader.next_batch(batch)) {
+      FOREACH(const NoteLoader::LoadedNote & loaded, batch) {
+        if(loaded.data) {
+          cache.update(loaded.file_path, *loaded.data);
+          add_note(Note::create_existing_note(loaded.data, loaded.file_path, *this));
+        }
+        else {
+          /* TRANSLATORS: first %s is file, second is error */
+          ERR_OUT(_("Error parsing note XML, skipping \"%s\": %s"),
+                  loaded.file_path.c_str(), loaded.error.c_str());
+        }
       }
     }
     post_load();
@@ -214,21 +399,6 @@ namespace gnote {
   }
 
 
-  void NoteManager::post_load()
-  {
-    NoteManagerBase::post_load();
-
-    // Load all the addins for our notes.
-    // Iterating through copy of notes list, because list may be
-    // changed when loading addins.
-    NoteBase::List notesCopy(m_notes);
-    FOREACH(const NoteBase::Ptr & iter, notesCopy) {
-      Note::Ptr note(static_pointer_cast<Note>(iter));
-
-      m_addin_mgr->load_addins_for_note (note);
-    }
-  }
-
   void NoteManager::migrate_notes(const std::string & old_note_dir)
   {
     std::list<std::string> files;
@@ -274,10 +444,20 @@ namespace gnote {
       
     // Use a copy of the notes to prevent bug #510442 (crash on exit
     // when iterating the notes to save them.
-    NoteBase::List notesCopy(m_notes);
+    NoteBase::List notesCopy(get_notes());
     FOREACH(const NoteBase::Ptr & note, notesCopy) {
       note->save();
     }
+    save_queue().flush();
+
+    search_index().save();
+    search_index().flush();
+    metadata_cache().save();
+
+    NoteBodyCache & cache = body_cache();
+    DBG_OUT("note contents: %llu hits, %llu misses, %llu evictions",
+            (unsigned long long) cache.hits(), (unsigned long long) cache.misses(),
+            (unsigned long long) cache.evictions());
   }
 
   NoteBase::Ptr NoteManager::note_load(const Glib::ustring & file_name)
@@ -298,18 +478,6 @@ namespace gnote {
     return new_note;
   }
 
-  // Create a new note with the specified Xml content
-  NoteBase::Ptr NoteManager::create_new_note(const Glib::ustring & title, const Glib::ustring & xml_content, 
-                                        const std::string & guid)
-  {
-    NoteBase::Ptr new_note = NoteManagerBase::create_new_note(title, xml_content, guid);
-
-    // Load all the addins for the new note
-    m_addin_mgr->load_addins_for_note(static_pointer_cast<Note>(new_note));
-
-    return new_note;
-  }
-
   NoteBase::Ptr NoteManager::note_create_new(const Glib::ustring & title, const Glib::ustring & file_name)
   {
     return Note::create_new_note(title, file_name, *this);
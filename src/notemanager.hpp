@@ -54,20 +54,20 @@ namespace gnote {
     using NoteManagerBase::create_note_from_template;
   protected:
     virtual void _common_init(const Glib::ustring & directory, const Glib::ustring & backup) override;
-    virtual void post_load() override;
     virtual void migrate_notes(const std::string & old_note_dir) override;
     virtual NoteBase::Ptr create_note_from_template(const Glib::ustring & title,
                                                     const NoteBase::Ptr & template_note,
                                                     const std::string & guid) override;
     virtual NoteBase::Ptr create_new_note(Glib::ustring title, const std::string & guid) override;
-    virtual NoteBase::Ptr create_new_note(const Glib::ustring & title, const Glib::ustring & xml_content,
-                                          const std::string & guid) override;
+    using NoteManagerBase::create_new_note;
     virtual NoteBase::Ptr note_create_new(const Glib::ustring & title, const Glib::ustring & file_name) override;
     virtual NoteBase::Ptr note_load(const Glib::ustring & file_name) override;
   private:
     AddinManager *create_addin_manager();
     void create_start_notes();
     void load_notes();
+    void update_body_cache_budget();
+    void on_note_write_failed(const std::string & file_path);
     void on_exiting_event();
 
     AddinManager   *m_addin_mgr;
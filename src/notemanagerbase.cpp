@@ -19,7 +19,6 @@
  */
 
 
-#include <boost/bind.hpp>
 #include <boost/format.hpp>
 #include <glibmm/i18n.h>
 
@@ -27,6 +26,9 @@
 #include "ignote.hpp"
 #include "itagmanager.hpp"
 #include "notemanagerbase.hpp"
+#include "notemetadatacache.hpp"
+#include "notesavequeue.hpp"
+#include "searchindex.hpp"
 #include "utils.hpp"
 #include "trie.hpp"
 #include "notebooks/notebookmanager.hpp"
@@ -38,12 +40,6 @@
 
 namespace gnote {
 
-bool compare_dates(const NoteBase::Ptr & a, const NoteBase::Ptr & b)
-{
-  return (static_pointer_cast<Note>(a)->change_date() > static_pointer_cast<Note>(b)->change_date());
-}
-
-
 class TrieController
 {
 public:
@@ -51,6 +47,7 @@ public:
   ~TrieController();
 
   void add_note(const NoteBase::Ptr & note);
+  void remove_note(const NoteBase::Ptr & note);
   void update();
   TrieTree<NoteBase::WeakPtr> *title_trie() const
     {
@@ -63,6 +60,8 @@ private:
 
   NoteManagerBase & m_manager;
   TrieTree<NoteBase::WeakPtr> *m_title_trie;
+  // note URI -> title, the note is in the trie with
+  std::map<std::string, Glib::ustring> m_note_titles;
 };
 
 
@@ -91,12 +90,19 @@ Glib::ustring NoteManagerBase::sanitize_xml_content(const Glib::ustring & xml_co
 
 
 NoteManagerBase::NoteManagerBase(const Glib::ustring & directory)
-  : m_notes_dir(directory)
+  : m_trie_controller(NULL)
+  , m_search_index(NULL)
+  , m_metadata_cache(NULL)
+  , m_save_queue(NULL)
+  , m_notes_dir(directory)
 {
 }
 
 NoteManagerBase::~NoteManagerBase()
 {
+  delete m_save_queue;
+  delete m_metadata_cache;
+  delete m_search_index;
   delete m_trie_controller;
 }
 
@@ -104,6 +110,7 @@ void NoteManagerBase::_common_init(const Glib::ustring & /*directory*/, const Gl
 {
   m_default_note_template_title = _("New Note Template");
   m_backup_dir = backup_directory;
+  m_save_queue = new NoteSaveQueue;
   bool is_first_run = first_run();
 
   const std::string old_note_dir = IGnote::old_note_dir();
@@ -115,6 +122,10 @@ void NoteManagerBase::_common_init(const Glib::ustring & /*directory*/, const Gl
   }
 
   m_trie_controller = create_trie_controller();
+  m_search_index = new SearchIndex(*this, Glib::build_filename(notes_dir(), SearchIndex::INDEX_DIR_NAME,
+                                                               "search-index"));
+  m_metadata_cache = new NoteMetadataCache(*this, Glib::build_filename(notes_dir(), SearchIndex::INDEX_DIR_NAME,
+                                                                       "metadata-cache"));
 
   create_notes_dir();
 }
@@ -153,10 +164,10 @@ TrieController *NoteManagerBase::create_trie_controller()
 
 void NoteManagerBase::post_load()
 {
-  m_notes.sort(boost::bind(&compare_dates, _1, _2));
-
   // Update the trie so addins can access it, if they want.
   m_trie_controller->update ();
+
+  m_search_index->load();
 }
 
 size_t NoteManagerBase::trie_max_length()
@@ -169,59 +180,94 @@ TrieHit<NoteBase::WeakPtr>::ListPtr NoteManagerBase::find_trie_matches(const Gli
   return m_trie_controller->title_trie()->find_matches(match);
 }
 
-NoteBase::List NoteManagerBase::get_notes_linking_to(const Glib::ustring & title) const
+NoteBase::List NoteManagerBase::get_notes_linking_to(const Glib::ustring & title)
 {
-  Glib::ustring tag = "<link:internal>" + utils::XmlEncoder::encode(title) + "</link:internal>";
   NoteBase::List result;
-  FOREACH(const NoteBase::Ptr & note, m_notes) {
-    if(note->get_title() != title) {
-      if(note->get_complete_note_xml().find(tag) != std::string::npos) {
-        result.push_back(note);
-      }
+  FOREACH(const std::string & uri, link_graph().get_linking_notes(title)) {
+    NoteBase::Ptr note = find_by_uri(uri);
+    if(note && note->get_title() != title) {
+      result.push_back(note);
     }
   }
   return result;
 }
 
+NoteLinkGraph & NoteManagerBase::link_graph()
+{
+  FOREACH(const std::string & uri, m_outdated_links) {
+    NoteBase::Ptr note = find_by_uri(uri);
+    if(note) {
+      update_links(note);
+    }
+  }
+  m_outdated_links.clear();
+  return m_link_graph;
+}
+
+void NoteManagerBase::queue_links_update(const std::string & uri)
+{
+  m_outdated_links.insert(uri);
+}
+
+void NoteManagerBase::update_links(const NoteBase::Ptr & note)
+{
+  // Contents, that are not in memory, did not change since links were known
+  if(!note->is_body_loaded()) {
+    return;
+  }
+  NoteLinkGraph::LinkSet links;
+  NoteLinkGraph::extract_links(note->xml_content(), links);
+  m_link_graph.set_links(note->uri(), links);
+}
+
 void NoteManagerBase::add_note(const NoteBase::Ptr & note)
 {
   if(note) {
     note->signal_renamed.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_rename));
     note->signal_saved.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_save));
-    m_notes.push_back(note);
+    note->signal_tag_removed.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_tag_removed));
+    m_notes.add(note->uri(), note->change_date(), note);
+    m_note_index.add(note->uri(), note->get_title(), note);
+    if(note->is_body_loaded()) {
+      m_body_cache.note_loaded(note);
+      update_links(note);
+    }
   }
 }
 
+void NoteManagerBase::note_title_changed(const NoteBase::Ptr & note)
+{
+  m_note_index.rename(note->uri(), note->get_title());
+}
+
 void NoteManagerBase::on_note_rename(const NoteBase::Ptr & note, const Glib::ustring & old_title)
 {
+  note_title_changed(note);
   signal_note_renamed(note, old_title);
-  m_notes.sort(boost::bind(&compare_dates, _1, _2));
+  m_notes.update(note->uri(), note->change_date());
 }
 
 void NoteManagerBase::on_note_save (const NoteBase::Ptr & note)
 {
+  m_outdated_links.erase(note->uri());
+  update_links(note);
   signal_note_saved(note);
-  m_notes.sort(boost::bind(&compare_dates, _1, _2));
+  m_notes.update(note->uri(), note->change_date());
+}
+
+void NoteManagerBase::on_note_tag_removed(const NoteBase::Ptr & note, const std::string & tag_name)
+{
+  signal_note_tag_removed(note, tag_name);
 }
 
 NoteBase::Ptr NoteManagerBase::find(const Glib::ustring & linked_title) const
 {
-  FOREACH(const NoteBase::Ptr & note, m_notes) {
-    if(note->get_title().lowercase() == linked_title.lowercase()) {
-      return note;
-    }
-  }
-  return NoteBase::Ptr();
+  return m_note_index.find_by_title(linked_title);
 }
 
 NoteBase::Ptr NoteManagerBase::find_by_uri(const std::string & uri) const
 {
-  FOREACH(const NoteBase::Ptr & note, m_notes) {
-    if (note->uri() == uri) {
-      return note;
-    }
-  }
-  return NoteBase::Ptr();
+  return m_note_index.find_by_uri(uri);
 }
 
 NoteBase::Ptr NoteManagerBase::create_note_from_template(const Glib::ustring & title, const NoteBase::Ptr & template_note)
@@ -336,10 +382,7 @@ NoteBase::Ptr NoteManagerBase::create_new_note(const Glib::ustring & title, cons
 
   NoteBase::Ptr new_note = note_create_new(title, filename);
   new_note->set_xml_content(xml_content);
-  new_note->signal_renamed.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_rename));
-  new_note->signal_saved.connect(sigc::mem_fun(*this, &NoteManagerBase::on_note_save));
-
-  m_notes.push_back(new_note);
+  add_note(new_note);
 
   signal_note_added(new_note);
 
@@ -435,6 +478,7 @@ NoteBase::Ptr NoteManagerBase::find_template_note() const
 
 void NoteManagerBase::delete_note(const NoteBase::Ptr & note)
 {
+  m_save_queue->cancel(note->file_path());
   if(sharp::file_exists(note->file_path())) {
     if(!m_backup_dir.empty()) {
       if(!sharp::directory_exists(m_backup_dir)) {
@@ -454,7 +498,11 @@ void NoteManagerBase::delete_note(const NoteBase::Ptr & note)
     }
   }
 
-  m_notes.remove(note);
+  m_notes.remove(note->uri());
+  m_note_index.remove(note->uri());
+  m_body_cache.remove_note(note->uri());
+  m_link_graph.remove_note(note->uri());
+  m_outdated_links.erase(note->uri());
   note->delete_note();
 
   DBG_OUT("Deleting note '%s'.", note->get_title().c_str());
@@ -513,20 +561,41 @@ void TrieController::on_note_added(const NoteBase::Ptr & note)
   add_note(note);
 }
 
-void TrieController::on_note_deleted(const NoteBase::Ptr &)
+void TrieController::on_note_deleted(const NoteBase::Ptr & deleted)
 {
-  update();
+  remove_note(deleted);
 }
 
-void TrieController::on_note_renamed(const NoteBase::Ptr &, const Glib::ustring &)
+// Old title is not reliable (see NoteBase::rename_without_link_update),
+// the title note was added with is used instead.
+void TrieController::on_note_renamed(const NoteBase::Ptr & renamed, const Glib::ustring &)
 {
-  update();
+  remove_note(renamed);
+  add_note(renamed);
 }
 
+// Once compiled, the trie repairs only the links affected by a change.
 void TrieController::add_note(const NoteBase::Ptr & note)
 {
   m_title_trie->add_keyword(note->get_title(), note);
-  m_title_trie->compute_failure_graph();
+  m_note_titles[note->uri()] = note->get_title();
+}
+
+void TrieController::remove_note(const NoteBase::Ptr & note)
+{
+  std::map<std::string, Glib::ustring>::iterator iter = m_note_titles.find(note->uri());
+  if(iter == m_note_titles.end()) {
+    return;
+  }
+  Glib::ustring title = iter->second;
+  m_note_titles.erase(iter);
+
+  m_title_trie->remove_keyword(title);
+  // Other note may have the same title in different case
+  NoteBase::Ptr other = m_manager.find(title);
+  if(other && other != note) {
+    add_note(other);
+  }
 }
 
 void TrieController::update()
@@ -535,9 +604,10 @@ void TrieController::update()
     delete m_title_trie;
   }
   m_title_trie = new TrieTree<NoteBase::WeakPtr>(false /* !case_sensitive */);
+  m_note_titles.clear();
 
   FOREACH(const NoteBase::Ptr & note, m_manager.get_notes()) {
-    m_title_trie->add_keyword(note->get_title(), note);
+    add_note(note);
   }
   m_title_trie->compute_failure_graph();
 }
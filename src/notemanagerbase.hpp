@@ -23,11 +23,18 @@
 #define _NOTEMANAGERBASE_HPP_
 
 #include "notebase.hpp"
+#include "notebodycache.hpp"
+#include "noteindex.hpp"
+#include "notelinkgraph.hpp"
+#include "noteorder.hpp"
 #include "triehit.hpp"
 
 
 namespace gnote {
 
+class NoteMetadataCache;
+class NoteSaveQueue;
+class SearchIndex;
 class TrieController;
 
 class NoteManagerBase
@@ -42,6 +49,22 @@ public:
   NoteManagerBase(const Glib::ustring & directory);
   virtual ~NoteManagerBase();
 
+  SearchIndex & search_index()
+    {
+      return *m_search_index;
+    }
+  NoteMetadataCache & metadata_cache()
+    {
+      return *m_metadata_cache;
+    }
+  NoteBodyCache & body_cache()
+    {
+      return m_body_cache;
+    }
+  NoteSaveQueue & save_queue()
+    {
+      return *m_save_queue;
+    }
   size_t trie_max_length();
   TrieHit<NoteBase::WeakPtr>::ListPtr find_trie_matches(const Glib::ustring &);
 
@@ -55,7 +78,14 @@ public:
     }
   NoteBase::Ptr find(const Glib::ustring &) const;
   NoteBase::Ptr find_by_uri(const std::string &) const;
-  NoteBase::List get_notes_linking_to(const Glib::ustring & title) const;
+  /** Called by notes, when their title changes. */
+  void note_title_changed(const NoteBase::Ptr & note);
+  /** Notes, other than the one titled %title, that link to %title. */
+  NoteBase::List get_notes_linking_to(const Glib::ustring & title);
+  /** Links between notes, including changes not saved yet. */
+  NoteLinkGraph & link_graph();
+  /** Contents of note %uri changed, its links are looked at again when needed. */
+  void queue_links_update(const std::string & uri);
   NoteBase::Ptr create();
   NoteBase::Ptr create(const Glib::ustring & title);
   NoteBase::Ptr create(const Glib::ustring & title, const Glib::ustring & xml_content);
@@ -73,9 +103,10 @@ public:
     {
       return m_notes_dir;
     }
+  /** All notes, most recently changed first. */
   const NoteBase::List & get_notes() const
     { 
-      return m_notes;
+      return m_notes.list();
     }
 
   const std::string & start_note_uri() const
@@ -87,6 +118,7 @@ public:
   ChangedHandler signal_note_added;
   NoteBase::RenamedHandler signal_note_renamed;
   NoteBase::SavedHandler signal_note_saved;
+  NoteBase::TagRemovedHandler signal_note_tag_removed;
 protected:
   virtual void _common_init(const Glib::ustring & directory, const Glib::ustring & backup);
   bool first_run() const;
@@ -96,6 +128,7 @@ protected:
   void add_note(const NoteBase::Ptr &);
   void on_note_rename(const NoteBase::Ptr & note, const Glib::ustring & old_title);
   void on_note_save(const NoteBase::Ptr & note);
+  void on_note_tag_removed(const NoteBase::Ptr & note, const std::string & tag_name);
   virtual NoteBase::Ptr create_note_from_template(const Glib::ustring & title,
                                                   const NoteBase::Ptr & template_note,
                                                   const std::string & guid);
@@ -107,7 +140,7 @@ protected:
   Glib::ustring make_new_file_name(const Glib::ustring & guid) const; //temp
   virtual NoteBase::Ptr note_load(const Glib::ustring & file_name) = 0;
 
-  NoteBase::List m_notes;
+  NoteOrder<NoteBase::Ptr, sharp::DateTime> m_notes;
   std::string m_start_note_uri;
   Glib::ustring m_backup_dir; //temp
   Glib::ustring m_default_note_template_title;  // temp
@@ -115,8 +148,17 @@ private:
   void create_notes_dir() const;
   bool create_directory(const Glib::ustring & directory) const;
   TrieController *create_trie_controller();
+  void update_links(const NoteBase::Ptr & note);
 
   TrieController *m_trie_controller;
+  SearchIndex *m_search_index;
+  NoteMetadataCache *m_metadata_cache;
+  NoteSaveQueue *m_save_queue;
+  NoteIndex<NoteBase::Ptr> m_note_index;
+  NoteBodyCache m_body_cache;
+  NoteLinkGraph m_link_graph;
+  // URIs of notes with changed contents
+  std::set<std::string> m_outdated_links;
   Glib::ustring m_notes_dir;
   bool m_read_only;
 };
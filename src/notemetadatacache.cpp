@@ -0,0 +1,465 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <fstream>
+
+#include <glib/gstdio.h>
+#include <glibmm/i18n.h>
+#include <glibmm/miscutils.h>
+
+#include "debug.hpp"
+#include "itagmanager.hpp"
+#include "notehash.hpp"
+#include "notemanagerbase.hpp"
+#include "notemetadatacache.hpp"
+#include "notesavequeue.hpp"
+#include "sharp/fileinfo.hpp"
+#include "sharp/files.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+const char CACHE_FILE_MAGIC[8] = { 'g', 'n', 'o', 't', 'e', '-', 'm', 'd' };
+const guint32 CACHE_FILE_VERSION = 4;
+// Written in native byte order, snapshot from other machine is discarded
+const guint32 CACHE_BYTE_ORDER = 0x01020304;
+
+// Save the snapshot this long after the last change
+const guint CACHE_SAVE_TIMEOUT = 10000;
+
+
+// Reads values from mapped snapshot, failing on any attempt to read past the end
+class CacheReader
+{
+public:
+  CacheReader(const char *data, gsize length)
+    : m_data(data)
+    , m_end(data + length)
+    , m_ok(true)
+    {}
+
+  bool ok() const
+    {
+      return m_ok;
+    }
+
+  template <typename T>
+  T read()
+    {
+      T value = T();
+      if(check(sizeof(T))) {
+        memcpy(&value, m_data, sizeof(T));
+        m_data += sizeof(T);
+      }
+      return value;
+    }
+
+  std::string read_string()
+    {
+      guint32 length = read<guint32>();
+      if(!check(length)) {
+        return "";
+      }
+      std::string value(m_data, length);
+      m_data += length;
+      return value;
+    }
+
+  void read_magic()
+    {
+      if(check(sizeof(CACHE_FILE_MAGIC))) {
+        m_ok = memcmp(m_data, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC)) == 0;
+        m_data += sizeof(CACHE_FILE_MAGIC);
+      }
+    }
+private:
+  bool check(gsize length)
+    {
+      if(m_ok && gsize(m_end - m_data) < length) {
+        m_ok = false;
+      }
+      return m_ok;
+    }
+
+  const char *m_data;
+  const char *m_end;
+  bool m_ok;
+};
+
+
+template <typename T>
+void write_value(std::ostream & out, T value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void write_string(std::ostream & out, const std::string & value)
+{
+  write_value<guint32>(out, value.size());
+  out.write(value.data(), value.size());
+}
+
+void date_to_record(const sharp::DateTime & date, gint64 *record)
+{
+  record[0] = date.sec();
+  record[1] = date.usec();
+}
+
+sharp::DateTime record_to_date(const gint64 *record)
+{
+  sharp::DateTime date(record[0], record[1]);
+  return date;
+}
+
+}
+
+
+NoteMetadataCache::NoteMetadataCache(NoteManagerBase & manager, const std::string & cache_file)
+  : m_manager(manager)
+  , m_cache_file(cache_file)
+  , m_dirty(false)
+{
+  m_manager.signal_note_saved.connect(sigc::mem_fun(*this, &NoteMetadataCache::on_note_saved));
+  m_manager.signal_note_deleted.connect(sigc::mem_fun(*this, &NoteMetadataCache::on_note_deleted));
+  m_manager.save_queue().signal_written.connect(sigc::mem_fun(*this, &NoteMetadataCache::on_note_written));
+  m_save_timeout.signal_timeout.connect(sigc::mem_fun(*this, &NoteMetadataCache::save));
+}
+
+void NoteMetadataCache::load()
+{
+  if(!read_cache_file()) {
+    m_records.clear();
+  }
+}
+
+bool NoteMetadataCache::read_cache_file()
+{
+  if(!sharp::file_exists(m_cache_file)) {
+    return false;
+  }
+
+  GError *error = NULL;
+  GMappedFile *mapped = g_mapped_file_new(m_cache_file.c_str(), FALSE, &error);
+  if(!mapped) {
+    ERR_OUT(_("Failed to read note metadata cache %s: %s"), m_cache_file.c_str(), error->message);
+    g_error_free(error);
+    return false;
+  }
+
+  CacheReader reader(g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped));
+  reader.read_magic();
+  bool valid = reader.read<guint32>() == CACHE_FILE_VERSION
+               && reader.read<guint32>() == CACHE_BYTE_ORDER
+               && reader.ok();
+  if(valid) {
+    std::vector<std::string> tag_names;
+    guint32 tag_name_count = reader.read<guint32>();
+    for(guint32 i = 0; i < tag_name_count && reader.ok(); ++i) {
+      tag_names.push_back(reader.read_string());
+    }
+
+    guint32 record_count = reader.read<guint32>();
+    for(guint32 i = 0; i < record_count && reader.ok(); ++i) {
+      std::string file_name = reader.read_string();
+      Record & record = m_records[file_name];
+      record.uri = reader.read_string();
+      record.title = reader.read_string();
+      for(int j = 0; j < 2; ++j) {
+        record.create_date[j] = reader.read<gint64>();
+      }
+      for(int j = 0; j < 2; ++j) {
+        record.change_date[j] = reader.read<gint64>();
+      }
+      for(int j = 0; j < 2; ++j) {
+        record.metadata_change_date[j] = reader.read<gint64>();
+      }
+      record.cursor_position = reader.read<gint32>();
+      record.selection_bound_position = reader.read<gint32>();
+      record.width = reader.read<gint32>();
+      record.height = reader.read<gint32>();
+      record.file_mtime = reader.read<gint64>();
+      record.file_size = reader.read<gint64>();
+      record.content_hash = reader.read_string();
+      guint32 tag_count = reader.read<guint32>();
+      for(guint32 j = 0; j < tag_count && reader.ok(); ++j) {
+        guint32 tag_id = reader.read<guint32>();
+        if(tag_id >= tag_names.size()) {
+          valid = false;
+          break;
+        }
+        record.tags.push_back(tag_names[tag_id]);
+      }
+      guint32 link_count = reader.read<guint32>();
+      for(guint32 j = 0; j < link_count && reader.ok(); ++j) {
+        record.links.insert(reader.read_string());
+      }
+    }
+    valid = valid && reader.ok();
+  }
+
+  g_mapped_file_unref(mapped);
+  if(!valid) {
+    ERR_OUT(_("Note metadata cache %s is invalid, ignoring"), m_cache_file.c_str());
+  }
+  return valid;
+}
+
+void NoteMetadataCache::save()
+{
+  m_save_timeout.cancel();
+  if(!m_dirty) {
+    return;
+  }
+
+  std::string dir = sharp::file_dirname(m_cache_file);
+  if(g_mkdir_with_parents(dir.c_str(), S_IRWXU) != 0) {
+    ERR_OUT(_("Failed to create directory %s"), dir.c_str());
+    return;
+  }
+
+  // Only write records of notes, that still exist
+  std::vector<const RecordMap::value_type*> records;
+  std::map<std::string, guint32> tag_ids;
+  std::vector<const std::string*> tag_names;
+  FOREACH(const NoteBase::Ptr & note, m_manager.get_notes()) {
+    RecordMap::iterator iter = m_records.find(Glib::path_get_basename(note->file_path()));
+    if(iter == m_records.end()) {
+      continue;
+    }
+    // Records must match the note files, as they are on disk,
+    // notes still waiting to be written are recorded once they are
+    if(iter->second.file_mtime < 0
+       && (m_manager.save_queue().is_pending(note->file_path())
+           || !stat_file(note->file_path(), iter->second.file_mtime, iter->second.file_size))) {
+      continue;
+    }
+    records.push_back(&*iter);
+    FOREACH(const std::string & tag, iter->second.tags) {
+      if(tag_ids.insert(std::make_pair(tag, tag_names.size())).second) {
+        tag_names.push_back(&tag);
+      }
+    }
+  }
+
+  std::string tmp_file = m_cache_file + ".tmp";
+  std::ofstream fout(tmp_file.c_str(), std::ios::out | std::ios::binary);
+  if(!fout.is_open()) {
+    ERR_OUT(_("Failed to write note metadata cache %s"), tmp_file.c_str());
+    return;
+  }
+
+  fout.write(CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC));
+  write_value<guint32>(fout, CACHE_FILE_VERSION);
+  write_value<guint32>(fout, CACHE_BYTE_ORDER);
+  write_value<guint32>(fout, tag_names.size());
+  FOREACH(const std::string *tag, tag_names) {
+    write_string(fout, *tag);
+  }
+  write_value<guint32>(fout, records.size());
+  FOREACH(const RecordMap::value_type *iter, records) {
+    const Record & record = iter->second;
+    write_string(fout, iter->first);
+    write_string(fout, record.uri);
+    write_string(fout, record.title);
+    for(int i = 0; i < 2; ++i) {
+      write_value<gint64>(fout, record.create_date[i]);
+    }
+    for(int i = 0; i < 2; ++i) {
+      write_value<gint64>(fout, record.change_date[i]);
+    }
+    for(int i = 0; i < 2; ++i) {
+      write_value<gint64>(fout, record.metadata_change_date[i]);
+    }
+    write_value<gint32>(fout, record.cursor_position);
+    write_value<gint32>(fout, record.selection_bound_position);
+    write_value<gint32>(fout, record.width);
+    write_value<gint32>(fout, record.height);
+    write_value<gint64>(fout, record.file_mtime);
+    write_value<gint64>(fout, record.file_size);
+    write_string(fout, record.content_hash);
+    write_value<guint32>(fout, record.tags.size());
+    FOREACH(const std::string & tag, record.tags) {
+      write_value<guint32>(fout, tag_ids[tag]);
+    }
+    write_value<guint32>(fout, record.links.size());
+    FOREACH(const std::string & link, record.links) {
+      write_string(fout, link);
+    }
+  }
+  fout.close();
+
+  if(fout.fail()) {
+    ERR_OUT(_("Failed to write note metadata cache %s"), tmp_file.c_str());
+    sharp::file_delete(tmp_file);
+    return;
+  }
+  sharp::file_move(tmp_file, m_cache_file);
+  m_dirty = false;
+}
+
+NoteData *NoteMetadataCache::create_note_data(const std::string & file_path) const
+{
+  RecordMap::const_iterator iter = m_records.find(Glib::path_get_basename(file_path));
+  if(iter == m_records.end()) {
+    return NULL;
+  }
+
+  const Record & record = iter->second;
+  gint64 mtime, size;
+  if(!stat_file(file_path, mtime, size) || mtime != record.file_mtime || size != record.file_size) {
+    return NULL;
+  }
+
+  NoteData *data = new NoteData(record.uri);
+  data->title() = record.title;
+  data->create_date() = record_to_date(record.create_date);
+  data->set_change_date(record_to_date(record.change_date));
+  data->metadata_change_date() = record_to_date(record.metadata_change_date);
+  data->set_cursor_position(record.cursor_position);
+  data->set_selection_bound_position(record.selection_bound_position);
+  data->width() = record.width;
+  data->height() = record.height;
+  FOREACH(const std::string & tag_name, record.tags) {
+    Tag::Ptr tag = ITagManager::obj().get_or_create_tag(tag_name);
+    data->tags()[tag->normalized_name()] = tag;
+  }
+  data->set_text_file(file_path);
+  return data;
+}
+
+void NoteMetadataCache::update(const std::string & file_path, const NoteData & data)
+{
+  Record record;
+  if(m_manager.save_queue().is_pending(file_path)) {
+    // The file is not written yet, it is looked at when the snapshot is saved
+    record.file_mtime = -1;
+    record.file_size = -1;
+  }
+  else if(!stat_file(file_path, record.file_mtime, record.file_size)) {
+    remove(file_path);
+    return;
+  }
+
+  std::string file_name = Glib::path_get_basename(file_path);
+  record.uri = data.uri();
+  record.title = data.title();
+  date_to_record(data.create_date(), record.create_date);
+  date_to_record(data.change_date(), record.change_date);
+  date_to_record(data.metadata_change_date(), record.metadata_change_date);
+  record.cursor_position = data.cursor_position();
+  record.selection_bound_position = data.selection_bound_position();
+  record.width = data.width();
+  record.height = data.height();
+  for(NoteData::TagMap::const_iterator iter = data.tags().begin(); iter != data.tags().end(); ++iter) {
+    record.tags.push_back(iter->second->name());
+  }
+
+  if(data.is_text_loaded()) {
+    record.content_hash = NoteHash::content_hash(data.text());
+    NoteLinkGraph::extract_links(data.text(), record.links);
+  }
+  else {
+    // Contents were not touched, so they are the same as when recorded
+    record.content_hash = content_hash(file_path);
+    get_links(file_path, record.links);
+  }
+
+  m_records[file_name] = record;
+  queue_save();
+}
+
+void NoteMetadataCache::on_note_written(const std::string & file_path)
+{
+  RecordMap::iterator iter = m_records.find(Glib::path_get_basename(file_path));
+  if(iter == m_records.end() || iter->second.file_mtime >= 0) {
+    return;
+  }
+  // Saved again, while being written; wait for the last write
+  if(m_manager.save_queue().is_pending(file_path)) {
+    return;
+  }
+  if(stat_file(file_path, iter->second.file_mtime, iter->second.file_size)) {
+    queue_save();
+  }
+}
+
+void NoteMetadataCache::remove(const std::string & file_path)
+{
+  if(m_records.erase(Glib::path_get_basename(file_path))) {
+    queue_save();
+  }
+}
+
+std::string NoteMetadataCache::content_hash(const std::string & file_path) const
+{
+  RecordMap::const_iterator iter = m_records.find(Glib::path_get_basename(file_path));
+  if(iter == m_records.end()) {
+    return "";
+  }
+  return iter->second.content_hash;
+}
+
+bool NoteMetadataCache::get_links(const std::string & file_path, NoteLinkGraph::LinkSet & links) const
+{
+  RecordMap::const_iterator iter = m_records.find(Glib::path_get_basename(file_path));
+  if(iter == m_records.end()) {
+    links.clear();
+    return false;
+  }
+  links = iter->second.links;
+  return true;
+}
+
+bool NoteMetadataCache::stat_file(const std::string & file_path, gint64 & mtime, gint64 & size)
+{
+  GStatBuf st;
+  if(g_stat(file_path.c_str(), &st) != 0) {
+    return false;
+  }
+  // Seconds are too coarse to notice quick external edits
+  sharp::DateTime modified = sharp::file_modification_time(file_path);
+  if(!modified.is_valid()) {
+    return false;
+  }
+  mtime = gint64(modified.sec()) * G_USEC_PER_SEC + modified.usec();
+  size = st.st_size;
+  return true;
+}
+
+void NoteMetadataCache::on_note_saved(const NoteBase::Ptr & note)
+{
+  update(note->file_path(), note->data());
+}
+
+void NoteMetadataCache::on_note_deleted(const NoteBase::Ptr & note)
+{
+  remove(note->file_path());
+}
+
+void NoteMetadataCache::queue_save()
+{
+  m_dirty = true;
+  m_save_timeout.reset(CACHE_SAVE_TIMEOUT);
+}
+
+}
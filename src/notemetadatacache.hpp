@@ -0,0 +1,108 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _NOTEMETADATACACHE_HPP_
+#define _NOTEMETADATACACHE_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glibmm/ustring.h>
+
+#include "base/macros.hpp"
+#include "notebase.hpp"
+#include "notelinkgraph.hpp"
+#include "utils.hpp"
+
+
+namespace gnote {
+
+class NoteManagerBase;
+
+
+/**
+ * Binary snapshot of the metadata of all notes, kept next to the notes.
+ * At startup notes, whose files did not change since the snapshot was
+ * written, are created from it without parsing the note files; their
+ * contents are read from the file when first needed.
+ */
+class NoteMetadataCache
+{
+public:
+  NoteMetadataCache(NoteManagerBase & manager, const std::string & cache_file);
+
+  /** Read the snapshot from disk. Invalid or outdated snapshot is ignored. */
+  void load();
+  /** Write the snapshot to disk, if it has changed since it was last written. */
+  void save();
+
+  /**
+   * Create note data for %file_path from the snapshot.
+   * Returns NULL, if the file is not in the snapshot or has been modified
+   * since, in which case the file has to be parsed.
+   */
+  NoteData *create_note_data(const std::string & file_path) const;
+  /** Record the metadata of note data, that was just read from or written to %file_path. */
+  void update(const std::string & file_path, const NoteData & data);
+  void remove(const std::string & file_path);
+
+  /** NoteHash::content_hash() of note contents, empty if the note was never recorded. */
+  std::string content_hash(const std::string & file_path) const;
+  /** Titles, that note in %file_path links to. Returns false, if the note was never recorded. */
+  bool get_links(const std::string & file_path, NoteLinkGraph::LinkSet & links) const;
+private:
+  struct Record
+  {
+    std::string uri;
+    std::string title;
+    gint64 create_date[2];
+    gint64 change_date[2];
+    gint64 metadata_change_date[2];
+    gint32 cursor_position;
+    gint32 selection_bound_position;
+    gint32 width;
+    gint32 height;
+    gint64 file_mtime;
+    gint64 file_size;
+    std::string content_hash;
+    std::vector<std::string> tags;
+    NoteLinkGraph::LinkSet links;
+  };
+  // note file name -> record
+  typedef std::map<std::string, Record> RecordMap;
+
+  static bool stat_file(const std::string & file_path, gint64 & mtime, gint64 & size);
+  bool read_cache_file();
+  void on_note_saved(const NoteBase::Ptr & note);
+  void on_note_deleted(const NoteBase::Ptr & note);
+  void on_note_written(const std::string & file_path);
+  void queue_save();
+
+  NoteManagerBase & m_manager;
+  std::string m_cache_file;
+  RecordMap m_records;
+  bool m_dirty;
+  utils::InterruptableTimeout m_save_timeout;
+};
+
+}
+
+#endif
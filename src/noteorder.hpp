@@ -0,0 +1,111 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __NOTEORDER_HPP_
+#define __NOTEORDER_HPP_
+
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+
+#include "base/macros.hpp"
+
+namespace gnote {
+
+/**
+ * List of notes ordered by a key, largest first, such as the change date.
+ * Adding, removing and moving a note after its key changed take
+ * logarithmic time. Notes with equal keys keep the order they were
+ * added in.
+ */
+template<class value_t, class key_t>
+class NoteOrder
+{
+public:
+  typedef std::list<value_t> List;
+
+  void add(const std::string & uri, const key_t & key, const value_t & value)
+  {
+    remove(uri);
+    typename KeyMap::iterator next = m_by_key.upper_bound(key);
+    typename List::iterator pos = m_list.insert(next == m_by_key.end() ? m_list.end() : next->second, value);
+    m_by_uri[uri] = m_by_key.insert(next, std::make_pair(key, pos));
+  }
+
+  void remove(const std::string & uri)
+  {
+    typename UriMap::iterator iter = m_by_uri.find(uri);
+    if (m_by_uri.end() == iter)
+      return;
+
+    m_list.erase(iter->second->second);
+    m_by_key.erase(iter->second);
+    m_by_uri.erase(iter);
+  }
+
+  /**
+   * Move the note to the position for its new %key.
+   * Iterators to the list stay valid.
+   */
+  void update(const std::string & uri, const key_t & key)
+  {
+    typename UriMap::iterator iter = m_by_uri.find(uri);
+    if (m_by_uri.end() == iter)
+      return;
+
+    typename List::iterator pos = iter->second->second;
+    m_by_key.erase(iter->second);
+    typename KeyMap::iterator next = m_by_key.upper_bound(key);
+    m_list.splice(next == m_by_key.end() ? m_list.end() : next->second, m_list, pos);
+    iter->second = m_by_key.insert(next, std::make_pair(key, pos));
+  }
+
+  void clear()
+  {
+    m_list.clear();
+    m_by_key.clear();
+    m_by_uri.clear();
+  }
+
+  const List & list() const
+  {
+    return m_list;
+  }
+
+  size_t size() const
+  {
+    return m_list.size();
+  }
+
+private:
+
+  typedef std::multimap<key_t, typename List::iterator, std::greater<key_t> > KeyMap;
+  typedef unordered_map<std::string, typename KeyMap::iterator> UriMap;
+
+  List m_list;
+  // key -> position in m_list, largest first
+  KeyMap m_by_key;
+  UriMap m_by_uri;
+};
+
+}
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <glibmm/i18n.h>
+#include <glibmm/miscutils.h>
+#include <libxml/parser.h>
+
+#include "debug.hpp"
+#include "notesavequeue.hpp"
+#include "utils.hpp"
+#include "sharp/exception.hpp"
+
+
+namespace gnote {
+
+NoteSaveQueue::NoteSaveQueue()
+  : m_queued(0)
+  , m_written(0)
+  , m_sync_to_disk(false)
+  , m_stop(false)
+{
+  // libxml has to be initialized before using it from several threads
+  xmlInitParser();
+  m_thread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &NoteSaveQueue::write_notes));
+}
+
+NoteSaveQueue::~NoteSaveQueue()
+{
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    m_stop = true;
+    m_queued_cond.signal();
+  }
+  m_thread->join();
+  clear(m_pending);
+}
+
+bool NoteSaveQueue::queue(const std::string & file_path, const NoteData & data)
+{
+  NoteData *copy = new NoteData(data);
+  // Contents, that were not read from the file yet, have to be read now,
+  // the file is going to be replaced
+  copy->text();
+  if(copy->is_text_failed()) {
+    ERR_OUT(_("Not saving note %s, its contents could not be read"), file_path.c_str());
+    delete copy;
+    return false;
+  }
+
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  std::pair<PendingMap::iterator, bool> res = m_pending.insert(std::make_pair(file_path, copy));
+  if(!res.second) {
+    delete res.first->second;
+    res.first->second = copy;
+  }
+  ++m_queued;
+  m_queued_cond.signal();
+  return true;
+}
+
+void NoteSaveQueue::flush()
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  guint64 queued = m_queued;
+  while(m_written < queued) {
+    m_written_cond.wait(m_mutex);
+  }
+}
+
+void NoteSaveQueue::cancel(const std::string & file_path)
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  PendingMap::iterator iter = m_pending.find(file_path);
+  if(iter != m_pending.end()) {
+    delete iter->second;
+    m_pending.erase(iter);
+  }
+  while(m_writing.find(file_path) != m_writing.end()) {
+    m_written_cond.wait(m_mutex);
+  }
+}
+
+bool NoteSaveQueue::is_pending(const std::string & file_path) const
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  return m_pending.find(file_path) != m_pending.end()
+    || m_writing.find(file_path) != m_writing.end();
+}
+
+bool NoteSaveQueue::get_pending_text(const std::string & file_path, Glib::ustring & text)
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  PendingMap::const_iterator iter = m_pending.find(file_path);
+  if(iter != m_pending.end()) {
+    text = iter->second->text();
+    return true;
+  }
+  while(m_writing.find(file_path) != m_writing.end()) {
+    m_written_cond.wait(m_mutex);
+  }
+  return false;
+}
+
+void NoteSaveQueue::set_sync_to_disk(bool sync)
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  m_sync_to_disk = sync;
+}
+
+void NoteSaveQueue::write_notes()
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  while(true) {
+    while(m_written == m_queued && !m_stop) {
+      m_queued_cond.wait(m_mutex);
+    }
+    if(m_written == m_queued) {
+      return;
+    }
+
+    // Take everything queued so far, notes queued meanwhile go to the next batch
+    PendingMap notes;
+    notes.swap(m_pending);
+    guint64 queued = m_queued;
+    bool sync = m_sync_to_disk;
+    for(PendingMap::const_iterator iter = notes.begin(); iter != notes.end(); ++iter) {
+      m_writing.insert(iter->first);
+    }
+    lock.release();
+
+    std::set<std::string> dirs;
+    std::vector<std::string> written;
+    std::string failed;
+    for(PendingMap::const_iterator iter = notes.begin(); iter != notes.end(); ++iter) {
+      if(write_note(iter->first, *iter->second, sync)) {
+        dirs.insert(Glib::path_get_dirname(iter->first));
+        written.push_back(iter->first);
+      }
+      else if(failed.empty()) {
+        failed = iter->first;
+      }
+    }
+    if(sync) {
+      // Make the renames durable, once per directory rather than per note
+      FOREACH(const std::string & dir, dirs) {
+        sync_directory(dir);
+      }
+    }
+    DBG_OUT("Wrote %d notes", int(notes.size()));
+    clear(notes);
+    if(!failed.empty()) {
+      utils::main_context_invoke(sigc::bind(sigc::mem_fun(*this, &NoteSaveQueue::on_write_failed), failed));
+    }
+
+    lock.acquire();
+    m_writing.clear();
+    m_written = queued;
+    m_written_cond.broadcast();
+    if(!written.empty()) {
+      utils::main_context_invoke(sigc::bind(sigc::mem_fun(*this, &NoteSaveQueue::on_written), written));
+    }
+  }
+}
+
+bool NoteSaveQueue::write_note(const std::string & file_path, const NoteData & data, bool sync)
+{
+  Glib::ustring xml;
+  try {
+    xml = NoteArchiver::write_string(data);
+  }
+  catch(const sharp::Exception & e) {
+    ERR_OUT(_("Exception while saving note: %s"), e.what());
+    return false;
+  }
+
+  std::string tmp_file = file_path + ".tmp";
+  int fd = g_open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if(fd < 0) {
+    ERR_OUT(_("Failed to write note file %s: %s"), tmp_file.c_str(), g_strerror(errno));
+    return false;
+  }
+
+  int error = 0;
+  const char *buf = xml.data();
+  gsize left = xml.bytes();
+  while(left > 0) {
+    ssize_t written = write(fd, buf, left);
+    if(written < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      error = errno;
+      break;
+    }
+    buf += written;
+    left -= written;
+  }
+  if(error == 0 && sync && fsync(fd) != 0) {
+    error = errno;
+  }
+  if(close(fd) != 0 && error == 0) {
+    error = errno;
+  }
+  // Replace the note file in one step, readers see either the old or the new note
+  if(error == 0 && g_rename(tmp_file.c_str(), file_path.c_str()) != 0) {
+    error = errno;
+  }
+
+  if(error != 0) {
+    ERR_OUT(_("Failed to write note file %s: %s"), file_path.c_str(), g_strerror(error));
+    g_unlink(tmp_file.c_str());
+    return false;
+  }
+  return true;
+}
+
+void NoteSaveQueue::sync_directory(const std::string & dir)
+{
+  int fd = g_open(dir.c_str(), O_RDONLY, 0);
+  if(fd < 0) {
+    return;
+  }
+  if(fsync(fd) != 0) {
+    DBG_OUT("Failed to sync directory %s: %s", dir.c_str(), g_strerror(errno));
+  }
+  close(fd);
+}
+
+void NoteSaveQueue::on_write_failed(const std::string & file_path)
+{
+  signal_write_failed(file_path);
+}
+
+void NoteSaveQueue::on_written(const std::vector<std::string> & file_paths)
+{
+  FOREACH(const std::string & file_path, file_paths) {
+    signal_written(file_path);
+  }
+}
+
+void NoteSaveQueue::clear(PendingMap & notes)
+{
+  for(PendingMap::iterator iter = notes.begin(); iter != notes.end(); ++iter) {
+    delete iter->second;
+  }
+  notes.clear();
+}
+
+}
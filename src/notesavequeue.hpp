@@ -0,0 +1,105 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _NOTESAVEQUEUE_HPP_
+#define _NOTESAVEQUEUE_HPP_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <glibmm/threads.h>
+#include <sigc++/signal.h>
+#include <sigc++/trackable.h>
+
+#include "base/macros.hpp"
+#include "notebase.hpp"
+
+
+namespace gnote {
+
+/**
+ * Writes notes to disk on a background thread.
+ * Saving a note takes a copy of its data, so the note can be edited
+ * further while it is being written. Saves of the same note, that were
+ * not written yet, are merged into one. Each note is written to a
+ * temporary file, that then replaces the note file in one rename.
+ */
+class NoteSaveQueue
+  : public sigc::trackable
+{
+public:
+  NoteSaveQueue();
+  /** Writes everything queued before returning. */
+  ~NoteSaveQueue();
+
+  /**
+   * Queue a copy of %data to be written to %file_path.
+   * Returns false, if the note text failed to be read, in which case
+   * nothing is written.
+   */
+  bool queue(const std::string & file_path, const NoteData & data);
+  /** Wait until everything queued so far is on disk. Can be called from any thread. */
+  void flush();
+  /** Drop the not yet written data for %file_path and wait, if it is being written. */
+  void cancel(const std::string & file_path);
+  /** Whether %file_path has data, that is not written yet. */
+  bool is_pending(const std::string & file_path) const;
+  /**
+   * Get the note contents (XML), that are not written to %file_path yet.
+   * Returns false, if the file is up to date, waiting for it to be written,
+   * if it is being written. Can be called from any thread.
+   */
+  bool get_pending_text(const std::string & file_path, Glib::ustring & text);
+
+  /** Whether to wait for files to reach the disk, once per batch of written notes. */
+  void set_sync_to_disk(bool sync);
+
+  /** Emitted on the main thread with the first note file, that failed to be written. */
+  sigc::signal<void, const std::string &> signal_write_failed;
+  /** Emitted on the main thread for every note file written. */
+  sigc::signal<void, const std::string &> signal_written;
+private:
+  // file path -> data to write
+  typedef std::map<std::string, NoteData*> PendingMap;
+
+  void write_notes();
+  static bool write_note(const std::string & file_path, const NoteData & data, bool sync);
+  static void sync_directory(const std::string & dir);
+  static void clear(PendingMap & notes);
+  void on_write_failed(const std::string & file_path);
+  void on_written(const std::vector<std::string> & file_paths);
+
+  mutable Glib::Threads::Mutex m_mutex;
+  Glib::Threads::Cond m_queued_cond;
+  Glib::Threads::Cond m_written_cond;
+  PendingMap m_pending;
+  std::set<std::string> m_writing;
+  guint64 m_queued;
+  guint64 m_written;
+  bool m_sync_to_disk;
+  bool m_stop;
+  Glib::Threads::Thread *m_thread;
+};
+
+}
+
+#endif
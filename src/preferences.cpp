@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2011-2013 Aurimas Cernius
+ * Copyright (C) 2011-2014 Aurimas Cernius
  * Copyright (C) 2009 Hubert Figuiere
  *
  * This program is free software: you can redistribute it and/or modify
@@ -47,6 +47,8 @@ namespace gnote {
   const char * Preferences::CUSTOM_FONT_FACE = "custom-font-face";
   const char * Preferences::MENU_NOTE_COUNT = "menu-note-count";
   const char * Preferences::MENU_PINNED_NOTES = "menu-pinned-notes";
+  const char * Preferences::NOTE_CONTENTS_MEMORY = "note-contents-memory";
+  const char * Preferences::SYNC_NOTE_FILES = "sync-note-files";
 
   const char * Preferences::KEYBINDING_SHOW_NOTE_MENU = "show-note-menu";
   const char * Preferences::KEYBINDING_OPEN_START_HERE = "open-start-here";
@@ -59,6 +61,8 @@ namespace gnote {
   const char * Preferences::SYNC_SELECTED_SERVICE_ADDIN = "sync-selected-service-addin";
   const char * Preferences::SYNC_CONFIGURED_CONFLICT_BEHAVIOR = "sync-conflict-behavior";
   const char * Preferences::SYNC_AUTOSYNC_TIMEOUT = "autosync-timeout";
+  const char * Preferences::SYNC_TRANSFER_THREADS = "transfer-threads";
+  const char * Preferences::SYNC_PACK_NOTES = "pack-notes";
 
   const char * Preferences::NOTE_RENAME_BEHAVIOR = "note-rename-behavior";
   const char * Preferences::USE_STATUS_ICON = "use-status-icon";
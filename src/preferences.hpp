@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2011-2013 Aurimas Cernius
+ * Copyright (C) 2011-2014 Aurimas Cernius
  * Copyright (C) 2009 Hubert Figuiere
  *
  * This program is free software: you can redistribute it and/or modify
@@ -57,6 +57,8 @@ namespace gnote {
     static const char *CUSTOM_FONT_FACE;
     static const char *MENU_NOTE_COUNT;
     static const char *MENU_PINNED_NOTES;
+    static const char *NOTE_CONTENTS_MEMORY;
+    static const char *SYNC_NOTE_FILES;
 
     static const char *NOTE_RENAME_BEHAVIOR;
     static const char *USE_STATUS_ICON;
@@ -79,6 +81,8 @@ namespace gnote {
     static const char *SYNC_SELECTED_SERVICE_ADDIN;
     static const char *SYNC_CONFIGURED_CONFLICT_BEHAVIOR;
     static const char *SYNC_AUTOSYNC_TIMEOUT;
+    static const char *SYNC_TRANSFER_THREADS;
+    static const char *SYNC_PACK_NOTES;
 
     static const char *SYNC_FUSE_MOUNT_TIMEOUT;
     static const char *SYNC_FUSE_WDFS_ACCEPT_SSLCERT;
@@ -24,20 +24,173 @@
 #include "sharp/string.hpp"
 #include "notemanager.hpp"
 #include "search.hpp"
+#include "searchindex.hpp"
 #include "itagmanager.hpp"
 #include "utils.hpp"
+#include "notebooks/notebookmanager.hpp"
 
 namespace gnote {
 
 
-  Search::Search(NoteManager & manager)
+  SearchCache::SearchCache(NoteManager & manager)
+  {
+    manager.signal_note_saved.connect(sigc::mem_fun(*this, &SearchCache::on_note_changed));
+    manager.signal_note_added.connect(sigc::mem_fun(*this, &SearchCache::on_note_changed));
+    manager.signal_note_deleted.connect(sigc::mem_fun(*this, &SearchCache::on_note_deleted));
+    manager.signal_note_renamed.connect(sigc::mem_fun(*this, &SearchCache::on_note_renamed));
+    notebooks::NotebookManager::obj().signal_note_added_to_notebook()
+      .connect(sigc::mem_fun(*this, &SearchCache::on_notebook_changed));
+    notebooks::NotebookManager::obj().signal_note_removed_from_notebook()
+      .connect(sigc::mem_fun(*this, &SearchCache::on_notebook_changed));
+  }
+
+
+  bool SearchCache::find_candidates(const std::vector<std::string> & words, bool case_sensitive,
+                                    const notebooks::Notebook::Ptr & notebook,
+                                    SearchIndex::UriSet & candidates) const
+  {
+    const Query *best = NULL;
+    FOREACH(const Query & query, m_queries) {
+      if(query.case_sensitive != case_sensitive) {
+        continue;
+      }
+      // Results from all notebooks are good for any of them
+      if(query.notebook && query.notebook != notebook) {
+        continue;
+      }
+      if(!extends(words, query)) {
+        continue;
+      }
+      if(!best || query.results.size() < best->results.size()) {
+        best = &query;
+      }
+    }
+
+    if(!best) {
+      return false;
+    }
+    candidates = best->results;
+    return true;
+  }
+
+
+  void SearchCache::add(const std::vector<std::string> & words, bool case_sensitive,
+                        const notebooks::Notebook::Ptr & notebook,
+                        const SearchIndex::UriSet & results)
+  {
+    // Nothing matches no words, so they can not narrow down anything
+    if(words.empty()) {
+      return;
+    }
+
+    const unsigned MAX_QUERIES = 16;
+    for(std::list<Query>::iterator iter = m_queries.begin(); iter != m_queries.end(); ++iter) {
+      if(iter->words == words && iter->case_sensitive == case_sensitive && iter->notebook == notebook) {
+        m_queries.erase(iter);
+        break;
+      }
+    }
+    if(m_queries.size() >= MAX_QUERIES) {
+      m_queries.pop_back();
+    }
+
+    m_queries.push_front(Query());
+    Query & query = m_queries.front();
+    query.words = words;
+    query.case_sensitive = case_sensitive;
+    query.notebook = notebook;
+    query.results = results;
+  }
+
+
+  void SearchCache::clear()
+  {
+    m_queries.clear();
+  }
+
+
+  bool SearchCache::extends(const std::vector<std::string> & words, const Query & query)
+  {
+    // Every word has to be found in title or text for a note to match,
+    // so a note containing the new words contains the cached words too,
+    // if each of them is a part of some new word
+    FOREACH(const std::string & cached_word, query.words) {
+      bool found = false;
+      FOREACH(const std::string & word, words) {
+        if(word.find(cached_word) != std::string::npos) {
+          found = true;
+          break;
+        }
+      }
+      if(!found) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  void SearchCache::add_candidate(const std::string & uri)
+  {
+    // The note may match now, the query it is found by checks it again
+    FOREACH(Query & query, m_queries) {
+      query.results.insert(uri);
+    }
+  }
+
+
+  void SearchCache::on_note_changed(const NoteBase::Ptr & note)
+  {
+    add_candidate(note->uri());
+  }
+
+
+  void SearchCache::on_note_deleted(const NoteBase::Ptr & note)
+  {
+    FOREACH(Query & query, m_queries) {
+      query.results.erase(note->uri());
+    }
+  }
+
+
+  void SearchCache::on_note_renamed(const NoteBase::Ptr & note, const std::string &)
+  {
+    add_candidate(note->uri());
+  }
+
+
+  void SearchCache::on_notebook_changed(const Note & note, const notebooks::Notebook::Ptr &)
+  {
+    add_candidate(note.uri());
+  }
+
+
+  Search::Search(NoteManager & manager, SearchCache *cache)
     : m_manager(manager)
+    , m_cache(cache)
+    , m_max_results(0)
   {
   }
 
 
   Search::ResultsPtr Search::search_notes(const std::string & query, bool case_sensitive, 
                                   const notebooks::Notebook::Ptr & selected_notebook)
+  {
+    return search_notes(query, case_sensitive, selected_notebook, NULL);
+  }
+
+
+  Search::ResultsPtr Search::search_notes(const std::string & query, bool case_sensitive,
+                                          const notebooks::Notebook::Ptr & selected_notebook,
+                                          const SearchIndex::UriSet & candidates)
+  {
+    return search_notes(query, case_sensitive, selected_notebook, &candidates);
+  }
+
+
+  Search::ResultsPtr Search::search_notes(const std::string & query, bool case_sensitive,
+                                          const notebooks::Notebook::Ptr & selected_notebook,
+                                          const SearchIndex::UriSet *candidates)
   {
     Glib::ustring search_text = query;
     if(!case_sensitive) {
@@ -50,112 +203,263 @@ namespace gnote {
     // Used for matching in the raw note XML
     std::vector<std::string> encoded_words; 
     Search::split_watching_quotes(encoded_words, utils::XmlEncoder::encode (search_text));
-    ResultsPtr temp_matches(new Results);
-      
-      // Skip over notes that are template notes
+    sharp::StringMatcher matcher(words, case_sensitive);
+    sharp::StringMatcher encoded_matcher(encoded_words, case_sensitive);
+    Hits hits(m_max_results);
+
+    // Notes, that have the words in their content, according to index
+    SearchIndex::UriSet index_candidates;
+    Bm25 rank(0, 0);
+    std::vector<double> idfs;
+    bool use_index = setup_rank(m_manager, words, index_candidates, rank, idfs);
+
     Tag::Ptr template_tag = ITagManager::obj().get_or_create_system_tag(ITagManager::TEMPLATE_NOTE_SYSTEM_TAG);
 
-    FOREACH(const NoteBase::Ptr & iter, m_manager.get_notes()) {
-      Note::Ptr note(static_pointer_cast<Note>(iter));
+    // A previous query, that this one extends, tells which notes can match
+    SearchIndex::UriSet cached_candidates;
+    bool restricted = candidates != NULL;
+    if(!restricted && m_cache
+       && m_cache->find_candidates(words, case_sensitive, selected_notebook, cached_candidates)) {
+      candidates = &cached_candidates;
+    }
 
-      // Skip template notes
-      if (note->contains_tag (template_tag)) {
-        continue;
-      }
-        
-      // Skip notes that are not in the
-      // selected notebook
-      if (selected_notebook && !selected_notebook->contains_note(note))
-        continue;
-        
-      // First check the note's title for a match,
-      // if there is no match check the note's raw
-      // XML for at least one match, to avoid
-      // deserializing Buffers unnecessarily.
-      if (0 < find_match_count_in_note (note->get_title(),
-                                        words,
-                                        case_sensitive)) {
-        temp_matches->insert(std::make_pair(INT_MAX, note));
-      }
-      else if (check_note_has_match (note, encoded_words,
-                                case_sensitive)) {
-        int match_count =
-          find_match_count_in_note (note->text_content(),
-                                    words, case_sensitive);
-        if (match_count > 0) {
-          // TODO: Improve note.GetHashCode()
-          temp_matches->insert(std::make_pair(match_count, note));
+    if(candidates) {
+      FOREACH(const std::string & uri, *candidates) {
+        NoteBase::Ptr note = m_manager.find_by_uri(uri);
+        if(note) {
+          search_note(static_pointer_cast<Note>(note), words, matcher, encoded_matcher, case_sensitive,
+                      use_index, index_candidates, template_tag, selected_notebook, rank, idfs, hits);
         }
       }
     }
+    else {
+      FOREACH(const NoteBase::Ptr & iter, m_manager.get_notes()) {
+        search_note(static_pointer_cast<Note>(iter), words, matcher, encoded_matcher, case_sensitive,
+                    use_index, index_candidates, template_tag, selected_notebook, rank, idfs, hits);
+      }
+    }
+
+    bool complete = !hits.truncated();
+    std::vector<Hits::Hit> sorted_hits;
+    hits.take_sorted(sorted_hits);
+    ResultsPtr temp_matches(new Results);
+    temp_matches->reserve(sorted_hits.size());
+    FOREACH(const Hits::Hit & hit, sorted_hits) {
+      temp_matches->push_back(hit.second);
+    }
+
+    // Results of a restricted or truncated search are not complete for the query
+    if(m_cache && !restricted && complete) {
+      SearchIndex::UriSet results;
+      FOREACH(const Result & result, *temp_matches) {
+        results.insert(result.note->uri());
+      }
+      m_cache->add(words, case_sensitive, selected_notebook, results);
+    }
     return temp_matches;
   }
 
-  bool Search::check_note_has_match(const Note::Ptr & note, 
-                                    const std::vector<std::string> & encoded_words,
-                                    bool match_case)
+
+  void Search::search_note(const Note::Ptr & note, const std::vector<std::string> & words,
+                           const sharp::StringMatcher & matcher,
+                           const sharp::StringMatcher & encoded_matcher, bool case_sensitive,
+                           bool use_index, const SearchIndex::UriSet & index_candidates,
+                           const Tag::Ptr & template_tag,
+                           const notebooks::Notebook::Ptr & selected_notebook,
+                           const Bm25 & rank, const std::vector<double> & idfs,
+                           Hits & hits)
   {
-    Glib::ustring note_text = note->xml_content();
-    if (!match_case) {
-      note_text = note_text.lowercase();
+    // Skip over notes that are template notes
+    if (template_tag->has_note(*note)) {
+      return;
     }
 
-    for(std::vector<std::string>::const_iterator iter = encoded_words.begin();
-        iter != encoded_words.end(); ++iter) {
-      if(note_text.find(*iter) != std::string::npos) {
-        continue;
+    // Skip notes that are not in the
+    // selected notebook
+    if (selected_notebook && !selected_notebook->contains_note(note))
+      return;
+
+    // First check the note's title for a match,
+    // if there is no match check the index or the note's raw
+    // XML for at least one match, to avoid
+    // deserializing Buffers unnecessarily.
+    // Opened notes may have changes, that are not indexed yet.
+    std::vector<int> title_counts;
+    bool title_match = count_matches(note->get_title(), matcher, title_counts);
+    if (!title_match) {
+      if (use_index && !note->is_opened()) {
+        if (index_candidates.find(note->uri()) == index_candidates.end()) {
+          return;
+        }
       }
-      else {
-        return false;
+      else if (!check_note_has_match (note, encoded_matcher)) {
+        return;
       }
     }
 
-    return true;
+    std::vector<int> counts;
+    bool text_match = count_matches(note->text_content(), matcher, counts);
+    if (!title_match && !text_match) {
+      return;
+    }
+
+    Result result;
+    result.note = note;
+    result.score = score_note(note, words, case_sensitive, use_index, rank, idfs,
+                              counts, title_counts);
+    result.matches = match_count(title_match, counts);
+    hits.push(result.score, result);
   }
 
-  int Search::find_match_count_in_note(Glib::ustring note_text,
-                                       const std::vector<std::string> & words,
-                                       bool match_case)
+  double Search::score_note(const Note::Ptr & note, const std::vector<std::string> & words,
+                            bool case_sensitive, bool use_index, const Bm25 & rank,
+                            const std::vector<double> & idfs, const std::vector<int> & counts,
+                            const std::vector<int> & title_counts)
   {
-    int matches = 0;
-
-    if (!match_case) {
-      note_text = note_text.lowercase();
+    // The index has the length of notes, unless they are opened
+    size_t length = 0;
+    if (use_index) {
+      length = note->is_opened() ? 0 : m_manager.search_index().note_length(note->uri());
+      if (length == 0) {
+        std::vector<std::string> terms;
+        SearchIndex::tokenize(note->text_content(), terms);
+        length = terms.size();
+      }
     }
-    
-    for(std::vector<std::string>::const_iterator iter = words.begin();
-        iter != words.end(); ++iter) {
 
-      const std::string & word(*iter);
+    std::list<Tag::Ptr> tags;
+    note->get_tags(tags);
+    std::vector<std::string> tag_names;
+    FOREACH(const Tag::Ptr & tag, tags) {
+      if (!tag->is_system()) {
+        tag_names.push_back(tag->name());
+      }
+    }
 
-      int idx = 0;
-      bool this_word_found = false;
+    return score(words, case_sensitive, rank, idfs, counts, title_counts, length, tag_names);
+  }
 
-      if (word.empty())
-        continue;
+  bool Search::setup_rank(NoteManager & manager, const std::vector<std::string> & words,
+                          SearchIndex::UriSet & index_candidates, Bm25 & rank,
+                          std::vector<double> & idfs)
+  {
+    std::vector<size_t> frequencies;
+    const SearchIndex & index = manager.search_index();
+    bool use_index = index.find_candidates(words, index_candidates, &frequencies);
 
-      while (true) {
-        idx = sharp::string_index_of(note_text, word, idx);
+    // Without the index every word weighs the same and
+    // the length of notes is not taken into account
+    idfs.assign(words.size(), 1.0);
+    rank = Bm25(manager.get_notes().size(), 0);
+    if (use_index) {
+      rank = Bm25(index.note_count(), index.average_note_length());
+      for (std::vector<double>::size_type i = 0; i < words.size(); ++i) {
+        idfs[i] = rank.idf(frequencies[i]);
+      }
+    }
+    return use_index;
+  }
 
-        if (idx == -1) {
-          if (this_word_found) {
-            break;
-          }
-          else {
-            return 0;
-          }
+  double Search::score(const std::vector<std::string> & words, bool case_sensitive,
+                       const Bm25 & rank, const std::vector<double> & idfs,
+                       const std::vector<int> & counts, const std::vector<int> & title_counts,
+                       size_t length, const std::vector<std::string> & tag_names)
+  {
+    double score = 0;
+    for (std::vector<std::string>::size_type i = 0; i < words.size(); ++i) {
+      score += rank.text_score(idfs[i], counts[i], length);
+      if (title_counts[i] > 0) {
+        score += Bm25::TITLE_BOOST * idfs[i];
+      }
+      FOREACH(const std::string & name, tag_names) {
+        Glib::ustring tag_name = name;
+        if (!case_sensitive) {
+          tag_name = tag_name.lowercase();
         }
+        if (tag_name.find(words[i]) != Glib::ustring::npos) {
+          score += Bm25::TAG_BOOST * idfs[i];
+          break;
+        }
+      }
+    }
+    return score;
+  }
 
-        this_word_found = true;
+  int Search::match_count(bool title_match, const std::vector<int> & counts)
+  {
+    if (title_match) {
+      return INT_MAX;
+    }
+    int matches = 0;
+    FOREACH(int count, counts) {
+      matches += count;
+    }
+    return matches;
+  }
 
-        matches++;
+  bool Search::check_note_has_match(const Note::Ptr & note, 
+                                    const std::vector<std::string> & encoded_words,
+                                    bool match_case)
+  {
+    return check_note_has_match(note, sharp::StringMatcher(encoded_words, match_case));
+  }
 
-        idx += word.length();
-      }
+  bool Search::check_note_has_match(const Note::Ptr & note,
+                                    const sharp::StringMatcher & encoded_words)
+  {
+    // ASCII words are looked for in place, without lower casing the whole XML
+    const Glib::ustring & note_text = note->xml_content();
+    if (encoded_words.case_sensitive() || encoded_words.ascii_only()) {
+      return encoded_words.contains_all(note_text.raw());
+    }
+    return encoded_words.contains_all(note_text.lowercase().raw());
+  }
+
+  int Search::find_match_count_in_note(const Glib::ustring & note_text,
+                                       const std::vector<std::string> & words,
+                                       bool match_case)
+  {
+    return find_match_count_in_note(note_text, sharp::StringMatcher(words, match_case));
+  }
+
+  int Search::find_match_count_in_note(const Glib::ustring & note_text,
+                                       const sharp::StringMatcher & words)
+  {
+    std::vector<int> counts;
+    if (!count_matches(note_text, words, counts)) {
+      return 0;
     }
 
+    int matches = 0;
+    FOREACH(int count, counts) {
+      matches += count;
+    }
     return matches;
   }
 
+  bool Search::count_matches(const Glib::ustring & note_text,
+                             const sharp::StringMatcher & words,
+                             std::vector<int> & counts)
+  {
+    if (words.case_sensitive() || words.ascii_only()) {
+      words.count(note_text.raw(), counts);
+    }
+    else {
+      words.count(note_text.lowercase().raw(), counts);
+    }
+
+    bool all_found = true;
+    bool any_found = false;
+    FOREACH(int count, counts) {
+      if (count > 0) {
+        any_found = true;
+      }
+      else {
+        all_found = false;
+      }
+    }
+    return all_found && any_found;
+  }
+
 
 }
@@ -23,7 +23,7 @@
 #ifndef __SEARCH_HPP_
 #define __SEARCH_HPP_
 
-#include <map>
+#include <list>
 #include <memory>
 #include <string>
 #include <vector>
@@ -34,27 +34,91 @@
 #include "base/macros.hpp"
 #include "note.hpp"
 #include "notebooks/notebook.hpp"
+#include "searchindex.hpp"
+#include "searchrank.hpp"
+#include "sharp/string.hpp"
 
 namespace gnote {
 
   class NoteManager;
 
+
+/**
+ * Results of recent queries in one search session, such as typing in
+ * the search entry. A query, that only extends a cached one, has to
+ * look at the notes the cached query found, not at all notes.
+ * A note, that changes, is added to the results of every cached query,
+ * so that it is looked at again.
+ */
+class SearchCache
+  : public sigc::trackable
+{
+public:
+  SearchCache(NoteManager &);
+
+  /**
+   * Notes, that can match %words, if a cached query tells.
+   * Words are split and lower cased the way Search does it.
+   */
+  bool find_candidates(const std::vector<std::string> & words, bool case_sensitive,
+                       const notebooks::Notebook::Ptr & notebook,
+                       SearchIndex::UriSet & candidates) const;
+  /** Remember the URIs of notes, that match %words. */
+  void add(const std::vector<std::string> & words, bool case_sensitive,
+           const notebooks::Notebook::Ptr & notebook, const SearchIndex::UriSet & results);
+  void clear();
+private:
+  struct Query
+  {
+    std::vector<std::string> words;
+    bool case_sensitive;
+    notebooks::Notebook::Ptr notebook;
+    SearchIndex::UriSet results;
+  };
+
+  static bool extends(const std::vector<std::string> & words, const Query & query);
+  void add_candidate(const std::string & uri);
+  void on_note_changed(const NoteBase::Ptr &);
+  void on_note_deleted(const NoteBase::Ptr &);
+  void on_note_renamed(const NoteBase::Ptr &, const std::string &);
+  void on_notebook_changed(const Note &, const notebooks::Notebook::Ptr &);
+
+  // most recent first
+  std::list<Query> m_queries;
+};
+
 class Search 
 {
 public:
-  typedef std::multimap<int,Note::Ptr> Results;
+  struct Result
+  {
+    Note::Ptr note;
+    double score;
+    /// Number of occurrences of the words in the text,
+    /// INT_MAX if the title contains all of them.
+    int matches;
+  };
+  /// Matching notes, most relevant first.
+  typedef std::vector<Result> Results;
   typedef shared_ptr<Results> ResultsPtr;
 
   template<typename T>
   static void split_watching_quotes(std::vector<T> & split,
                                     const T & source);
 
-  Search(NoteManager &);
+  /** Queries are cached in %cache, if given. */
+  Search(NoteManager &, SearchCache *cache = NULL);
 
+  /// Keep only the given number of the most relevant results,
+  /// 0 keeps all of them.
+  void set_max_results(unsigned max_results)
+    {
+      m_max_results = max_results;
+    }
     
-  /// Search the notes! A match number of
-  /// INT_MAX indicates that the note
-  /// title contains the search term.
+  /// Search the notes! Results are ranked with BM25
+  /// over the note text, with boosts for the words found
+  /// in the title or tags.
   /// </summary>
   /// <param name="query">
   /// A <see cref="System.String"/>
@@ -68,19 +132,67 @@ public:
   /// be searched.
   /// </param>
   /// <returns>
-  /// A <see cref="IDictionary`2"/> with the relevant Notes
-  /// and a match number. If the search term is in the title,
-  /// number will be INT_MAX.
+  /// The relevant Notes with their score and a match
+  /// number. If the search term is in the title, number
+  /// will be INT_MAX.
   /// </returns>  
   ResultsPtr search_notes(const std::string &, bool, 
                           const notebooks::Notebook::Ptr & );
+  /// Search only the notes with URIs in %candidates,
+  /// for example the results of a previous query.
+  ResultsPtr search_notes(const std::string &, bool,
+                          const notebooks::Notebook::Ptr &,
+                          const SearchIndex::UriSet & candidates);
   bool check_note_has_match(const Note::Ptr & note, const std::vector<std::string> & ,
                             bool match_case);
-  int find_match_count_in_note(Glib::ustring note_text, const std::vector<std::string> &,
-                               bool match_case);
+  static bool check_note_has_match(const Note::Ptr & note, const sharp::StringMatcher & encoded_words);
+  static int find_match_count_in_note(const Glib::ustring & note_text, const std::vector<std::string> &,
+                                      bool match_case);
+  /// Same as above, with the words already set up for matching,
+  /// for checking many notes.
+  static int find_match_count_in_note(const Glib::ustring & note_text, const sharp::StringMatcher & words);
+  /// Count the occurrences of every word in %note_text.
+  /// Returns true, if all of the non-empty words are found.
+  static bool count_matches(const Glib::ustring & note_text, const sharp::StringMatcher & words,
+                            std::vector<int> & counts);
+
+  /// Set up the ranking of notes for %words. Returns whether the
+  /// search index can answer the query, %index_candidates are the
+  /// notes, that may contain all of the words, then.
+  static bool setup_rank(NoteManager & manager, const std::vector<std::string> & words,
+                         SearchIndex::UriSet & index_candidates, Bm25 & rank,
+                         std::vector<double> & idfs);
+  /// Score of a note with %counts of the words in its text and
+  /// %title_counts in its title. %length is the number of terms in
+  /// the text, 0 to ignore it, %tag_names are the names of user tags.
+  /// Does not touch notes, so can be used on any thread.
+  static double score(const std::vector<std::string> & words, bool case_sensitive,
+                      const Bm25 & rank, const std::vector<double> & idfs,
+                      const std::vector<int> & counts, const std::vector<int> & title_counts,
+                      size_t length, const std::vector<std::string> & tag_names);
+  /// Match number of a result: INT_MAX for title match,
+  /// otherwise the number of occurrences in the text.
+  static int match_count(bool title_match, const std::vector<int> & counts);
 private:
+  typedef TopHits<Result> Hits;
+
+  ResultsPtr search_notes(const std::string &, bool,
+                          const notebooks::Notebook::Ptr &,
+                          const SearchIndex::UriSet *candidates);
+  void search_note(const Note::Ptr & note, const std::vector<std::string> & words,
+                   const sharp::StringMatcher & matcher,
+                   const sharp::StringMatcher & encoded_matcher, bool case_sensitive,
+                   bool use_index, const SearchIndex::UriSet & index_candidates,
+                   const Tag::Ptr & template_tag, const notebooks::Notebook::Ptr & selected_notebook,
+                   const Bm25 & rank, const std::vector<double> & idfs, Hits & hits);
+  double score_note(const Note::Ptr & note, const std::vector<std::string> & words,
+                    bool case_sensitive, bool use_index, const Bm25 & rank,
+                    const std::vector<double> & idfs, const std::vector<int> & counts,
+                    const std::vector<int> & title_counts);
 
   NoteManager &m_manager;
+  SearchCache *m_cache;
+  unsigned m_max_results;
 };
 
 template<typename T>
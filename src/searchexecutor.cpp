@@ -0,0 +1,459 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <climits>
+
+#include <libxml/parser.h>
+
+#include "debug.hpp"
+#include "itagmanager.hpp"
+#include "note.hpp"
+#include "notemanager.hpp"
+#include "notesavequeue.hpp"
+#include "search.hpp"
+#include "searchexecutor.hpp"
+#include "notebooks/notebookmanager.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+// Notes checked between looking for cancellation
+const unsigned CANCEL_CHECK_INTERVAL = 64;
+// Matches collected before delivering them
+const unsigned BATCH_SIZE = 256;
+// Time in microseconds after which the matches found so far are delivered
+const gint64 BATCH_INTERVAL = 50000;
+
+}
+
+const int SearchExecutor::LATENCY_BUCKETS[] = { 10, 25, 50, 100, 250, 500, 1000 };
+const int SearchExecutor::LATENCY_BUCKET_COUNT = sizeof(LATENCY_BUCKETS) / sizeof(LATENCY_BUCKETS[0]);
+
+
+SearchExecutor::SearchExecutor(NoteManager & manager)
+  : m_manager(manager)
+  , m_cache(manager)
+  , m_case_sensitive(false)
+  , m_start_time(0)
+  , m_latency_histogram(LATENCY_BUCKET_COUNT + 1, 0)
+  , m_query(NULL)
+  , m_generation(0)
+  , m_results_generation(0)
+  , m_stop(false)
+{
+  m_manager.signal_note_added.connect(sigc::mem_fun(*this, &SearchExecutor::on_note_added));
+  m_manager.signal_note_deleted.connect(sigc::mem_fun(*this, &SearchExecutor::on_note_deleted));
+  m_manager.signal_note_saved.connect(sigc::mem_fun(*this, &SearchExecutor::on_note_saved));
+  m_manager.signal_note_renamed.connect(sigc::mem_fun(*this, &SearchExecutor::on_note_renamed));
+  notebooks::NotebookManager::obj().signal_note_added_to_notebook()
+    .connect(sigc::mem_fun(*this, &SearchExecutor::on_notebook_changed));
+  notebooks::NotebookManager::obj().signal_note_removed_from_notebook()
+    .connect(sigc::mem_fun(*this, &SearchExecutor::on_notebook_changed));
+  m_dispatcher.connect(sigc::mem_fun(*this, &SearchExecutor::on_results));
+
+  // Notes are read on the worker thread
+  xmlInitParser();
+  m_thread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &SearchExecutor::run));
+}
+
+SearchExecutor::~SearchExecutor()
+{
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    m_stop = true;
+    ++m_generation;
+    m_query_cond.signal();
+  }
+  m_thread->join();
+  delete m_query;
+}
+
+void SearchExecutor::search(const Glib::ustring & query, bool case_sensitive,
+                            const notebooks::Notebook::Ptr & notebook, const ResultSlot & slot)
+{
+  Query *new_query = new Query;
+  new_query->case_sensitive = case_sensitive;
+  Search::split_watching_quotes(new_query->words,
+                                std::string(case_sensitive ? query : query.lowercase()));
+  new_query->use_index = Search::setup_rank(m_manager, new_query->words, new_query->index_candidates,
+                                            new_query->rank, new_query->idfs);
+
+  // Refining a recent query only has to look at what it found
+  new_query->restricted = m_cache.find_candidates(new_query->words, case_sensitive, notebook,
+                                                  new_query->candidates);
+
+  new_query->template_tag = ITagManager::obj()
+    .get_or_create_system_tag(ITagManager::TEMPLATE_NOTE_SYSTEM_TAG)->normalized_name();
+  new_query->in_notebook = notebook != NULL;
+  if(notebook) {
+    Tag::Ptr tag = notebook->get_tag();
+    if(tag) {
+      new_query->notebook_tag = tag->normalized_name();
+    }
+  }
+
+  build_entries();
+  add_read_texts();
+  new_query->entries = m_entries;
+  new_query->texts = m_texts;
+  for(std::map<std::string, NoteBase::WeakPtr>::iterator iter = m_opened_notes.begin();
+      iter != m_opened_notes.end();) {
+    NoteBase::Ptr note = iter->second.lock();
+    if(!note || !static_pointer_cast<Note>(note)->is_opened()) {
+      m_opened_notes.erase(iter++);
+      continue;
+    }
+    new_query->opened_texts[iter->first] = note->text_content();
+    ++iter;
+  }
+
+  m_slot = slot;
+  m_words = new_query->words;
+  m_case_sensitive = case_sensitive;
+  m_notebook = notebook;
+  m_found.clear();
+  m_start_time = g_get_monotonic_time();
+
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  new_query->generation = ++m_generation;
+  delete m_query;
+  m_query = new_query;
+  m_query_cond.signal();
+}
+
+void SearchExecutor::cancel()
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  ++m_generation;
+  delete m_query;
+  m_query = NULL;
+}
+
+void SearchExecutor::fill_entry(const NoteBase::Ptr & note, NoteEntry & entry)
+{
+  entry.title = note->get_title();
+  entry.file_path = note->file_path();
+  entry.tags.clear();
+  entry.tag_names.clear();
+  std::list<Tag::Ptr> tags;
+  note->get_tags(tags);
+  FOREACH(const Tag::Ptr & tag, tags) {
+    entry.tags.insert(tag->normalized_name());
+    if(!tag->is_system()) {
+      entry.tag_names.push_back(tag->name());
+    }
+  }
+}
+
+void SearchExecutor::build_entries()
+{
+  if(m_entries) {
+    return;
+  }
+  m_entries = EntryMapPtr(new EntryMap);
+  m_texts = TextSnapshotPtr(new TextSnapshot);
+  FOREACH(const NoteBase::Ptr & note, m_manager.get_notes()) {
+    fill_entry(note, (*m_entries)[note->uri()]);
+    Note::Ptr n = static_pointer_cast<Note>(note);
+    n->signal_opened().connect(sigc::mem_fun(*this, &SearchExecutor::on_note_opened));
+    if(n->is_opened()) {
+      m_opened_notes[note->uri()] = note;
+    }
+  }
+}
+
+SearchExecutor::EntryMap *SearchExecutor::writable_entries()
+{
+  // Built, when searched for the first time
+  if(!m_entries) {
+    return NULL;
+  }
+  // The search in progress keeps looking at the entries it started with
+  if(!m_entries.unique()) {
+    m_entries = EntryMapPtr(new EntryMap(*m_entries));
+  }
+  return m_entries.get();
+}
+
+SearchExecutor::TextSnapshot *SearchExecutor::writable_texts()
+{
+  if(!m_texts) {
+    return NULL;
+  }
+  if(!m_texts.unique()) {
+    m_texts = TextSnapshotPtr(new TextSnapshot(*m_texts));
+  }
+  return m_texts.get();
+}
+
+void SearchExecutor::add_read_texts()
+{
+  TextSnapshot read_texts;
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    read_texts.swap(m_read_texts);
+  }
+  TextSnapshot *texts = read_texts.empty() ? NULL : writable_texts();
+  if(!texts) {
+    return;
+  }
+  for(TextSnapshot::iterator iter = read_texts.begin(); iter != read_texts.end(); ++iter) {
+    // A note saved since it was read has newer text in the snapshot,
+    // a deleted note has no entry
+    if(m_entries->find(iter->first) != m_entries->end()) {
+      texts->insert(*iter);
+    }
+  }
+}
+
+void SearchExecutor::update_entry(const NoteBase::Ptr & note)
+{
+  EntryMap *entries = writable_entries();
+  if(entries) {
+    fill_entry(note, (*entries)[note->uri()]);
+  }
+}
+
+void SearchExecutor::on_note_added(const NoteBase::Ptr & note)
+{
+  if(m_entries) {
+    update_entry(note);
+    static_pointer_cast<Note>(note)->signal_opened()
+      .connect(sigc::mem_fun(*this, &SearchExecutor::on_note_opened));
+  }
+}
+
+void SearchExecutor::on_note_deleted(const NoteBase::Ptr & note)
+{
+  EntryMap *entries = writable_entries();
+  if(entries) {
+    entries->erase(note->uri());
+  }
+  TextSnapshot *texts = writable_texts();
+  if(texts) {
+    texts->erase(note->uri());
+  }
+  m_opened_notes.erase(note->uri());
+}
+
+void SearchExecutor::on_note_saved(const NoteBase::Ptr & note)
+{
+  update_entry(note);
+  // Text, that is not loaded, has not changed since it was read
+  TextSnapshot *texts = writable_texts();
+  if(texts && note->data().is_text_loaded()) {
+    (*texts)[note->uri()] = TextPtr(new Glib::ustring(
+      NoteArchiver::get_text_from_note_content(note->data().text())));
+  }
+}
+
+void SearchExecutor::on_note_renamed(const NoteBase::Ptr & note, const std::string &)
+{
+  update_entry(note);
+}
+
+void SearchExecutor::on_notebook_changed(const Note & note, const notebooks::Notebook::Ptr &)
+{
+  NoteBase::Ptr n = m_manager.find_by_uri(note.uri());
+  if(n) {
+    update_entry(n);
+  }
+}
+
+void SearchExecutor::on_note_opened(Note & note)
+{
+  m_opened_notes[note.uri()] = note.shared_from_this();
+}
+
+Glib::ustring SearchExecutor::read_text(const Query & query, const std::string & uri, const NoteEntry & note,
+                                        TextSnapshot & read_texts)
+{
+  TextSnapshot::const_iterator iter = query.texts->find(uri);
+  if(iter != query.texts->end()) {
+    return *iter->second;
+  }
+
+  // Saved contents, that are not written yet, are newer than the file
+  Glib::ustring xml;
+  if(!m_manager.save_queue().get_pending_text(note.file_path, xml)) {
+    xml = NoteArchiver::read_text(note.file_path);
+  }
+  TextPtr text(new Glib::ustring(NoteArchiver::get_text_from_note_content(xml)));
+  read_texts[uri] = text;
+  return *text;
+}
+
+void SearchExecutor::search_note(const Query & query, const std::string & uri, const NoteEntry & note,
+                                 const sharp::StringMatcher & matcher, Matches & matches,
+                                 TextSnapshot & read_texts)
+{
+  if(note.tags.find(query.template_tag) != note.tags.end()) {
+    return;
+  }
+  if(query.in_notebook && note.tags.find(query.notebook_tag) == note.tags.end()) {
+    return;
+  }
+
+  // As in Search, the text is only looked at, if the title does not
+  // match and the index says, that the text might
+  std::vector<int> title_counts;
+  bool title_match = Search::count_matches(note.title, matcher, title_counts);
+  TextMap::const_iterator opened = query.opened_texts.find(uri);
+  if(!title_match && query.use_index && opened == query.opened_texts.end()
+     && query.index_candidates.find(uri) == query.index_candidates.end()) {
+    return;
+  }
+
+  Glib::ustring text = opened != query.opened_texts.end() ? opened->second
+                                                          : read_text(query, uri, note, read_texts);
+  std::vector<int> counts;
+  bool text_match = Search::count_matches(text, matcher, counts);
+  if(!title_match && !text_match) {
+    return;
+  }
+
+  size_t length = 0;
+  if(query.use_index) {
+    std::vector<std::string> terms;
+    SearchIndex::tokenize(text, terms);
+    length = terms.size();
+  }
+  Match & match = matches[uri];
+  match.score = Search::score(query.words, query.case_sensitive, query.rank, query.idfs,
+                              counts, title_counts, length, note.tag_names);
+  match.matches = Search::match_count(title_match, counts);
+}
+
+void SearchExecutor::run()
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  while(true) {
+    while(!m_query && !m_stop) {
+      m_query_cond.wait(m_mutex);
+    }
+    if(m_stop) {
+      return;
+    }
+    Query *query = m_query;
+    m_query = NULL;
+    lock.release();
+
+    sharp::StringMatcher matcher(query->words, query->case_sensitive);
+    Matches matches;
+    TextSnapshot read_texts;
+    gint64 last_delivery = g_get_monotonic_time();
+    bool cancelled = false;
+    unsigned checked = 0;
+    for(EntryMap::const_iterator iter = query->entries->begin(); iter != query->entries->end(); ++iter) {
+      if(query->restricted && query->candidates.find(iter->first) == query->candidates.end()) {
+        continue;
+      }
+      if(checked++ % CANCEL_CHECK_INTERVAL == 0 && is_cancelled(query->generation)) {
+        cancelled = true;
+        break;
+      }
+
+      search_note(*query, iter->first, iter->second, matcher, matches, read_texts);
+
+      if(!matches.empty()) {
+        gint64 now = g_get_monotonic_time();
+        if(matches.size() >= BATCH_SIZE || now - last_delivery >= BATCH_INTERVAL) {
+          deliver(query->generation, matches, false, read_texts);
+          last_delivery = now;
+        }
+      }
+    }
+    // Texts read by a cancelled search are kept too
+    deliver(query->generation, matches, !cancelled, read_texts);
+    delete query;
+
+    lock.acquire();
+  }
+}
+
+bool SearchExecutor::is_cancelled(guint generation)
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  return generation != m_generation;
+}
+
+void SearchExecutor::deliver(guint generation, Matches & matches, bool finished, TextSnapshot & read_texts)
+{
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    if(m_read_texts.empty()) {
+      m_read_texts.swap(read_texts);
+    }
+    else {
+      m_read_texts.insert(read_texts.begin(), read_texts.end());
+      read_texts.clear();
+    }
+    if(generation != m_generation) {
+      return;
+    }
+    if(m_results_generation != generation) {
+      m_results.clear();
+      m_results_generation = generation;
+    }
+    m_results.push_back(std::make_pair(Matches(), finished));
+    m_results.back().first.swap(matches);
+  }
+  m_dispatcher.emit();
+}
+
+void SearchExecutor::on_results()
+{
+  std::vector<std::pair<Matches, bool> > results;
+  guint generation;
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    results.swap(m_results);
+    generation = m_results_generation;
+  }
+
+  for(unsigned i = 0; i < results.size(); ++i) {
+    // The slot can start a new search, the rest of results are stale then
+    if(generation != m_generation) {
+      return;
+    }
+    bool finished = results[i].second;
+    if(finished) {
+      add_read_texts();
+    }
+    for(Matches::const_iterator iter = results[i].first.begin(); iter != results[i].first.end(); ++iter) {
+      m_found.insert(iter->first);
+    }
+    if(finished) {
+      m_cache.add(m_words, m_case_sensitive, m_notebook, m_found);
+      int latency = (g_get_monotonic_time() - m_start_time) / 1000;
+      int bucket = 0;
+      while(bucket < LATENCY_BUCKET_COUNT && latency > LATENCY_BUCKETS[bucket]) {
+        ++bucket;
+      }
+      ++m_latency_histogram[bucket];
+      DBG_OUT("Search finished in %d ms", latency);
+    }
+    m_slot(results[i].first, finished);
+  }
+}
+
+}
@@ -0,0 +1,198 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SEARCHEXECUTOR_HPP_
+#define _SEARCHEXECUTOR_HPP_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/threads.h>
+#include <sigc++/sigc++.h>
+
+#include "base/macros.hpp"
+#include "notebase.hpp"
+#include "notebooks/notebook.hpp"
+#include "search.hpp"
+#include "searchindex.hpp"
+#include "searchrank.hpp"
+
+
+namespace gnote {
+
+class NoteManager;
+
+/**
+ * Runs searches on a worker thread, so that typing a query does not
+ * block the main loop. Titles and tags of notes are mirrored for the
+ * worker as notes change. The plain text of a note is read from its file
+ * once, then kept in a snapshot, that is updated when the note is saved.
+ * The text of opened notes is taken when a search starts.
+ * Notes are matched and ranked the way Search does it.
+ * Starting a search cancels the previous one. A query, that extends
+ * a recent one, only looks at the notes that matched the recent query.
+ * Matches are delivered on the main thread in batches, as they are found.
+ */
+class SearchExecutor
+  : public sigc::trackable
+{
+public:
+  struct Match
+  {
+    /// Relevance, as Search::Result::score
+    double score;
+    /// Number of occurrences of the words, INT_MAX for title match
+    int matches;
+  };
+  /** URI of matching note -> match. */
+  typedef std::map<std::string, Match> Matches;
+  /**
+   * Receives a batch of matches. The last call for a search has
+   * %finished set, its batch can be empty.
+   */
+  typedef sigc::slot<void, const Matches &, bool> ResultSlot;
+
+  /** Upper bounds of latency histogram buckets, in milliseconds. */
+  static const int LATENCY_BUCKETS[];
+  static const int LATENCY_BUCKET_COUNT;
+
+  SearchExecutor(NoteManager & manager);
+  ~SearchExecutor();
+
+  /**
+   * Search notes for %query in a background, cancelling the search in
+   * progress. Only notes in %notebook are searched, unless it is empty.
+   */
+  void search(const Glib::ustring & query, bool case_sensitive,
+              const notebooks::Notebook::Ptr & notebook, const ResultSlot & slot);
+  /** Stop the search in progress, no more results are delivered for it. */
+  void cancel();
+
+  /**
+   * Number of completed searches by the time to deliver all results,
+   * one count per bucket in LATENCY_BUCKETS and the last one for slower.
+   */
+  const std::vector<unsigned> & latency_histogram() const
+    {
+      return m_latency_histogram;
+    }
+private:
+  /** What the search needs to know about a note, besides the text. */
+  struct NoteEntry
+  {
+    Glib::ustring title;
+    std::string file_path;
+    // normalized names of all tags
+    std::set<std::string> tags;
+    // names of user tags, for ranking
+    std::vector<std::string> tag_names;
+  };
+  // note URI -> entry
+  typedef std::map<std::string, NoteEntry> EntryMap;
+  typedef shared_ptr<EntryMap> EntryMapPtr;
+  // note URI -> plain text
+  typedef std::map<std::string, Glib::ustring> TextMap;
+  typedef shared_ptr<const Glib::ustring> TextPtr;
+  // note URI -> plain text, shared by snapshots
+  typedef std::map<std::string, TextPtr> TextSnapshot;
+  typedef shared_ptr<TextSnapshot> TextSnapshotPtr;
+
+  struct Query
+  {
+    guint generation;
+    bool case_sensitive;
+    std::vector<std::string> words;
+    bool use_index;
+    SearchIndex::UriSet index_candidates;
+    Bm25 rank;
+    std::vector<double> idfs;
+    // notes to look at, all of them, if not restricted
+    bool restricted;
+    SearchIndex::UriSet candidates;
+    std::string template_tag;
+    bool in_notebook;
+    std::string notebook_tag;
+    // shared with the main thread, which copies them before changing
+    EntryMapPtr entries;
+    TextSnapshotPtr texts;
+    // opened notes can have changes, that are neither saved nor indexed
+    TextMap opened_texts;
+
+    Query()
+      : rank(0, 0)
+      {}
+  };
+
+  static void fill_entry(const NoteBase::Ptr & note, NoteEntry & entry);
+  void build_entries();
+  EntryMap *writable_entries();
+  TextSnapshot *writable_texts();
+  void add_read_texts();
+  void update_entry(const NoteBase::Ptr & note);
+  void on_note_added(const NoteBase::Ptr & note);
+  void on_note_deleted(const NoteBase::Ptr & note);
+  void on_note_saved(const NoteBase::Ptr & note);
+  void on_note_renamed(const NoteBase::Ptr & note, const std::string & old_title);
+  void on_notebook_changed(const Note & note, const notebooks::Notebook::Ptr & notebook);
+  void on_note_opened(Note & note);
+  Glib::ustring read_text(const Query & query, const std::string & uri, const NoteEntry & note,
+                          TextSnapshot & read_texts);
+  void search_note(const Query & query, const std::string & uri, const NoteEntry & note,
+                   const sharp::StringMatcher & matcher, Matches & matches, TextSnapshot & read_texts);
+  void run();
+  bool is_cancelled(guint generation);
+  void deliver(guint generation, Matches & matches, bool finished, TextSnapshot & read_texts);
+  void on_results();
+
+  NoteManager & m_manager;
+  // Built on first search, then kept up to date
+  EntryMapPtr m_entries;
+  TextSnapshotPtr m_texts;
+  std::map<std::string, NoteBase::WeakPtr> m_opened_notes;
+  SearchCache m_cache;
+  ResultSlot m_slot;
+  // Query being delivered and the notes found by it so far, for the cache
+  std::vector<std::string> m_words;
+  bool m_case_sensitive;
+  notebooks::Notebook::Ptr m_notebook;
+  SearchIndex::UriSet m_found;
+  gint64 m_start_time;
+  std::vector<unsigned> m_latency_histogram;
+  Glib::Dispatcher m_dispatcher;
+  Glib::Threads::Thread *m_thread;
+
+  // Shared with the worker thread
+  Glib::Threads::Mutex m_mutex;
+  Glib::Threads::Cond m_query_cond;
+  Query *m_query;
+  guint m_generation;
+  std::vector<std::pair<Matches, bool> > m_results;
+  // texts read from files, not in the snapshot yet
+  TextSnapshot m_read_texts;
+  guint m_results_generation;
+  bool m_stop;
+};
+
+}
+
+#endif
@@ -0,0 +1,732 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include <glib/gstdio.h>
+#include <glibmm/i18n.h>
+#include <libxml/parser.h>
+
+#include "debug.hpp"
+#include "notemanagerbase.hpp"
+#include "notesavequeue.hpp"
+#include "searchindex.hpp"
+#include "sharp/files.hpp"
+#include "sharp/string.hpp"
+#include "sharp/xmlconvert.hpp"
+
+
+namespace gnote {
+
+namespace {
+
+const char *INDEX_FILE_HEADER = "gnote-search-index 1";
+
+// Save the index this long after the last change
+const guint INDEX_SAVE_TIMEOUT = 10000;
+
+// Notes indexed between looking for a stop request
+const unsigned STOP_CHECK_INTERVAL = 64;
+
+}
+
+
+TermIndex::TermIndex()
+  : m_total_length(0)
+{
+}
+
+TermIndex::Postings & TermIndex::add_term(const std::string & term)
+{
+  std::pair<TermMap::iterator, bool> res = m_terms.insert(std::make_pair(term, Postings()));
+  if(res.second) {
+    // Suffixes start at character boundaries only, words are whole characters too
+    for(std::string::size_type offset = 0; offset < term.size(); ++offset) {
+      if((term[offset] & 0xC0) != 0x80) {
+        Suffix suffix = { res.first, offset };
+        m_suffixes.insert(suffix);
+      }
+    }
+  }
+  return res.first->second;
+}
+
+void TermIndex::erase_term(TermMap::iterator term)
+{
+  const std::string & text = term->first;
+  for(std::string::size_type offset = 0; offset < text.size(); ++offset) {
+    if((text[offset] & 0xC0) == 0x80) {
+      continue;
+    }
+    Suffix suffix = { term, offset };
+    std::pair<SuffixSet::iterator, SuffixSet::iterator> range = m_suffixes.equal_range(suffix);
+    for(SuffixSet::iterator iter = range.first; iter != range.second; ++iter) {
+      if(iter->term == term) {
+        m_suffixes.erase(iter);
+        break;
+      }
+    }
+  }
+  m_terms.erase(term);
+}
+
+void TermIndex::add_note(const std::string & uri, const std::string & change_date, const Glib::ustring & text)
+{
+  remove_note(uri);
+
+  std::vector<std::string> terms;
+  SearchIndex::tokenize(text, terms);
+
+  NoteRecord & record = m_notes[uri];
+  record.change_date = change_date;
+  record.length = terms.size();
+  m_total_length += terms.size();
+  for(std::vector<std::string>::size_type i = 0; i < terms.size(); ++i) {
+    Positions & positions = add_term(terms[i])[uri];
+    if(positions.empty()) {
+      record.terms.push_back(terms[i]);
+    }
+    positions.push_back(int(i));
+  }
+}
+
+void TermIndex::remove_note(const std::string & uri)
+{
+  NoteMap::iterator record = m_notes.find(uri);
+  if(record == m_notes.end()) {
+    return;
+  }
+
+  FOREACH(const std::string & term, record->second.terms) {
+    TermMap::iterator iter = m_terms.find(term);
+    if(iter != m_terms.end()) {
+      iter->second.erase(uri);
+      if(iter->second.empty()) {
+        erase_term(iter);
+      }
+    }
+  }
+  m_total_length -= record->second.length;
+  m_notes.erase(record);
+}
+
+void TermIndex::clear()
+{
+  m_suffixes.clear();
+  m_terms.clear();
+  m_notes.clear();
+  m_total_length = 0;
+}
+
+void TermIndex::swap(TermIndex & other)
+{
+  // Iterators in the suffixes stay valid, they move with the terms
+  m_terms.swap(other.m_terms);
+  m_notes.swap(other.m_notes);
+  m_suffixes.swap(other.m_suffixes);
+  std::swap(m_total_length, other.m_total_length);
+}
+
+std::string TermIndex::change_date(const std::string & uri) const
+{
+  NoteMap::const_iterator record = m_notes.find(uri);
+  if(record == m_notes.end()) {
+    return "";
+  }
+  return record->second.change_date;
+}
+
+void TermIndex::get_note_uris(std::vector<std::string> & uris) const
+{
+  for(NoteMap::const_iterator iter = m_notes.begin(); iter != m_notes.end(); ++iter) {
+    uris.push_back(iter->first);
+  }
+}
+
+size_t TermIndex::note_length(const std::string & uri) const
+{
+  NoteMap::const_iterator record = m_notes.find(uri);
+  if(record == m_notes.end()) {
+    return 0;
+  }
+  return record->second.length;
+}
+
+void TermIndex::find_terms(const std::string & token, bool first, bool last,
+                           std::vector<TermMap::const_iterator> & terms) const
+{
+  // A word may start and end in the middle of a term, but the terms
+  // in between have to match completely.
+  if(!first) {
+    TermMap::const_iterator term = m_terms.lower_bound(token);
+    if(last) {
+      // Terms starting with the token are contiguous
+      for(; term != m_terms.end() && term->first.compare(0, token.size(), token) == 0; ++term) {
+        terms.push_back(term);
+      }
+    }
+    else if(term != m_terms.end() && term->first == token) {
+      terms.push_back(term);
+    }
+    return;
+  }
+
+  // Suffixes starting with the token are contiguous, for the first term
+  // of a phrase the suffix has to be the token itself.
+  // Suffixes refer to terms in a map, so does the key to look up.
+  TermMap key_terms;
+  Suffix key = { key_terms.insert(std::make_pair(token, Postings())).first, 0 };
+  SuffixSet::const_iterator iter = m_suffixes.lower_bound(key);
+  SuffixSet::const_iterator end = last ? m_suffixes.end() : m_suffixes.upper_bound(key);
+  std::set<const std::string*> seen;
+  for(; iter != end; ++iter) {
+    if(iter->term->first.compare(iter->offset, token.size(), token) != 0) {
+      break;
+    }
+    // A term can contain the token several times
+    if(seen.insert(&iter->term->first).second) {
+      terms.push_back(iter->term);
+    }
+  }
+}
+
+void TermIndex::find_word_candidates(const std::vector<std::string> & terms, UriSet & result) const
+{
+  if(terms.size() == 1) {
+    std::vector<TermMap::const_iterator> matching;
+    find_terms(terms[0], true, true, matching);
+    FOREACH(TermMap::const_iterator term, matching) {
+      for(Postings::const_iterator posting = term->second.begin(); posting != term->second.end(); ++posting) {
+        result.insert(posting->first);
+      }
+    }
+    return;
+  }
+
+  // For phrases keep the positions where the matched terms end,
+  // the next term must be right after them.
+  std::map<std::string, std::set<int> > matches;
+  for(std::vector<std::string>::size_type i = 0; i < terms.size(); ++i) {
+    bool first = i == 0;
+    std::vector<TermMap::const_iterator> matching;
+    find_terms(terms[i], first, i == terms.size() - 1, matching);
+    std::map<std::string, std::set<int> > next_matches;
+    FOREACH(TermMap::const_iterator term, matching) {
+      for(Postings::const_iterator posting = term->second.begin(); posting != term->second.end(); ++posting) {
+        if(first) {
+          next_matches[posting->first].insert(posting->second.begin(), posting->second.end());
+          continue;
+        }
+        std::map<std::string, std::set<int> >::const_iterator prev = matches.find(posting->first);
+        if(prev == matches.end()) {
+          continue;
+        }
+        FOREACH(int pos, posting->second) {
+          if(prev->second.find(pos - 1) != prev->second.end()) {
+            next_matches[posting->first].insert(pos);
+          }
+        }
+      }
+    }
+
+    matches.swap(next_matches);
+    if(matches.empty()) {
+      return;
+    }
+  }
+
+  for(std::map<std::string, std::set<int> >::const_iterator iter = matches.begin(); iter != matches.end(); ++iter) {
+    result.insert(iter->first);
+  }
+}
+
+bool TermIndex::read(std::istream & in)
+{
+  clear();
+
+  std::string line;
+  std::getline(in, line);
+  if(line != INDEX_FILE_HEADER) {
+    DBG_OUT("Search index has unknown format, rebuilding");
+    return false;
+  }
+
+  std::vector<std::string> note_uris;
+  try {
+    while(std::getline(in, line)) {
+      std::vector<std::string> fields;
+      sharp::string_split(fields, line, "\t");
+      if(fields.size() == 3 && fields[0] == "N") {
+        // N <change date> <uri>
+        m_notes[fields[2]].change_date = fields[1];
+        note_uris.push_back(fields[2]);
+      }
+      else if(fields.size() >= 3 && fields[0] == "T") {
+        // T <term> <note>:<position>,<position>...
+        const std::string & term = fields[1];
+        Postings & postings = add_term(term);
+        for(std::vector<std::string>::size_type i = 2; i < fields.size(); ++i) {
+          std::string::size_type colon = fields[i].find(':');
+          if(colon == std::string::npos) {
+            return false;
+          }
+          unsigned note = STRING_TO_INT(fields[i].substr(0, colon));
+          if(note >= note_uris.size()) {
+            return false;
+          }
+          const std::string & uri = note_uris[note];
+          NoteRecord & record = m_notes[uri];
+          std::vector<std::string> positions;
+          sharp::string_split(positions, fields[i].substr(colon + 1), ",");
+          Positions & term_positions = postings[uri];
+          FOREACH(const std::string & pos, positions) {
+            int position = STRING_TO_INT(pos);
+            term_positions.push_back(position);
+            // The last term of a note tells its length
+            record.length = std::max(record.length, size_t(position + 1));
+          }
+          record.terms.push_back(term);
+        }
+      }
+      else {
+        return false;
+      }
+    }
+  }
+  catch(const std::exception & e) {
+    DBG_OUT("Failed to read search index: %s", e.what());
+    return false;
+  }
+
+  for(NoteMap::const_iterator iter = m_notes.begin(); iter != m_notes.end(); ++iter) {
+    m_total_length += iter->second.length;
+  }
+  return true;
+}
+
+void TermIndex::write(std::ostream & out) const
+{
+  out << INDEX_FILE_HEADER << '\n';
+  std::map<std::string, int> note_numbers;
+  for(NoteMap::const_iterator iter = m_notes.begin(); iter != m_notes.end(); ++iter) {
+    int number = note_numbers.size();
+    note_numbers[iter->first] = number;
+    out << "N\t" << iter->second.change_date << '\t' << iter->first << '\n';
+  }
+  for(TermMap::const_iterator term = m_terms.begin(); term != m_terms.end(); ++term) {
+    out << "T\t" << term->first;
+    for(Postings::const_iterator posting = term->second.begin(); posting != term->second.end(); ++posting) {
+      out << '\t' << note_numbers[posting->first] << ':';
+      for(Positions::const_iterator pos = posting->second.begin(); pos != posting->second.end(); ++pos) {
+        if(pos != posting->second.begin()) {
+          out << ',';
+        }
+        out << *pos;
+      }
+    }
+    out << '\n';
+  }
+}
+
+
+const char *SearchIndex::INDEX_DIR_NAME = "Index";
+
+
+void SearchIndex::tokenize(const Glib::ustring & text, std::vector<std::string> & terms)
+{
+  Glib::ustring lower = text.lowercase();
+  Glib::ustring term;
+  for(Glib::ustring::const_iterator iter = lower.begin(); iter != lower.end(); ++iter) {
+    if(Glib::Unicode::isalnum(*iter)) {
+      term += *iter;
+    }
+    else if(!term.empty()) {
+      terms.push_back(term);
+      term.clear();
+    }
+  }
+  if(!term.empty()) {
+    terms.push_back(term);
+  }
+}
+
+
+SearchIndex::SearchIndex(NoteManagerBase & manager, const std::string & index_file)
+  : m_manager(manager)
+  , m_index_file(index_file)
+  , m_loaded(false)
+  , m_thread(NULL)
+  , m_built(NULL)
+  , m_built_changed(false)
+  , m_dirty(false)
+  , m_save_requested(0)
+  , m_saved(0)
+  , m_stop(false)
+{
+  m_manager.signal_note_added.connect(sigc::mem_fun(*this, &SearchIndex::on_note_added));
+  m_manager.signal_note_deleted.connect(sigc::mem_fun(*this, &SearchIndex::on_note_deleted));
+  m_manager.signal_note_saved.connect(sigc::mem_fun(*this, &SearchIndex::on_note_saved));
+  m_manager.signal_note_renamed.connect(sigc::mem_fun(*this, &SearchIndex::on_note_renamed));
+  m_save_timeout.signal_timeout.connect(sigc::mem_fun(*this, &SearchIndex::save));
+  m_built_dispatcher.connect(sigc::mem_fun(*this, &SearchIndex::on_built));
+}
+
+SearchIndex::~SearchIndex()
+{
+  if(m_thread) {
+    {
+      Glib::Threads::Mutex::Lock lock(m_mutex);
+      m_stop = true;
+      m_cond.broadcast();
+    }
+    m_thread->join();
+  }
+  delete m_built;
+}
+
+void SearchIndex::load()
+{
+  if(m_thread) {
+    return;
+  }
+
+  // Take what the worker needs from the notes, it does not touch them
+  FOREACH(const NoteBase::Ptr & note, m_manager.get_notes()) {
+    NoteSource source;
+    source.uri = note->uri();
+    source.change_date = sharp::XmlConvert::to_string(note->change_date());
+    source.file_path = note->file_path();
+    // The file of a note with pending save is not up to date
+    source.text_loaded = note->is_body_loaded() || m_manager.save_queue().is_pending(note->file_path());
+    if(source.text_loaded) {
+      // Plain text would stay cached in the note
+      source.xml = note->xml_content();
+    }
+    m_sources.push_back(source);
+  }
+
+  // Note files are read on the worker thread
+  xmlInitParser();
+  m_thread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &SearchIndex::run));
+}
+
+void SearchIndex::run()
+{
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  std::vector<NoteSource> sources;
+  sources.swap(m_sources);
+  lock.release();
+
+  bool changed = false;
+  TermIndex *built = build(sources, changed);
+  sources.clear();
+
+  lock.acquire();
+  if(!built) {
+    return;
+  }
+  m_built = built;
+  m_built_changed = changed;
+  m_built_dispatcher.emit();
+
+  while(true) {
+    while(m_saved == m_save_requested && !m_stop) {
+      m_cond.wait(m_mutex);
+    }
+    if(m_saved == m_save_requested) {
+      return;
+    }
+
+    guint64 requested = m_save_requested;
+    std::string contents;
+    bool write = m_dirty;
+    if(write) {
+      // Only serializing has to keep the main thread from changing the index
+      std::ostringstream out;
+      m_index.write(out);
+      contents = out.str();
+      m_dirty = false;
+    }
+    lock.release();
+
+    bool written = !write || write_index_file(contents);
+
+    lock.acquire();
+    if(!written) {
+      m_dirty = true;
+    }
+    m_saved = requested;
+    m_cond.broadcast();
+  }
+}
+
+TermIndex *SearchIndex::build(const std::vector<NoteSource> & notes, bool & changed)
+{
+  gint64 start = g_get_monotonic_time();
+  TermIndex *index = new TermIndex;
+  std::ifstream fin(m_index_file.c_str());
+  if(!fin.is_open() || !index->read(fin)) {
+    index->clear();
+    changed = true;
+  }
+
+  // Reindex notes changed since the index was written
+  std::set<std::string> current_notes;
+  unsigned reindexed = 0;
+  for(std::vector<NoteSource>::size_type i = 0; i < notes.size(); ++i) {
+    if(i % STOP_CHECK_INTERVAL == 0) {
+      Glib::Threads::Mutex::Lock lock(m_mutex);
+      if(m_stop) {
+        delete index;
+        return NULL;
+      }
+    }
+
+    const NoteSource & note = notes[i];
+    current_notes.insert(note.uri);
+    if(index->change_date(note.uri) != note.change_date) {
+      index->add_note(note.uri, note.change_date, NoteArchiver::get_text_from_note_content(
+        note.text_loaded ? note.xml : NoteArchiver::read_text(note.file_path)));
+      ++reindexed;
+    }
+  }
+
+  // Drop notes, that no longer exist
+  std::vector<std::string> indexed_notes;
+  index->get_note_uris(indexed_notes);
+  FOREACH(const std::string & uri, indexed_notes) {
+    if(current_notes.find(uri) == current_notes.end()) {
+      index->remove_note(uri);
+      changed = true;
+    }
+  }
+
+  changed = changed || reindexed > 0;
+  DBG_OUT("Search index ready in %d ms, %u notes reindexed",
+          int((g_get_monotonic_time() - start) / 1000), reindexed);
+  return index;
+}
+
+void SearchIndex::on_built()
+{
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    if(!m_built) {
+      return;
+    }
+    m_index.swap(*m_built);
+    delete m_built;
+    m_built = NULL;
+    m_dirty = m_dirty || m_built_changed;
+  }
+  m_loaded = true;
+
+  // The notes, that changed meanwhile, might be indexed as they were before
+  std::set<std::string> changed_notes;
+  changed_notes.swap(m_changed_notes);
+  FOREACH(const std::string & uri, changed_notes) {
+    NoteBase::Ptr note = m_manager.find_by_uri(uri);
+    if(note) {
+      update_note(note);
+    }
+    else {
+      remove_note(uri);
+    }
+  }
+
+  bool dirty;
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    dirty = m_dirty;
+  }
+  if(dirty) {
+    m_save_timeout.reset(INDEX_SAVE_TIMEOUT);
+  }
+}
+
+bool SearchIndex::write_index_file(const std::string & contents)
+{
+  std::string dir = sharp::file_dirname(m_index_file);
+  if(g_mkdir_with_parents(dir.c_str(), S_IRWXU) != 0) {
+    ERR_OUT(_("Failed to create directory %s"), dir.c_str());
+    return false;
+  }
+
+  std::string tmp_file = m_index_file + ".tmp";
+  std::ofstream fout(tmp_file.c_str());
+  if(!fout.is_open()) {
+    ERR_OUT(_("Failed to write search index %s"), tmp_file.c_str());
+    return false;
+  }
+  fout << contents;
+  fout.close();
+
+  if(fout.fail()) {
+    ERR_OUT(_("Failed to write search index %s"), tmp_file.c_str());
+    sharp::file_delete(tmp_file);
+    return false;
+  }
+  sharp::file_move(tmp_file, m_index_file);
+  return true;
+}
+
+void SearchIndex::save()
+{
+  m_save_timeout.cancel();
+  if(!m_loaded) {
+    return;
+  }
+
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  if(m_dirty) {
+    ++m_save_requested;
+    m_cond.broadcast();
+  }
+}
+
+void SearchIndex::flush()
+{
+  if(!m_loaded) {
+    return;
+  }
+
+  Glib::Threads::Mutex::Lock lock(m_mutex);
+  guint64 requested = m_save_requested;
+  while(m_saved < requested) {
+    m_cond.wait(m_mutex);
+  }
+}
+
+void SearchIndex::queue_save()
+{
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    m_dirty = true;
+  }
+  m_save_timeout.reset(INDEX_SAVE_TIMEOUT);
+}
+
+void SearchIndex::update_note(const NoteBase::Ptr & note)
+{
+  std::string change_date = sharp::XmlConvert::to_string(note->change_date());
+  const Glib::ustring & text = note->text_content();
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    m_index.add_note(note->uri(), change_date, text);
+  }
+  queue_save();
+}
+
+void SearchIndex::remove_note(const std::string & uri)
+{
+  {
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    if(m_index.change_date(uri).empty()) {
+      return;
+    }
+    m_index.remove_note(uri);
+  }
+  queue_save();
+}
+
+bool SearchIndex::find_candidates(const std::vector<std::string> & words, UriSet & result,
+                                  std::vector<size_t> *frequencies) const
+{
+  if(!m_loaded) {
+    return false;
+  }
+  if(frequencies) {
+    frequencies->assign(words.size(), 0);
+  }
+  std::vector<size_t>::size_type word_index = 0;
+
+  bool first_word = true;
+  FOREACH(const std::string & word, words) {
+    std::vector<std::string> terms;
+    tokenize(word, terms);
+    if(terms.empty()) {
+      // Nothing we could look up, every note has to be checked
+      return false;
+    }
+
+    UriSet word_result;
+    m_index.find_word_candidates(terms, word_result);
+    if(frequencies) {
+      (*frequencies)[word_index++] = word_result.size();
+    }
+    if(first_word) {
+      result.swap(word_result);
+      first_word = false;
+    }
+    else {
+      UriSet intersection;
+      std::set_intersection(result.begin(), result.end(),
+                            word_result.begin(), word_result.end(),
+                            std::inserter(intersection, intersection.begin()));
+      result.swap(intersection);
+    }
+    // Title matches need the frequencies of all words
+    if(result.empty() && !frequencies) {
+      break;
+    }
+  }
+
+  return true;
+}
+
+void SearchIndex::on_note_changed(const NoteBase::Ptr & note)
+{
+  if(m_loaded) {
+    update_note(note);
+  }
+  else if(m_thread) {
+    m_changed_notes.insert(note->uri());
+  }
+}
+
+void SearchIndex::on_note_added(const NoteBase::Ptr & note)
+{
+  on_note_changed(note);
+}
+
+void SearchIndex::on_note_deleted(const NoteBase::Ptr & note)
+{
+  if(m_loaded) {
+    remove_note(note->uri());
+  }
+  else if(m_thread) {
+    m_changed_notes.insert(note->uri());
+  }
+}
+
+void SearchIndex::on_note_saved(const NoteBase::Ptr & note)
+{
+  on_note_changed(note);
+}
+
+void SearchIndex::on_note_renamed(const NoteBase::Ptr & note, const Glib::ustring &)
+{
+  on_note_changed(note);
+}
+
+}
@@ -0,0 +1,247 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SEARCHINDEX_HPP_
+#define _SEARCHINDEX_HPP_
+
+#include <iosfwd>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <glibmm/dispatcher.h>
+#include <glibmm/threads.h>
+#include <glibmm/ustring.h>
+
+#include "base/macros.hpp"
+#include "notebase.hpp"
+#include "utils.hpp"
+
+
+namespace gnote {
+
+class NoteManagerBase;
+
+
+/**
+ * Terms of notes and the positions of each term within the note text.
+ * Besides the sorted terms, all suffixes of the terms are kept sorted,
+ * so that terms containing a word are found without looking at every
+ * term.
+ */
+class TermIndex
+{
+public:
+  typedef std::set<std::string> UriSet;
+
+  TermIndex();
+
+  /** Index %text of the note, replacing what was indexed for it before. */
+  void add_note(const std::string & uri, const std::string & change_date, const Glib::ustring & text);
+  void remove_note(const std::string & uri);
+  void clear();
+  /** Exchange contents with %other in constant time. */
+  void swap(TermIndex & other);
+
+  /** Change date the note was indexed with, empty if it is not indexed. */
+  std::string change_date(const std::string & uri) const;
+  void get_note_uris(std::vector<std::string> & uris) const;
+  size_t note_count() const
+    {
+      return m_notes.size();
+    }
+  /** Sum of lengths of all notes, in terms. */
+  size_t total_length() const
+    {
+      return m_total_length;
+    }
+  /** Number of terms in the note, 0 if it is not indexed. */
+  size_t note_length(const std::string & uri) const;
+
+  /**
+   * Collect the URIs of notes, where %terms appear one after another.
+   * The first term can end and the last one start in the middle of a
+   * term in the note.
+   */
+  void find_word_candidates(const std::vector<std::string> & terms, UriSet & result) const;
+
+  /** Returns false, if the stream does not contain a valid index. */
+  bool read(std::istream & in);
+  void write(std::ostream & out) const;
+private:
+  typedef std::vector<int> Positions;
+  // note URI -> positions of term in note
+  typedef std::map<std::string, Positions> Postings;
+  // term -> notes containing it
+  typedef std::map<std::string, Postings> TermMap;
+  struct NoteRecord
+  {
+    NoteRecord()
+      : length(0)
+      {}
+    std::string change_date;
+    std::vector<std::string> terms;
+    size_t length;
+  };
+  typedef std::map<std::string, NoteRecord> NoteMap;
+  // term and the byte offset in it, where the suffix starts
+  struct Suffix
+  {
+    TermMap::const_iterator term;
+    std::string::size_type offset;
+  };
+  struct SuffixLess
+  {
+    bool operator()(const Suffix & a, const Suffix & b) const
+      {
+        return a.term->first.compare(a.offset, std::string::npos,
+                                     b.term->first, b.offset, std::string::npos) < 0;
+      }
+  };
+  typedef std::multiset<Suffix, SuffixLess> SuffixSet;
+
+  Postings & add_term(const std::string & term);
+  void erase_term(TermMap::iterator term);
+  void find_terms(const std::string & token, bool first, bool last,
+                  std::vector<TermMap::const_iterator> & terms) const;
+
+  TermMap m_terms;
+  NoteMap m_notes;
+  SuffixSet m_suffixes;
+  size_t m_total_length;
+};
+
+
+/**
+ * Inverted index of note contents, persisted next to the notes.
+ * Every term maps to the notes that contain it and the positions of
+ * the term within the note text, so that a search only has to look
+ * at notes that can possibly match.
+ * The index is read, brought up to date and written on a worker thread.
+ * Until it is ready, queries are answered as if there was no index.
+ */
+class SearchIndex
+{
+public:
+  typedef TermIndex::UriSet UriSet;
+
+  static const char *INDEX_DIR_NAME;
+
+  /** split %text into lower case terms, in order of appearance */
+  static void tokenize(const Glib::ustring & text, std::vector<std::string> & terms);
+
+  SearchIndex(NoteManagerBase & manager, const std::string & index_file);
+  /** Waits for the index being written. */
+  ~SearchIndex();
+
+  /**
+   * Start reading the index and bringing it in sync with the loaded notes
+   * in background. Notes, that are not in memory, are read from their files.
+   */
+  void load();
+  /** Write the index to disk in background, if it has changed since it was last written. */
+  void save();
+  /** Wait until the index is written. */
+  void flush();
+  bool is_loaded() const
+    {
+      return m_loaded;
+    }
+
+  /**
+   * Collect the URIs of notes, that might contain all of the %words.
+   * Words may contain several terms (quoted phrases), in which case
+   * the terms have to appear next to each other.
+   * Returns false, if the index can not answer the query, in which case
+   * every note has to be checked.
+   * If %frequencies is given, it gets the number of notes containing
+   * each of the words, for ranking.
+   */
+  bool find_candidates(const std::vector<std::string> & words, UriSet & result,
+                       std::vector<size_t> *frequencies = NULL) const;
+
+  size_t note_count() const
+    {
+      return m_index.note_count();
+    }
+  /** Average number of terms in a note. */
+  double average_note_length() const
+    {
+      return m_index.note_count() == 0 ? 0 : double(m_index.total_length()) / m_index.note_count();
+    }
+  /** Number of terms in the note, 0 if it is not indexed. */
+  size_t note_length(const std::string & uri) const
+    {
+      return m_index.note_length(uri);
+    }
+
+  void update_note(const NoteBase::Ptr & note);
+  void remove_note(const std::string & uri);
+private:
+  // Note to bring up to date in the index, taken on the main thread
+  struct NoteSource
+  {
+    std::string uri;
+    std::string change_date;
+    std::string file_path;
+    // note content XML, the worker extracts the text, if it reindexes the note
+    Glib::ustring xml;
+    bool text_loaded;
+  };
+
+  void on_note_added(const NoteBase::Ptr & note);
+  void on_note_deleted(const NoteBase::Ptr & note);
+  void on_note_saved(const NoteBase::Ptr & note);
+  void on_note_renamed(const NoteBase::Ptr & note, const Glib::ustring & old_title);
+  void on_note_changed(const NoteBase::Ptr & note);
+  void on_built();
+  void queue_save();
+  void run();
+  TermIndex *build(const std::vector<NoteSource> & notes, bool & changed);
+  bool write_index_file(const std::string & contents);
+
+  NoteManagerBase & m_manager;
+  std::string m_index_file;
+  // Modified on the main thread only, while holding m_mutex,
+  // the worker thread reads it, while holding m_mutex
+  TermIndex m_index;
+  bool m_loaded;
+  // URIs of notes changed, while the index was being built
+  std::set<std::string> m_changed_notes;
+  utils::InterruptableTimeout m_save_timeout;
+  Glib::Dispatcher m_built_dispatcher;
+  Glib::Threads::Thread *m_thread;
+
+  // Shared with the worker thread
+  mutable Glib::Threads::Mutex m_mutex;
+  Glib::Threads::Cond m_cond;
+  std::vector<NoteSource> m_sources;
+  TermIndex *m_built;
+  bool m_built_changed;
+  bool m_dirty;
+  guint64 m_save_requested;
+  guint64 m_saved;
+  bool m_stop;
+};
+
+}
+
+#endif
@@ -20,6 +20,8 @@
  */
 
 
+#include <algorithm>
+
 #include <boost/format.hpp>
 #include <glibmm/i18n.h>
 #include <gtkmm/alignment.h>
@@ -55,6 +57,9 @@ SearchNotesWidget::SearchNotesWidget(NoteManager & m)
   : m_accel_group(Gtk::AccelGroup::create())
   , m_no_matches_box(NULL)
   , m_manager(m)
+  , m_search_executor(m)
+  , m_first_search_batch(false)
+  , m_search_in_notebook(false)
   , m_clickX(0), m_clickY(0)
   , m_matches_column(NULL)
   , m_note_list_context_menu(NULL)
@@ -163,10 +168,10 @@ void SearchNotesWidget::perform_search()
   // For some reason, the matches column must be rebuilt
   // every time because otherwise, it's not sortable.
   remove_matches_column();
-  Search search(m_manager);
 
   Glib::ustring text = m_search_text;
   if(text.empty()) {
+    m_search_executor.cancel();
     m_current_matches.clear();
     m_store_filter->refilter();
     if(m_tree->get_realized()) {
@@ -176,26 +181,41 @@ void SearchNotesWidget::perform_search()
   }
   text = text.lowercase();
 
-  m_current_matches.clear();
-
   // Search using the currently selected notebook
   notebooks::Notebook::Ptr selected_notebook = get_selected_notebook();
   if(dynamic_pointer_cast<notebooks::SpecialNotebook>(selected_notebook)) {
     selected_notebook = notebooks::Notebook::Ptr();
   }
 
-  Search::ResultsPtr results = search.search_notes(text, false, selected_notebook);
+  // Results of the previous search stay until the new ones arrive
+  m_first_search_batch = true;
+  m_search_in_notebook = selected_notebook != NULL;
+  m_search_executor.search(text, false, selected_notebook,
+                           sigc::mem_fun(*this, &SearchNotesWidget::on_search_results));
+}
+
+void SearchNotesWidget::on_search_results(const SearchExecutor::Matches & matches, bool finished)
+{
+  if(!m_first_search_batch) {
+    // Only the rows of new matches have to be filtered again
+    for(SearchExecutor::Matches::const_iterator iter = matches.begin(); iter != matches.end(); ++iter) {
+      m_current_matches[iter->first] = iter->second;
+      std::map<std::string, Gtk::TreeIter>::iterator row = m_store_rows.find(iter->first);
+      if(row != m_store_rows.end()) {
+        m_store->row_changed(m_store->get_path(row->second), row->second);
+      }
+    }
+    return;
+  }
+
+  m_first_search_batch = false;
+  m_current_matches = matches;
   // if no results found in current notebook ask user whether
   // to search in all notebooks
-  if(results->size() == 0 && selected_notebook != NULL) {
+  if(finished && m_current_matches.empty() && m_search_in_notebook) {
     no_matches_found_action();
   }
   else {
-    for(Search::Results::const_reverse_iterator iter = results->rbegin();
-        iter != results->rend(); iter++) {
-      m_current_matches[iter->second->uri()] = iter->first;
-    }
-
     add_matches_column();
     m_store_filter->refilter();
     if(m_tree->get_realized()) {
@@ -410,7 +430,7 @@ void SearchNotesWidget::on_notebook_selection_changed()
     }
   }
 
-  update_results();
+  perform_search();
   signal_name_changed(get_name());
 }
 
@@ -501,6 +521,7 @@ void SearchNotesWidget::update_results()
   }
 
   m_store = Gtk::ListStore::create(m_column_types);
+  m_store_rows.clear();
 
   m_store_filter = Gtk::TreeModelFilter::create(m_store);
   m_store_filter->set_visible_func(sigc::mem_fun(*this, &SearchNotesWidget::filter_notes));
@@ -514,18 +535,8 @@ void SearchNotesWidget::update_results()
   m_store_sort->signal_sort_column_changed()
     .connect(sigc::mem_fun(*this, &SearchNotesWidget::on_sorting_changed));
 
-  int cnt = 0;
-
-  FOREACH(const NoteBase::Ptr & note_iter, m_manager.get_notes()) {
-    Note::Ptr note(static_pointer_cast<Note>(note_iter));
-    std::string nice_date = utils::get_pretty_print_date(note->change_date(), true);
-
-    Gtk::TreeIter iter = m_store->append();
-    iter->set_value(0, get_note_icon());  /* icon */
-    iter->set_value(1, note->get_title()); /* title */
-    iter->set_value(2, nice_date);  /* change date */
-    iter->set_value(3, note);      /* note */
-    cnt++;
+  FOREACH(const NoteBase::Ptr & note, m_manager.get_notes()) {
+    add_note(static_pointer_cast<Note>(note));
   }
 
   m_tree->set_model(m_store_sort);
@@ -658,7 +669,8 @@ void SearchNotesWidget::make_recent_tree()
   Gtk::TreeViewColumn *title = manage(new Gtk::TreeViewColumn());
   title->set_title(_("Note"));
   title->set_min_width(150);
-  title->set_sizing(Gtk::TREE_VIEW_COLUMN_AUTOSIZE);
+  title->set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
+  title->set_fixed_width(150);
   title->set_expand(true);
   title->set_resizable(true);
 
@@ -679,19 +691,36 @@ void SearchNotesWidget::make_recent_tree()
 
   Gtk::TreeViewColumn *change = manage(new Gtk::TreeViewColumn());
   change->set_title(_("Modified"));
-  change->set_sizing(Gtk::TREE_VIEW_COLUMN_AUTOSIZE);
+  change->set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
   change->set_resizable(false);
 
   renderer = manage(new Gtk::CellRendererText());
   renderer->property_xalign() = 1.0;
   change->pack_start(*renderer, false);
-  change->add_attribute(*renderer, "text", 2 /* change date */);
+  change->set_cell_data_func(
+    *renderer,
+    sigc::mem_fun(*this, &SearchNotesWidget::change_date_column_data_func));
   change->set_sort_column(2); /* change date */
   change->set_sort_indicator(false);
   change->set_reorderable(false);
   change->set_sort_order(Gtk::SORT_DESCENDING);
 
   m_tree->append_column(*change);
+
+  // With fixed column widths and row height only the visible rows are
+  // measured and formatted, rather than every note in the list
+  int date_width = 0;
+  sharp::DateTime date = sharp::DateTime::now();
+  for(int i = 0; i < 3; ++i) {
+    int width, height;
+    m_tree->create_pango_layout(utils::get_pretty_print_date(date, true))->get_pixel_size(width, height);
+    date_width = std::max(date_width, width);
+    date.add_days(-200);
+  }
+  int xpad, ypad;
+  renderer->get_padding(xpad, ypad);
+  change->set_fixed_width(date_width + 2 * xpad + 12);
+  m_tree->set_fixed_height_mode(true);
 }
 
 void SearchNotesWidget::select_notes(const Note::List & notes)
@@ -777,16 +806,18 @@ bool SearchNotesWidget::filter_by_search(const Note::Ptr & note)
 
 bool SearchNotesWidget::filter_by_tag(const Note::Ptr & note)
 {
-  if(m_selected_tags.empty()) {
+  return has_selected_tag(m_selected_tags, *note);
+}
+
+bool SearchNotesWidget::has_selected_tag(const std::set<Tag::Ptr> & selected_tags, const NoteBase & note)
+{
+  if(selected_tags.empty()) {
     return true;
   }
 
-  //   // FIXME: Ugh!  NOT an O(1) operation.  Is there a better way?
-  std::list<Tag::Ptr> tags;
-  note->get_tags(tags);
-  for(std::list<Tag::Ptr>::const_iterator iter = tags.begin();
-      iter != tags.end(); ++iter) {
-    if(m_selected_tags.find(*iter) != m_selected_tags.end()) {
+  for(std::set<Tag::Ptr>::const_iterator iter = selected_tags.begin();
+      iter != selected_tags.end(); ++iter) {
+    if((*iter)->has_note(note)) {
       return true;
     }
   }
@@ -1042,7 +1073,8 @@ void SearchNotesWidget::add_matches_column()
 
     m_matches_column = manage(new Gtk::TreeViewColumn());
     m_matches_column->set_title(_("Matches"));
-    m_matches_column->set_sizing(Gtk::TREE_VIEW_COLUMN_AUTOSIZE);
+    m_matches_column->set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
+    m_matches_column->set_fixed_width(85);
     m_matches_column->set_resizable(false);
 
     renderer = manage(new Gtk::CellRendererText());
@@ -1074,6 +1106,23 @@ bool SearchNotesWidget::show_all_search_results()
   return true;
 }
 
+void SearchNotesWidget::change_date_column_data_func(Gtk::CellRenderer * cell,
+                                                     const Gtk::TreeIter & iter)
+{
+  Gtk::CellRendererText *crt = dynamic_cast<Gtk::CellRendererText*>(cell);
+  if(!crt) {
+    return;
+  }
+
+  Note::Ptr note = (*iter)[m_column_types.note];
+  if(note) {
+    crt->property_text() = utils::get_pretty_print_date(note->change_date(), true);
+  }
+  else {
+    crt->property_text() = "";
+  }
+}
+
 void SearchNotesWidget::matches_column_data_func(Gtk::CellRenderer * cell,
                                                  const Gtk::TreeIter & iter)
 {
@@ -1087,10 +1136,10 @@ void SearchNotesWidget::matches_column_data_func(Gtk::CellRenderer * cell,
   Note::Ptr note = (*iter)[m_column_types.note];
   if(note) {
     int match_count;
-    std::map<std::string, int>::const_iterator miter
+    SearchExecutor::Matches::const_iterator miter
       = m_current_matches.find(note->uri());
     if(miter != m_current_matches.end()) {
-      match_count = miter->second;
+      match_count = miter->second.matches;
       if(match_count == INT_MAX) {
         //TRANSLATORS: search found a match in note title
         match_str = _("Title match");
@@ -1115,10 +1164,8 @@ int SearchNotesWidget::compare_search_hits(const Gtk::TreeIter & a, const Gtk::T
     return -1;
   }
 
-  int matches_a;
-  int matches_b;
-  std::map<std::string, int>::iterator iter_a = m_current_matches.find(note_a->uri());
-  std::map<std::string, int>::iterator iter_b = m_current_matches.find(note_b->uri());
+  SearchExecutor::Matches::iterator iter_a = m_current_matches.find(note_a->uri());
+  SearchExecutor::Matches::iterator iter_b = m_current_matches.find(note_b->uri());
   bool has_matches_a = (iter_a != m_current_matches.end());
   bool has_matches_b = (iter_b != m_current_matches.end());
 
@@ -1130,9 +1177,10 @@ int SearchNotesWidget::compare_search_hits(const Gtk::TreeIter & a, const Gtk::T
     return -1;
   }
 
-  matches_a = iter_a->second;
-  matches_b = iter_b->second;
-  int result = matches_a - matches_b;
+  // Most relevant first, as ranked by the search
+  double score_a = iter_a->second.score;
+  double score_b = iter_b->second.score;
+  int result = score_a < score_b ? -1 : (score_b < score_a ? 1 : 0);
   if(result == 0) {
     // Do a secondary sort by note title in alphabetical order
     result = compare_titles(a, b);
@@ -1173,46 +1221,51 @@ void SearchNotesWidget::on_note_renamed(const NoteBase::Ptr & note,
   rename_note(static_pointer_cast<Note>(note));
 }
 
-void SearchNotesWidget::on_note_saved(const NoteBase::Ptr&)
+void SearchNotesWidget::on_note_saved(const NoteBase::Ptr & note)
 {
   restore_matches_window();
-  update_results();
+  update_note(note->uri());
 }
 
 void SearchNotesWidget::delete_note(const Note::Ptr & note)
 {
-  Gtk::TreeModel::Children rows = m_store->children();
-
-  for(Gtk::TreeModel::iterator iter = rows.begin();
-      rows.end() != iter; iter++) {
-    if(note == iter->get_value(m_column_types.note)) {
-      m_store->erase(iter);
-      break;
-    }
+  std::map<std::string, Gtk::TreeIter>::iterator row = m_store_rows.find(note->uri());
+  if(row != m_store_rows.end()) {
+    m_store->erase(row->second);
+    m_store_rows.erase(row);
   }
 }
 
 void SearchNotesWidget::add_note(const Note::Ptr & note)
 {
-  std::string nice_date =
-    utils::get_pretty_print_date(note->change_date(), true);
   Gtk::TreeIter iter = m_store->append();
   iter->set_value(m_column_types.icon, get_note_icon());
   iter->set_value(m_column_types.title, std::string(note->get_title()));
-  iter->set_value(m_column_types.change_date, nice_date);
   iter->set_value(m_column_types.note, note);
+  m_store_rows[note->uri()] = iter;
 }
 
 void SearchNotesWidget::rename_note(const Note::Ptr & note)
 {
-  Gtk::TreeModel::Children rows = m_store->children();
+  std::map<std::string, Gtk::TreeIter>::iterator row = m_store_rows.find(note->uri());
+  if(row != m_store_rows.end()) {
+    row->second->set_value(m_column_types.title, std::string(note->get_title()));
+  }
+}
 
-  for(Gtk::TreeModel::iterator iter = rows.begin();
-      rows.end() != iter; iter++) {
-    if(note == iter->get_value(m_column_types.note)) {
-      iter->set_value(m_column_types.title, std::string(note->get_title()));
-      break;
-    }
+void SearchNotesWidget::update_note(const std::string & uri)
+{
+  std::map<std::string, Gtk::TreeIter>::iterator row = m_store_rows.find(uri);
+  if(row == m_store_rows.end()) {
+    return;
+  }
+
+  // Let the filter and the sort look at the row again
+  m_store->row_changed(m_store->get_path(row->second), row->second);
+
+  // Changed contents or notebook can change the matches
+  if(!m_search_text.empty()) {
+    perform_search();
   }
 }
 
@@ -1263,24 +1316,24 @@ Gtk::Window *SearchNotesWidget::get_owning_window()
   return dynamic_cast<Gtk::Window*>(widget);
 }
 
-void SearchNotesWidget::on_note_added_to_notebook(const Note &,
+void SearchNotesWidget::on_note_added_to_notebook(const Note & note,
                                                   const notebooks::Notebook::Ptr &)
 {
   restore_matches_window();
-  update_results();
+  update_note(note.uri());
 }
 
-void SearchNotesWidget::on_note_removed_from_notebook(const Note &,
+void SearchNotesWidget::on_note_removed_from_notebook(const Note & note,
                                                       const notebooks::Notebook::Ptr &)
 {
   restore_matches_window();
-  update_results();
+  update_note(note.uri());
 }
 
-void SearchNotesWidget::on_note_pin_status_changed(const Note &, bool)
+void SearchNotesWidget::on_note_pin_status_changed(const Note & note, bool)
 {
   restore_matches_window();
-  update_results();
+  update_note(note.uri());
 }
 
 Gtk::Menu *SearchNotesWidget::get_note_list_context_menu()
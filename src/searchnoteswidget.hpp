@@ -35,6 +35,7 @@
 #include "mainwindowembeds.hpp"
 #include "notebooks/notebook.hpp"
 #include "notebooks/notebookstreeview.hpp"
+#include "searchexecutor.hpp"
 
 
 namespace gnote {
@@ -57,6 +58,9 @@ public:
   virtual std::vector<Glib::RefPtr<Gtk::Action> > get_widget_actions() override;
   virtual sigc::signal<void> & signal_actions_changed() override;
 
+  /** Tag filter of the note list: whether %note has any of %selected_tags. */
+  static bool has_selected_tag(const std::set<Tag::Ptr> & selected_tags, const NoteBase & note);
+
   void select_all_notes_notebook();
   void new_note();
   void delete_selected_notes();
@@ -105,15 +109,18 @@ private:
   void no_matches_found_action();
   void add_matches_column();
   bool show_all_search_results();
+  void on_search_results(const SearchExecutor::Matches & matches, bool finished);
   void matches_column_data_func(Gtk::CellRenderer *, const Gtk::TreeIter &);
+  void change_date_column_data_func(Gtk::CellRenderer *, const Gtk::TreeIter &);
   int compare_search_hits(const Gtk::TreeIter & , const Gtk::TreeIter &);
   void on_note_deleted(const NoteBase::Ptr & note);
   void on_note_added(const NoteBase::Ptr & note);
   void on_note_renamed(const NoteBase::Ptr&, const std::string&);
-  void on_note_saved(const NoteBase::Ptr&);
+  void on_note_saved(const NoteBase::Ptr & note);
   void delete_note(const Note::Ptr & note);
   void add_note(const Note::Ptr & note);
   void rename_note(const Note::Ptr & note);
+  void update_note(const std::string & uri);
   void on_open_note();
   void on_open_note_new_window();
   Gtk::Window *get_owning_window();
@@ -146,12 +153,11 @@ private:
   public:
     RecentNotesColumnTypes()
       {
-        add(icon); add(title); add(change_date); add(note);
+        add(icon); add(title); add(note);
       }
 
     Gtk::TreeModelColumn<Glib::RefPtr<Gdk::Pixbuf> > icon;
     Gtk::TreeModelColumn<std::string> title;
-    Gtk::TreeModelColumn<std::string> change_date;
     Gtk::TreeModelColumn<Note::Ptr> note;
   };
 
@@ -171,10 +177,16 @@ private:
   Glib::RefPtr<Gtk::TreeModelSort> m_store_sort;
   Glib::RefPtr<Gtk::TreeModelFilter> m_store_filter;
   RecentNotesColumnTypes m_column_types;
+  // note URI -> row in m_store
+  std::map<std::string, Gtk::TreeIter> m_store_rows;
   NoteManager & m_manager;
   Gtk::TreeView *m_tree;
   std::vector<Gtk::TargetEntry> m_targets;
-  std::map<std::string, int> m_current_matches;
+  SearchExecutor::Matches m_current_matches;
+  SearchExecutor m_search_executor;
+  // whether no results of the running search were received yet
+  bool m_first_search_batch;
+  bool m_search_in_notebook;
   int m_clickX, m_clickY;
   Gtk::TreeViewColumn *m_matches_column;
   Gtk::Menu *m_note_list_context_menu;
@@ -0,0 +1,60 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cmath>
+
+#include "searchrank.hpp"
+
+
+namespace gnote {
+
+const double Bm25::K1 = 1.2;
+const double Bm25::B = 0.75;
+const double Bm25::TITLE_BOOST = 3.0;
+const double Bm25::TAG_BOOST = 1.0;
+
+
+Bm25::Bm25(size_t note_count, double average_length)
+  : m_note_count(note_count)
+  , m_average_length(average_length)
+{
+}
+
+double Bm25::idf(size_t frequency) const
+{
+  double notes = m_note_count;
+  double found = std::min(double(frequency), notes);
+  // Never negative, a word found in most notes still counts a little
+  return std::log(1 + (notes - found + 0.5) / (found + 0.5));
+}
+
+double Bm25::text_score(double idf, int count, size_t length) const
+{
+  if(count <= 0) {
+    return 0;
+  }
+  double norm = K1;
+  if(m_average_length > 0) {
+    norm *= 1 - B + B * length / m_average_length;
+  }
+  return idf * count * (K1 + 1) / (count + norm);
+}
+
+}
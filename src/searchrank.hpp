@@ -0,0 +1,135 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __SEARCHRANK_HPP_
+#define __SEARCHRANK_HPP_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace gnote {
+
+/**
+ * Okapi BM25 relevance of notes for a query. Every query word adds its
+ * weight for the text, words found in the title or a tag add a boost
+ * on top of that.
+ */
+class Bm25
+{
+public:
+  static const double K1;
+  static const double B;
+  /**
+   * Title boost is larger than the most a word can score in the text,
+   * (K1 + 1) * idf, so a word found in the title outweighs the same word
+   * found any number of times in the text. Title matches are not ranked
+   * first overall: words with higher idf found only in the text can
+   * still score more.
+   */
+  static const double TITLE_BOOST;
+  static const double TAG_BOOST;
+
+  /**
+   * %average_length is the average number of terms in a note,
+   * note lengths are ignored, if it is 0.
+   */
+  Bm25(size_t note_count, double average_length);
+
+  /** Weight of a word, that is found in %frequency notes. */
+  double idf(size_t frequency) const;
+  /** Score for a word of weight %idf found %count times in a note of %length terms. */
+  double text_score(double idf, int count, size_t length) const;
+private:
+  size_t m_note_count;
+  double m_average_length;
+};
+
+
+/**
+ * Keeps the %k best scored values out of any number pushed, in a heap
+ * with the worst kept value on top. Pushing N values takes O(N log k).
+ * A %k of 0 keeps everything.
+ */
+template<class value_t>
+class TopHits
+{
+public:
+  typedef std::pair<double, value_t> Hit;
+
+  explicit TopHits(size_t k)
+    : m_k(k)
+    , m_pushed(0)
+    {}
+
+  void push(double score, const value_t & value)
+    {
+      ++m_pushed;
+      if(m_k > 0 && m_heap.size() >= m_k) {
+        if(!(m_heap.front().first < score)) {
+          return;
+        }
+        std::pop_heap(m_heap.begin(), m_heap.end(), WorseFirst());
+        m_heap.back() = Hit(score, value);
+      }
+      else {
+        m_heap.push_back(Hit(score, value));
+      }
+      std::push_heap(m_heap.begin(), m_heap.end(), WorseFirst());
+    }
+
+  size_t size() const
+    {
+      return m_heap.size();
+    }
+
+  /** Whether values were dropped, because more than %k were pushed. */
+  bool truncated() const
+    {
+      return m_pushed > m_heap.size();
+    }
+
+  /** Move the kept hits to %hits, best first. */
+  void take_sorted(std::vector<Hit> & hits)
+    {
+      std::sort_heap(m_heap.begin(), m_heap.end(), WorseFirst());
+      hits.swap(m_heap);
+      m_heap.clear();
+      m_pushed = 0;
+    }
+private:
+  struct WorseFirst
+  {
+    // the heap keeps the largest element on top, here the worst score
+    bool operator()(const Hit & a, const Hit & b) const
+      {
+        return a.first > b.first;
+      }
+  };
+
+  size_t m_k;
+  size_t m_pushed;
+  std::vector<Hit> m_heap;
+};
+
+}
+
+#endif
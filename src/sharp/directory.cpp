@@ -144,4 +144,20 @@ namespace sharp {
     return g_remove(dir.c_str()) == 0;
   }
 
+  bool directory_delete_recursive(const std::string & dir)
+  {
+    std::list<std::string> files;
+    directory_get_files(dir, files);
+    for(std::list<std::string>::iterator iter = files.begin(); iter != files.end(); ++iter) {
+      g_remove(iter->c_str());
+    }
+    std::list<std::string> dirs;
+    directory_get_directories(dir, dirs);
+    for(std::list<std::string>::iterator iter = dirs.begin(); iter != dirs.end(); ++iter) {
+      directory_delete_recursive(*iter);
+    }
+
+    return g_remove(dir.c_str()) == 0;
+  }
+
 }
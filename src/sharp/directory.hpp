@@ -65,6 +65,8 @@ namespace sharp {
   bool directory_create(const std::string & dir);
 
   bool directory_delete(const std::string & dir, bool recursive);
+  /** Delete %dir with all the files and directories in it. */
+  bool directory_delete_recursive(const std::string & dir);
 
 }
 
@@ -29,6 +29,11 @@
 
 #include "sharp/string.hpp"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define SHARP_STRING_X86 1
+  #include <immintrin.h>
+#endif
+
 #include <glibmm.h>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -41,6 +46,120 @@
 
 namespace sharp {
 
+namespace {
+
+  typedef std::string::size_type (*FindFunc)(const char *text, std::string::size_type length,
+                                             std::string::size_type start,
+                                             const StringMatcher::Needle & needle);
+
+  inline bool needle_matches_at(const char *text, const StringMatcher::Needle & needle)
+  {
+    const char *bytes = needle.bytes.data();
+    const char *masks = needle.masks.data();
+    for(std::string::size_type i = 0; i < needle.bytes.size(); ++i) {
+      if((text[i] | masks[i]) != bytes[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::string::size_type find_scalar(const char *text, std::string::size_type length,
+                                     std::string::size_type start,
+                                     const StringMatcher::Needle & needle)
+  {
+    std::string::size_type size = needle.bytes.size();
+    if(length < size) {
+      return std::string::npos;
+    }
+    char first = needle.bytes[0], first_mask = needle.masks[0];
+    for(std::string::size_type i = start; i <= length - size; ++i) {
+      if((text[i] | first_mask) == first && needle_matches_at(text + i, needle)) {
+        return i;
+      }
+    }
+    return std::string::npos;
+  }
+
+#ifdef SHARP_STRING_X86
+  // Candidates have both the first and the last byte of the needle in place,
+  // the bytes are compared after ORing with the mask, so that both cases match
+
+  __attribute__((target("sse2")))
+  std::string::size_type find_sse2(const char *text, std::string::size_type length,
+                                   std::string::size_type start,
+                                   const StringMatcher::Needle & needle)
+  {
+    std::string::size_type size = needle.bytes.size();
+    const __m128i first = _mm_set1_epi8(needle.bytes[0]);
+    const __m128i first_mask = _mm_set1_epi8(needle.masks[0]);
+    const __m128i last = _mm_set1_epi8(needle.bytes[size - 1]);
+    const __m128i last_mask = _mm_set1_epi8(needle.masks[size - 1]);
+    std::string::size_type i = start;
+    for(; i + size - 1 + 16 <= length; i += 16) {
+      __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+      __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + size - 1));
+      __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(block_first, first_mask), first),
+                                 _mm_cmpeq_epi8(_mm_or_si128(block_last, last_mask), last));
+      unsigned candidates = _mm_movemask_epi8(eq);
+      while(candidates) {
+        unsigned bit = __builtin_ctz(candidates);
+        if(needle_matches_at(text + i + bit, needle)) {
+          return i + bit;
+        }
+        candidates &= candidates - 1;
+      }
+    }
+    return find_scalar(text, length, i, needle);
+  }
+
+  __attribute__((target("avx2")))
+  std::string::size_type find_avx2(const char *text, std::string::size_type length,
+                                   std::string::size_type start,
+                                   const StringMatcher::Needle & needle)
+  {
+    std::string::size_type size = needle.bytes.size();
+    const __m256i first = _mm256_set1_epi8(needle.bytes[0]);
+    const __m256i first_mask = _mm256_set1_epi8(needle.masks[0]);
+    const __m256i last = _mm256_set1_epi8(needle.bytes[size - 1]);
+    const __m256i last_mask = _mm256_set1_epi8(needle.masks[size - 1]);
+    std::string::size_type i = start;
+    for(; i + size - 1 + 32 <= length; i += 32) {
+      __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+      __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + size - 1));
+      __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_or_si256(block_first, first_mask), first),
+                                    _mm256_cmpeq_epi8(_mm256_or_si256(block_last, last_mask), last));
+      unsigned candidates = _mm256_movemask_epi8(eq);
+      while(candidates) {
+        unsigned bit = __builtin_ctz(candidates);
+        if(needle_matches_at(text + i + bit, needle)) {
+          return i + bit;
+        }
+        candidates &= candidates - 1;
+      }
+    }
+    return find_sse2(text, length, i, needle);
+  }
+#endif
+
+  FindFunc select_find()
+  {
+#ifdef SHARP_STRING_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+      return find_avx2;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+      return find_sse2;
+    }
+#endif
+    return find_scalar;
+  }
+
+  const FindFunc s_find = select_find();
+
+}
+
 
   std::string string_replace_first(const std::string & source, const std::string & from,
                              const std::string & with)
@@ -136,19 +255,95 @@ namespace sharp {
 
   int string_index_of(const std::string & source, const std::string & search, int start_at)
   {
-    std::string source2(source.begin() + start_at, source.end());
-    boost::iterator_range<std::string::const_iterator> iter
-      = boost::find_first(source2, search);
+    DBG_ASSERT(start_at >= 0 && std::string::size_type(start_at) <= source.size(),
+               "start_at out of range");
     // C# returns index 0 if looking for the empty string
     if(search.empty()) {
-      // Note: check this after 'find_first' so boost will throw an exception if start_at > source.size()
       return start_at;
     }
-    if(iter.begin() == source2.end()) {
+    std::string::size_type pos = source.find(search, start_at);
+    if(pos == std::string::npos) {
       // NOT FOUND
       return -1;
     }
-    return iter.begin() - source2.begin() + start_at;
+    return pos;
+  }
+
+
+  bool string_contains_nocase(const Glib::ustring & source, const Glib::ustring & search)
+  {
+    std::vector<std::string> needles(1, search.lowercase());
+    StringMatcher matcher(needles, false);
+    if(matcher.ascii_only()) {
+      return matcher.contains_all(source.raw());
+    }
+    return matcher.contains_all(source.lowercase().raw());
+  }
+
+
+  StringMatcher::StringMatcher(const std::vector<std::string> & needles, bool case_sensitive)
+    : m_needles(needles.size())
+    , m_case_sensitive(case_sensitive)
+    , m_ascii_only(true)
+  {
+    for(std::vector<std::string>::size_type i = 0; i < needles.size(); ++i) {
+      Needle & needle = m_needles[i];
+      needle.bytes = needles[i];
+      needle.masks.assign(needle.bytes.size(), 0);
+      for(std::string::size_type j = 0; j < needle.bytes.size(); ++j) {
+        unsigned char c = needle.bytes[j];
+        if(c >= 0x80) {
+          m_ascii_only = false;
+        }
+        else if(!case_sensitive && g_ascii_isalpha(c)) {
+          needle.bytes[j] = g_ascii_tolower(c);
+          needle.masks[j] = 0x20;
+        }
+      }
+    }
+  }
+
+
+  std::string::size_type StringMatcher::find(const std::string & text,
+                                             std::vector<std::string>::size_type index,
+                                             std::string::size_type start) const
+  {
+    const Needle & needle = m_needles[index];
+    if(start > text.size()) {
+      return std::string::npos;
+    }
+    if(needle.bytes.empty()) {
+      return start;
+    }
+    return s_find(text.data(), text.size(), start, needle);
+  }
+
+
+  bool StringMatcher::contains_all(const std::string & text) const
+  {
+    for(std::vector<Needle>::size_type i = 0; i < m_needles.size(); ++i) {
+      if(find(text, i) == std::string::npos) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  void StringMatcher::count(const std::string & text, std::vector<int> & counts) const
+  {
+    counts.assign(m_needles.size(), 0);
+    for(std::vector<Needle>::size_type i = 0; i < m_needles.size(); ++i) {
+      std::string::size_type size = m_needles[i].bytes.size();
+      if(size == 0) {
+        continue;
+      }
+      std::string::size_type pos = find(text, i);
+      while(pos != std::string::npos) {
+        ++counts[i];
+        pos = find(text, i, pos + size);
+      }
+    }
   }
 
 }
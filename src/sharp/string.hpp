@@ -69,6 +69,65 @@ namespace sharp {
   int string_index_of(const std::string & source, const std::string & with);
   int string_index_of(const std::string & source, const std::string & with, int);
   int string_last_index_of(const std::string & source, const std::string & with);
+
+  /**
+   * Whether %source contains %search, ignoring case.
+   * ASCII %search is looked for in place, without lower casing %source.
+   */
+  bool string_contains_nocase(const Glib::ustring & source, const Glib::ustring & search);
+
+
+  /**
+   * Looks for several needles in UTF-8 text, in place. Candidates are
+   * found by comparing the first and the last byte of a needle with
+   * 32 (AVX2) or 16 (SSE2) bytes of text at a time, where the CPU
+   * supports it, and one byte at a time otherwise.
+   * When the case is ignored, only ASCII letters are compared ignoring
+   * the case. Unless ascii_only(), text and needles have to be lower
+   * cased beforehand.
+   */
+  class StringMatcher
+  {
+  public:
+    StringMatcher(const std::vector<std::string> & needles, bool case_sensitive);
+
+    /**
+     * Position of the first occurrence of needle %index in %text at or
+     * after %start, std::string::npos if there is none.
+     */
+    std::string::size_type find(const std::string & text, std::vector<std::string>::size_type index,
+                                std::string::size_type start = 0) const;
+    /** Whether %text contains every one of the needles. */
+    bool contains_all(const std::string & text) const;
+    /** Count non-overlapping occurrences of every needle in %text. */
+    void count(const std::string & text, std::vector<int> & counts) const;
+
+    /** Whether ignoring the case needs no lower casing of the text. */
+    bool ascii_only() const
+      {
+        return m_ascii_only;
+      }
+    bool case_sensitive() const
+      {
+        return m_case_sensitive;
+      }
+    std::vector<std::string>::size_type size() const
+      {
+        return m_needles.size();
+      }
+
+    struct Needle
+    {
+      // lower cased, unless case sensitive
+      std::string bytes;
+      // ORed to text bytes before comparing, 0x20 for letters ignoring case
+      std::string masks;
+    };
+  private:
+    std::vector<Needle> m_needles;
+    bool m_case_sensitive;
+    bool m_ascii_only;
+  };
 }
 
 
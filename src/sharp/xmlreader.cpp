@@ -143,6 +143,11 @@ namespace sharp {
     return xmlchar_to_string(xmlTextReaderReadOuterXml(m_reader), true);
   }
 
+  bool XmlReader::is_empty_element()
+  {
+    return xmlTextReaderIsEmptyElement(m_reader) > 0;
+  }
+
   bool XmlReader::move_to_next_attribute()
   {
     if(m_error) {
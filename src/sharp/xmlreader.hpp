@@ -64,6 +64,7 @@ public:
   std::string    read_string();
   std::string    read_inner_xml();
   std::string    read_outer_xml();
+  bool           is_empty_element();
   bool           move_to_next_attribute();
   bool           read_attribute_value();
 
@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2012-2013 Aurimas Cernius
+ * Copyright (C) 2012-2014 Aurimas Cernius
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,20 +18,27 @@
  */
 
 
-#include <algorithm>
-#include <fstream>
+#include <string.h>
+
+#include <set>
 #include <stdexcept>
+#include <vector>
 
-#include <boost/format.hpp>
+#include <glibmm/fileutils.h>
 #include <glibmm/i18n.h>
+#include <glibmm/threads.h>
+#include <libxml/xmlreader.h>
 
 #include "debug.hpp"
 #include "filesystemsyncserver.hpp"
+#include "notehash.hpp"
+#include "notepack.hpp"
+#include "preferences.hpp"
+#include "transferpool.hpp"
 #include "sharp/directory.hpp"
 #include "sharp/files.hpp"
 #include "sharp/uuid.hpp"
 #include "sharp/xml.hpp"
-#include "sharp/xmlreader.hpp"
 #include "sharp/xmlwriter.hpp"
 
 
@@ -47,6 +54,147 @@ int str_to_int(const std::string & s)
   }
 }
 
+std::string get_attribute(xmlTextReaderPtr reader, const char *name)
+{
+  xmlChar *value = xmlTextReaderGetAttribute(reader, reinterpret_cast<const xmlChar*>(name));
+  if(!value) {
+    return "";
+  }
+  std::string result(reinterpret_cast<const char*>(value));
+  xmlFree(value);
+  return result;
+}
+
+// Revision from a revision directory name, false for other directories
+bool parse_revision(const std::string & name, int & revision)
+{
+  if(name.empty() || name.size() > 9 || name.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  revision = str_to_int(name);
+  return true;
+}
+
+// Copies note files to a revision directory or compresses them for
+// its pack, a file per job
+class NoteUpload
+{
+public:
+  NoteUpload(const gnote::sync::FileSystemSyncServer::NoteFileMap & note_files, const std::string & dest_dir,
+             bool pack)
+    : m_dest_dir(dest_dir)
+    , m_pack(pack)
+    {
+      for(gnote::sync::FileSystemSyncServer::NoteFileMap::const_iterator iter = note_files.begin();
+          iter != note_files.end(); ++iter) {
+        m_sources.push_back(iter->first);
+        m_hashes.push_back(iter->second);
+      }
+      m_copied.resize(m_sources.size(), false);
+      if(m_pack) {
+        m_compressed.resize(m_sources.size());
+        m_sizes.resize(m_sources.size(), 0);
+      }
+    }
+
+  void copy(size_t item)
+    {
+      const std::string & source = m_sources[item];
+      try {
+        if(m_pack) {
+          std::string data = Glib::file_get_contents(source);
+          m_sizes[item] = data.size();
+          m_compressed[item] = gnote::sync::NotePack::compress(data);
+        }
+        else {
+          sharp::file_copy(source, Glib::build_filename(m_dest_dir, sharp::file_filename(source)));
+        }
+        m_copied[item] = true;
+      }
+      catch(...) {
+        DBG_OUT("Sync: Error uploading note \"%s\"", source.c_str());
+      }
+    }
+
+  size_t size() const
+    {
+      return m_sources.size();
+    }
+  const std::string & source(size_t item) const
+    {
+      return m_sources[item];
+    }
+  const std::string & hash(size_t item) const
+    {
+      return m_hashes[item];
+    }
+  bool copied(size_t item) const
+    {
+      return m_copied[item];
+    }
+  const std::string & compressed(size_t item) const
+    {
+      return m_compressed[item];
+    }
+  guint32 compressed_size(size_t item) const
+    {
+      return m_sizes[item];
+    }
+private:
+  std::vector<std::string> m_sources;
+  std::vector<std::string> m_hashes;
+  std::string m_dest_dir;
+  bool m_pack;
+  // not std::vector<bool>, jobs on different threads set their own items
+  std::vector<char> m_copied;
+  std::vector<std::string> m_compressed;
+  std::vector<guint32> m_sizes;
+};
+
+// Reads notes from the server into note updates, a note per job
+class NoteDownload
+{
+public:
+  /** Note is read from %pack, if not NULL, from the file at %path otherwise. */
+  void add(const std::string & note_id, int revision, const std::string & hash, const std::string & path,
+           const gnote::sync::NotePackReader *pack)
+    {
+      Item item = { note_id, revision, hash, path, pack };
+      m_items.push_back(item);
+    }
+
+  void read(size_t item)
+    {
+      const Item & note = m_items[item];
+      std::string xml = note.pack ? note.pack->read(note.note_id) : Glib::file_get_contents(note.path);
+      gnote::sync::NoteUpdate update(xml, "", note.note_id, note.revision, note.hash);
+      Glib::Threads::Mutex::Lock lock(m_mutex);
+      m_updates.insert(std::make_pair(note.note_id, update));
+    }
+
+  size_t size() const
+    {
+      return m_items.size();
+    }
+  const std::map<std::string, gnote::sync::NoteUpdate> & updates() const
+    {
+      return m_updates;
+    }
+private:
+  struct Item
+  {
+    std::string note_id;
+    int revision;
+    std::string hash;
+    std::string path;
+    const gnote::sync::NotePackReader *pack;
+  };
+
+  std::vector<Item> m_items;
+  std::map<std::string, gnote::sync::NoteUpdate> m_updates;
+  Glib::Threads::Mutex m_mutex;
+};
+
 }
 
 
@@ -59,9 +207,14 @@ SyncServer::Ptr FileSystemSyncServer::create(const std::string & path)
 }
 
 
+const int FileSystemSyncServer::COMPACT_INTERVAL = 20;
+const size_t FileSystemSyncServer::MAX_NOTE_REVISIONS = 8;
+const int FileSystemSyncServer::MANIFEST_FORMAT = 2;
+
+
 FileSystemSyncServer::FileSystemSyncServer(const std::string & localSyncPath)
-  : m_server_path(localSyncPath)
-  , m_cache_path(Glib::build_filename(Glib::get_tmp_dir(), Glib::get_user_name(), "gnote"))
+  : m_pack_writer(NULL)
+  , m_server_path(localSyncPath)
 {
   if(!sharp::directory_exists(m_server_path)) {
     throw std::invalid_argument(("Directory not found: " + m_server_path).c_str());
@@ -70,36 +223,68 @@ FileSystemSyncServer::FileSystemSyncServer(const std::string & localSyncPath)
   m_lock_path = Glib::build_filename(m_server_path, "lock");
   m_manifest_path = Glib::build_filename(m_server_path, "manifest.xml");
 
+  int transfer_threads = Preferences::obj().get_schema_settings(Preferences::SCHEMA_SYNC)
+    ->get_int(Preferences::SYNC_TRANSFER_THREADS);
+  set_transfer_threads(transfer_threads > 0 ? transfer_threads : 1);
+  set_use_packs(Preferences::obj().get_schema_settings(Preferences::SCHEMA_SYNC)
+    ->get_boolean(Preferences::SYNC_PACK_NOTES));
+
   m_new_revision = latest_revision() + 1;
   m_new_revision_path = get_revision_dir_path(m_new_revision);
+  // Another client can commit, before this one takes the lock
+  m_manifest = Manifest();
 
   m_lock_timeout.signal_timeout
     .connect(sigc::mem_fun(*this, &FileSystemSyncServer::lock_timeout));
 }
 
 
+FileSystemSyncServer::~FileSystemSyncServer()
+{
+  delete m_pack_writer;
+}
+
+
 void FileSystemSyncServer::upload_notes(const std::list<Note::Ptr> & notes)
+{
+  NoteFileMap note_files;
+  for(std::list<Note::Ptr>::const_iterator iter = notes.begin(); iter != notes.end(); ++iter) {
+    note_files[(*iter)->file_path()] = NoteHash::note_hash(*iter);
+  }
+  upload_note_files(note_files);
+}
+
+
+void FileSystemSyncServer::upload_note_files(const NoteFileMap & note_files)
 {
   if(sharp::directory_exists(m_new_revision_path) == false) {
     sharp::directory_create(m_new_revision_path);
   }
-  DBG_OUT("UploadNotes: notes.Count = %d", int(notes.size()));
-  for(std::list<Note::Ptr>::const_iterator iter = notes.begin(); iter != notes.end(); ++iter) {
-    try {
-      std::string serverNotePath = Glib::build_filename(m_new_revision_path, sharp::file_filename((*iter)->file_path()));
-      sharp::file_copy((*iter)->file_path(), serverNotePath);
-      m_updated_notes.push_back(sharp::file_basename((*iter)->file_path()));
-    }
-    catch(...) {
-      DBG_OUT("Sync: Error uploading note \"%s\"", (*iter)->get_title().c_str());
+  DBG_OUT("UploadNotes: notes.Count = %d", int(note_files.size()));
+  gint64 start = g_get_monotonic_time();
+  // Notes are not packed for a server, that an older client has written to
+  bool use_packs = m_use_packs && manifest().format >= MANIFEST_FORMAT;
+  NoteUpload upload(note_files, m_new_revision_path, use_packs);
+  TransferPool pool(m_transfer_threads);
+  pool.run(upload.size(), sigc::mem_fun(upload, &NoteUpload::copy));
+  for(size_t i = 0; i < upload.size(); ++i) {
+    if(upload.copied(i)) {
+      std::string note_id = sharp::file_basename(upload.source(i));
+      if(use_packs) {
+        pack_writer().add(note_id, upload.compressed(i), upload.compressed_size(i));
+        m_packed_notes.insert(note_id);
+      }
+      m_updated_notes[note_id] = upload.hash(i);
     }
   }
+  DBG_OUT("UploadNotes: copied %d notes in %d ms on %u threads", int(upload.size()),
+          int((g_get_monotonic_time() - start) / 1000), pool.thread_count());
 }
 
 
 void FileSystemSyncServer::delete_notes(const std::list<std::string> & deletedNoteUUIDs)
 {
-  m_deleted_notes.insert(m_deleted_notes.end(), deletedNoteUUIDs.begin(), deletedNoteUUIDs.end());
+  m_deleted_notes.insert(deletedNoteUUIDs.begin(), deletedNoteUUIDs.end());
 }
 
 
@@ -107,16 +292,10 @@ std::list<std::string> FileSystemSyncServer::get_all_note_uuids()
 {
   std::list<std::string> noteUUIDs;
 
-  if(is_valid_xml_file(m_manifest_path)) {
-    // TODO: Permission errors
-    xmlDocPtr xml_doc = xmlReadFile(m_manifest_path.c_str(), "UTF-8", 0);
-    xmlNodePtr root_node = xmlDocGetRootElement(xml_doc);
-    sharp::XmlNodeSet noteIds = sharp::xml_node_xpath_find(root_node, "//note/@id");
-    DBG_OUT("get_all_note_uuids has %d notes", int(noteIds.size()));
-    for(sharp::XmlNodeSet::iterator iter = noteIds.begin(); iter != noteIds.end(); ++iter) {
-      noteUUIDs.push_back(sharp::xml_node_content(*iter));
-    }
-    xmlFreeDoc(xml_doc);
+  const Manifest & current = manifest();
+  DBG_OUT("get_all_note_uuids has %d notes", int(current.notes.size()));
+  for(NoteRevisionMap::const_iterator iter = current.notes.begin(); iter != current.notes.end(); ++iter) {
+    noteUUIDs.push_back(iter->first);
   }
 
   return noteUUIDs;
@@ -131,65 +310,37 @@ bool FileSystemSyncServer::updates_available_since(int revision)
 
 std::map<std::string, NoteUpdate> FileSystemSyncServer::get_note_updates_since(int revision)
 {
-  std::map<std::string, NoteUpdate> noteUpdates;
-
-  std::string tempPath = Glib::build_filename(m_cache_path, "sync_temp");
-  if(!sharp::directory_exists(tempPath)) {
-    sharp::directory_create(tempPath);
-  }
-  else {
-    // Empty the temp dir
-    try {
-      std::list<std::string> files;
-      sharp::directory_get_files(tempPath, files);
-      for(std::list<std::string>::iterator iter = files.begin(); iter != files.end(); ++iter) {
-        sharp::file_delete(*iter);
-      }
-    }
-    catch(...) {}
-  }
-
-  if(is_valid_xml_file(m_manifest_path)) {
-    xmlDocPtr xml_doc = xmlReadFile(m_manifest_path.c_str(), "UTF-8", 0);
-    xmlNodePtr root_node = xmlDocGetRootElement(xml_doc);
-
-    std::string xpath = str(boost::format("//note[@rev > %1%]") % revision);
-    sharp::XmlNodeSet noteNodes = sharp::xml_node_xpath_find(root_node, xpath.c_str());
-    DBG_OUT("get_note_updates_since xpath returned %d nodes", int(noteNodes.size()));
-    for(sharp::XmlNodeSet::iterator iter = noteNodes.begin(); iter != noteNodes.end(); ++iter) {
-      std::string note_id = sharp::xml_node_content(sharp::xml_node_xpath_find_single_node(*iter, "@id"));
-      int rev = str_to_int(sharp::xml_node_content(sharp::xml_node_xpath_find_single_node(*iter, "@rev")));
-      if(noteUpdates.find(note_id) == noteUpdates.end()) {
-        // Copy the file from the server to the temp directory
-        std::string revDir = get_revision_dir_path(rev);
-        std::string serverNotePath = Glib::build_filename(revDir, note_id + ".note");
-        std::string noteTempPath = Glib::build_filename(tempPath, note_id + ".note");
-        sharp::file_copy(serverNotePath, noteTempPath);
-
-        // Get the title, contents, etc.
-        std::string noteTitle;
-        std::string noteXml;
-        std::ifstream fin(noteTempPath.c_str());
-        if(fin.is_open()) {
-          do {
-            std::string line;
-            std::getline(fin, line);
-            if(!fin.eof()) {
-              noteXml += line + "\n";
-            }
-          }
-          while(!fin.eof());
-          fin.close();
+  gint64 start = g_get_monotonic_time();
+  NoteDownload download;
+  // revision -> its pack, the index of each pack is read once
+  std::map<int, shared_ptr<NotePackReader> > packs;
+  const Manifest & current = manifest();
+  for(NoteRevisionMap::const_iterator iter = current.notes.begin(); iter != current.notes.end(); ++iter) {
+    int rev = iter->second.revision;
+    if(rev > revision) {
+      int pack_rev = iter->second.pack;
+      shared_ptr<NotePackReader> pack;
+      if(pack_rev >= 0) {
+        pack = packs[pack_rev];
+        if(!pack) {
+          pack = shared_ptr<NotePackReader>(new NotePackReader(
+            Glib::build_filename(get_revision_dir_path(pack_rev), NotePack::FILE_NAME)));
+          packs[pack_rev] = pack;
         }
-        NoteUpdate update(noteXml, noteTitle, note_id, rev);
-        noteUpdates.insert(std::make_pair(note_id, update));
       }
+      std::string serverNotePath = Glib::build_filename(get_revision_dir_path(rev), iter->first + ".note");
+      download.add(iter->first, rev, iter->second.hash, serverNotePath, pack.get());
     }
-    xmlFreeDoc(xml_doc);
   }
 
-  DBG_OUT("get_note_updates_since (%d) returning: %d", revision, int(noteUpdates.size()));
-  return noteUpdates;
+  // Notes are read and parsed straight from the server, several at once
+  xmlInitParser();
+  TransferPool pool(m_transfer_threads);
+  pool.run(download.size(), sigc::mem_fun(download, &NoteDownload::read));
+
+  DBG_OUT("get_note_updates_since (%d) returning: %d, read in %d ms on %u threads", revision,
+          int(download.updates().size()), int((g_get_monotonic_time() - start) / 1000), pool.thread_count());
+  return download.updates();
 }
 
 
@@ -245,8 +396,14 @@ bool FileSystemSyncServer::begin_sync_transaction()
   // Reset the timer to 20 seconds sooner than the sync lock duration
   m_lock_timeout.reset(m_sync_lock.duration.total_milliseconds() - 20000);
 
+  // Read the manifest again under the lock, file state can not tell
+  // reliably on network mounts, whether another client changed it
+  m_manifest = Manifest();
   m_updated_notes.clear();
   m_deleted_notes.clear();
+  m_packed_notes.clear();
+  delete m_pack_writer;
+  m_pack_writer = NULL;
 
   return true;
 }
@@ -263,63 +420,44 @@ bool FileSystemSyncServer::commit_sync_transaction()
       sharp::directory_create(m_new_revision_path);
     }
 
-    std::map<std::string, std::string> notes;
-    if(is_valid_xml_file(m_manifest_path) == true) {
-      xmlDocPtr xml_doc = xmlReadFile(m_manifest_path.c_str(), "UTF-8", 0);
-      xmlNodePtr root_node = xmlDocGetRootElement(xml_doc);
-      sharp::XmlNodeSet noteNodes = sharp::xml_node_xpath_find(root_node, "//note");
-      for(sharp::XmlNodeSet::iterator iter = noteNodes.begin(); iter != noteNodes.end(); ++iter) {
-        std::string note_id = sharp::xml_node_get_attribute(*iter, "id");
-        std::string rev = sharp::xml_node_get_attribute(*iter, "rev");
-        notes[note_id] = rev;
-      }
-      xmlFreeDoc(xml_doc);
+    // The new manifest is the current one with the changes of this transaction
+    manifest();
+    // Pack references of a manifest, written by an older client, were
+    // guessed, so no pack is rewritten and no revision is deleted now
+    bool compact = m_use_packs && m_manifest.format >= MANIFEST_FORMAT
+      && m_new_revision % COMPACT_INTERVAL == 0;
+    m_manifest.revision = m_new_revision;
+    m_manifest.format = MANIFEST_FORMAT;
+    m_manifest.server_id = m_server_id;
+    for(NoteIdSet::iterator iter = m_deleted_notes.begin(); iter != m_deleted_notes.end(); ++iter) {
+      m_manifest.notes.erase(*iter);
     }
-
-    // Write out the new manifest file
-    sharp::XmlWriter *xml = new sharp::XmlWriter(manifestFilePath);
-    try {
-      xml->write_start_document();
-      xml->write_start_element("", "sync", "");
-      xml->write_attribute_string("", "revision", "", TO_STRING(m_new_revision));
-      xml->write_attribute_string("", "server-id", "", m_server_id);
-
-      for(std::map<std::string, std::string>::iterator iter = notes.begin(); iter != notes.end(); ++iter) {
-        // Don't write out deleted notes
-        if(std::find(m_deleted_notes.begin(), m_deleted_notes.end(), iter->first) != m_deleted_notes.end()) {
-          continue;
-        }
-
-        // Skip updated notes, we'll update them in a sec
-        if(std::find(m_updated_notes.begin(), m_updated_notes.end(), iter->first) != m_updated_notes.end()) {
-          continue;
-        }
-
-        xml->write_start_element("", "note", "");
-        xml->write_attribute_string("", "id", "", iter->first);
-        xml->write_attribute_string("", "rev", "", iter->second);
-        xml->write_end_element();
+    for(NoteHashMap::iterator iter = m_updated_notes.begin(); iter != m_updated_notes.end(); ++iter) {
+      NoteRevision & note = m_manifest.notes[iter->first];
+      note.revision = m_new_revision;
+      note.hash = iter->second;
+      note.pack = m_packed_notes.find(iter->first) != m_packed_notes.end() ? m_new_revision : -1;
+    }
+    if(compact) {
+      try {
+        pack_notes();
       }
-
-      // Write out all the updated notes
-      for(std::list<std::string>::iterator iter = m_updated_notes.begin(); iter != m_updated_notes.end(); ++iter) {
-        xml->write_start_element("", "note", "");
-        xml->write_attribute_string("", "id", "", *iter);
-        xml->write_attribute_string("", "rev", "", TO_STRING(m_new_revision));
-        xml->write_end_element();
+      catch(Glib::Exception & e) {
+        ERR_OUT(_("Failed to pack notes on synchronization server: %s"), e.what().c_str());
+      }
+      catch(std::exception & e) {
+        ERR_OUT(_("Failed to pack notes on synchronization server: %s"), e.what());
       }
-
-      xml->write_end_element();
-      xml->write_end_document();
-      xml->close();
-      delete xml;
     }
-    catch(...) {
-      xml->close();
-      delete xml;
-      throw;
+    // The pack must be complete, before the manifest refers to it
+    if(m_pack_writer) {
+      m_pack_writer->close();
+      delete m_pack_writer;
+      m_pack_writer = NULL;
     }
 
+    write_manifest(manifestFilePath, m_manifest);
+
 
     // Rename original /manifest.xml to /manifest.xml.old
     std::string oldManifestPath = m_manifest_path + ".old";
@@ -338,6 +476,8 @@ bool FileSystemSyncServer::commit_sync_transaction()
 
     // Copy the /${parent}/${rev}/manifest.xml -> /manifest.xml
     sharp::file_copy(manifestFilePath, m_manifest_path);
+    m_manifest.loaded = true;
+    m_manifest.valid = true;
 
     try {
       // Delete /manifest.xml.old
@@ -353,8 +493,8 @@ bool FileSystemSyncServer::commit_sync_transaction()
         sharp::directory_get_files(oldManifestFilePath, files);
         for(std::list<std::string>::iterator iter = files.begin(); iter != files.end(); ++iter) {
           std::string fileGuid = sharp::file_basename(*iter);
-          if(std::find(m_deleted_notes.begin(), m_deleted_notes.end(), fileGuid) != m_deleted_notes.end()
-             || std::find(m_updated_notes.begin(), m_updated_notes.end(), fileGuid) != m_updated_notes.end()) {
+          if(m_deleted_notes.find(fileGuid) != m_deleted_notes.end()
+             || m_updated_notes.find(fileGuid) != m_updated_notes.end()) {
             sharp::file_delete(Glib::build_filename(oldManifestFilePath, *iter));
           }
           // TODO: Need to check *all* revision dirs, not just previous (duh)
@@ -369,6 +509,10 @@ bool FileSystemSyncServer::commit_sync_transaction()
       ERR_OUT(_("Exception during server cleanup while committing. Server integrity is OK, but "
                 "there may be some excess files floating around.  Here's the error: %s\n"), e.what());
     }
+
+    if(compact && m_manifest.valid) {
+      delete_unused_revisions();
+    }
     // * * * End Cleanup Code * * *
   }
 
@@ -381,6 +525,8 @@ bool FileSystemSyncServer::commit_sync_transaction()
 
 bool FileSystemSyncServer::cancel_sync_transaction()
 {
+  delete m_pack_writer;
+  m_pack_writer = NULL;
   m_lock_timeout.cancel();
   sharp::file_delete(m_lock_path);
   return true;
@@ -389,18 +535,8 @@ bool FileSystemSyncServer::cancel_sync_transaction()
 
 int FileSystemSyncServer::latest_revision()
 {
-  int latestRev = -1;
+  int latestRev = manifest().revision;
   int latestRevDir = -1;
-  xmlDocPtr xml_doc = NULL;
-  if(is_valid_xml_file(m_manifest_path) == true) {
-    xml_doc = xmlReadFile(m_manifest_path.c_str(), "UTF-8", 0);
-    xmlNodePtr root_node = xmlDocGetRootElement(xml_doc);
-    xmlNodePtr syncNode = sharp::xml_node_xpath_find_single_node(root_node, "//sync");
-    std::string latestRevStr = sharp::xml_node_get_attribute(syncNode, "revision");
-    if(latestRevStr != "") {
-      latestRev = str_to_int(latestRevStr);
-    }
-  }
 
   bool foundValidManifest = false;
   while (!foundValidManifest) {
@@ -459,7 +595,6 @@ int FileSystemSyncServer::latest_revision()
     }
   }
 
-  xmlFreeDoc(xml_doc);
   return latestRev;
 }
 
@@ -514,14 +649,7 @@ std::string FileSystemSyncServer::id()
   m_server_id = "";
 
   // Attempt to read from manifest file first
-  if(is_valid_xml_file(m_manifest_path)) {
-    sharp::XmlReader reader(m_manifest_path);
-    if(reader.read()) {
-      if(reader.get_node_type() == XML_READER_TYPE_ELEMENT && reader.get_name() == "sync") {
-	m_server_id = reader.get_attribute("server-id");
-      }
-    }
-  }
+  m_server_id = manifest().server_id;
 
   // Generate a new ID if there isn't already one
   if(m_server_id == "") {
@@ -538,6 +666,163 @@ std::string FileSystemSyncServer::get_revision_dir_path(int rev)
 }
 
 
+NotePackWriter & FileSystemSyncServer::pack_writer()
+{
+  if(!m_pack_writer) {
+    if(!sharp::directory_exists(m_new_revision_path)) {
+      sharp::directory_create(m_new_revision_path);
+    }
+    m_pack_writer = new NotePackWriter(Glib::build_filename(m_new_revision_path, NotePack::FILE_NAME));
+  }
+  return *m_pack_writer;
+}
+
+
+bool FileSystemSyncServer::pack_notes()
+{
+  // Revisions, whose directories have notes as files or in a pack
+  std::set<int> note_revisions;
+  for(NoteRevisionMap::const_iterator iter = m_manifest.notes.begin(); iter != m_manifest.notes.end(); ++iter) {
+    int rev = iter->second.pack >= 0 ? iter->second.pack : iter->second.revision;
+    if(rev != m_new_revision) {
+      note_revisions.insert(rev);
+    }
+  }
+  if(note_revisions.size() <= MAX_NOTE_REVISIONS) {
+    return false;
+  }
+
+  DBG_OUT("Sync: Packing notes from %d revisions", int(note_revisions.size()));
+  gint64 start = g_get_monotonic_time();
+  NotePackWriter & writer = pack_writer();
+  std::map<int, shared_ptr<NotePackReader> > packs;
+  std::vector<std::string> packed;
+  for(NoteRevisionMap::const_iterator iter = m_manifest.notes.begin(); iter != m_manifest.notes.end(); ++iter) {
+    const NoteRevision & note = iter->second;
+    if(note.pack == m_new_revision || (note.pack < 0 && note.revision == m_new_revision)) {
+      continue;
+    }
+    std::string compressed;
+    guint32 size;
+    if(note.pack >= 0) {
+      shared_ptr<NotePackReader> & pack = packs[note.pack];
+      if(!pack) {
+        pack = shared_ptr<NotePackReader>(new NotePackReader(
+          Glib::build_filename(get_revision_dir_path(note.pack), NotePack::FILE_NAME)));
+      }
+      // compressed notes are copied as they are
+      compressed = pack->read_compressed(iter->first, size);
+    }
+    else {
+      std::string data = Glib::file_get_contents(
+        Glib::build_filename(get_revision_dir_path(note.revision), iter->first + ".note"));
+      size = data.size();
+      compressed = NotePack::compress(data);
+    }
+    writer.add(iter->first, compressed, size);
+    packed.push_back(iter->first);
+  }
+
+  // Only point to the new pack, when all notes are in it
+  FOREACH(const std::string & note_id, packed) {
+    m_manifest.notes[note_id].pack = m_new_revision;
+  }
+  DBG_OUT("Sync: Packed %d notes in %d ms", int(packed.size()), int((g_get_monotonic_time() - start) / 1000));
+  return true;
+}
+
+
+void FileSystemSyncServer::delete_unused_revisions()
+{
+  std::set<int> note_revisions;
+  for(NoteRevisionMap::const_iterator iter = m_manifest.notes.begin(); iter != m_manifest.notes.end(); ++iter) {
+    note_revisions.insert(iter->second.pack >= 0 ? iter->second.pack : iter->second.revision);
+  }
+
+  // Directories of older revisions are only needed for their notes
+  try {
+    std::list<std::string> parents;
+    sharp::directory_get_directories(m_server_path, parents);
+    FOREACH(const std::string & parent, parents) {
+      int parent_number;
+      if(!parse_revision(sharp::file_filename(parent), parent_number)) {
+        continue;
+      }
+      std::list<std::string> revisions;
+      sharp::directory_get_directories(parent, revisions);
+      size_t deleted = 0;
+      FOREACH(const std::string & revision_dir, revisions) {
+        int rev;
+        if(parse_revision(sharp::file_filename(revision_dir), rev)
+           && rev < m_new_revision && note_revisions.find(rev) == note_revisions.end()) {
+          sharp::directory_delete_recursive(revision_dir);
+          ++deleted;
+        }
+      }
+      if(deleted == revisions.size() && parent_number != m_new_revision / 100) {
+        std::list<std::string> files;
+        sharp::directory_get_files(parent, files);
+        if(files.empty()) {
+          sharp::directory_delete(parent, false);
+        }
+      }
+    }
+  }
+  catch(std::exception & e) {
+    ERR_OUT(_("Failed to delete old revisions from synchronization server: %s"), e.what());
+  }
+}
+
+
+void FileSystemSyncServer::repair_pack_references()
+{
+  // Older clients keep only id and rev of each note, find packed notes
+  // in the packs of their revision or of a later one
+  std::map<int, shared_ptr<NotePackReader> > packs;
+  try {
+    std::list<std::string> parents;
+    sharp::directory_get_directories(m_server_path, parents);
+    FOREACH(const std::string & parent, parents) {
+      int parent_number;
+      if(!parse_revision(sharp::file_filename(parent), parent_number)) {
+        continue;
+      }
+      std::list<std::string> revisions;
+      sharp::directory_get_directories(parent, revisions);
+      FOREACH(const std::string & revision_dir, revisions) {
+        int rev;
+        std::string pack_path = Glib::build_filename(revision_dir, NotePack::FILE_NAME);
+        if(parse_revision(sharp::file_filename(revision_dir), rev) && sharp::file_exists(pack_path)) {
+          packs[rev] = shared_ptr<NotePackReader>(new NotePackReader(pack_path));
+        }
+      }
+    }
+  }
+  catch(std::exception & e) {
+    ERR_OUT(_("Failed to read note packs from synchronization server: %s"), e.what());
+  }
+  if(packs.empty()) {
+    return;
+  }
+
+  for(NoteRevisionMap::iterator iter = m_manifest.notes.begin(); iter != m_manifest.notes.end(); ++iter) {
+    NoteRevision & note = iter->second;
+    if(note.pack >= 0 || sharp::file_exists(
+         Glib::build_filename(get_revision_dir_path(note.revision), iter->first + ".note"))) {
+      continue;
+    }
+    // A pack of an older revision has an older version of the note
+    for(std::map<int, shared_ptr<NotePackReader> >::iterator pack = packs.lower_bound(note.revision);
+        pack != packs.end(); ++pack) {
+      if(pack->second->contains(iter->first)) {
+        note.pack = pack->first;
+        break;
+      }
+    }
+  }
+}
+
+
 void FileSystemSyncServer::update_lock_file(const SyncLockInfo & syncLockInfo)
 {
   sharp::XmlWriter xml(m_lock_path);
@@ -581,7 +866,7 @@ void FileSystemSyncServer::cleanup_old_sync(const SyncLockInfo &)
 {
   DBG_OUT("Sync: Cleaning up a previous failed sync transaction");
   int rev = latest_revision();
-  if(rev >= 0 && !is_valid_xml_file(m_manifest_path)) {
+  if(rev >= 0 && !manifest().valid) {
     // Time to discover the latest valid revision
     // If no manifest.xml file exists, that means we've got to
     // figure out if there are any previous revisions with valid
@@ -611,6 +896,105 @@ void FileSystemSyncServer::cleanup_old_sync(const SyncLockInfo &)
 }
 
 
+const FileSystemSyncServer::Manifest & FileSystemSyncServer::manifest()
+{
+  if(m_manifest.loaded) {
+    return m_manifest;
+  }
+
+  // TODO: Permission errors
+  m_manifest = Manifest();
+  if(!sharp::file_exists(m_manifest_path)) {
+    return m_manifest;
+  }
+  m_manifest.loaded = true;
+  m_manifest.valid = read_manifest(m_manifest_path, m_manifest);
+  if(!m_manifest.valid) {
+    m_manifest.revision = -1;
+    m_manifest.server_id = "";
+    m_manifest.notes.clear();
+  }
+  else if(m_manifest.format < MANIFEST_FORMAT) {
+    repair_pack_references();
+  }
+  return m_manifest;
+}
+
+
+bool FileSystemSyncServer::read_manifest(const std::string & path, Manifest & manifest)
+{
+  xmlTextReaderPtr reader = xmlReaderForFile(path.c_str(), "UTF-8", 0);
+  if(!reader) {
+    return false;
+  }
+
+  // Reading the whole file also checks, that it is well-formed
+  int res;
+  while((res = xmlTextReaderRead(reader)) == 1) {
+    if(xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+      continue;
+    }
+    const char *name = reinterpret_cast<const char*>(xmlTextReaderConstName(reader));
+    if(strcmp(name, "note") == 0) {
+      std::string id = get_attribute(reader, "id");
+      if(id != "") {
+        NoteRevision & note = manifest.notes[id];
+        note.revision = str_to_int(get_attribute(reader, "rev"));
+        note.hash = get_attribute(reader, "hash");
+        std::string pack = get_attribute(reader, "pack");
+        note.pack = pack != "" ? str_to_int(pack) : -1;
+      }
+    }
+    else if(strcmp(name, "sync") == 0 && xmlTextReaderDepth(reader) == 0) {
+      std::string revision = get_attribute(reader, "revision");
+      if(revision != "") {
+        manifest.revision = str_to_int(revision);
+      }
+      std::string format = get_attribute(reader, "format");
+      manifest.format = format != "" ? str_to_int(format) : 1;
+      manifest.server_id = get_attribute(reader, "server-id");
+    }
+  }
+  xmlFreeTextReader(reader);
+
+  return res == 0;
+}
+
+
+void FileSystemSyncServer::write_manifest(const std::string & path, const Manifest & manifest)
+{
+  sharp::XmlWriter xml(path);
+  try {
+    xml.write_start_document();
+    xml.write_start_element("", "sync", "");
+    xml.write_attribute_string("", "revision", "", TO_STRING(manifest.revision));
+    xml.write_attribute_string("", "server-id", "", manifest.server_id);
+    xml.write_attribute_string("", "format", "", TO_STRING(MANIFEST_FORMAT));
+
+    for(NoteRevisionMap::const_iterator iter = manifest.notes.begin(); iter != manifest.notes.end(); ++iter) {
+      xml.write_start_element("", "note", "");
+      xml.write_attribute_string("", "id", "", iter->first);
+      xml.write_attribute_string("", "rev", "", TO_STRING(iter->second.revision));
+      if(!iter->second.hash.empty()) {
+        xml.write_attribute_string("", "hash", "", iter->second.hash);
+      }
+      if(iter->second.pack >= 0) {
+        xml.write_attribute_string("", "pack", "", TO_STRING(iter->second.pack));
+      }
+      xml.write_end_element();
+    }
+
+    xml.write_end_element();
+    xml.write_end_document();
+    xml.close();
+  }
+  catch(...) {
+    xml.close();
+    throw;
+  }
+}
+
+
 bool FileSystemSyncServer::is_valid_xml_file(const std::string & xmlFilePath)
 {
   // Check that file exists
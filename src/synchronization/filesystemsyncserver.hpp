@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2012-2013 Aurimas Cernius
+ * Copyright (C) 2012-2014 Aurimas Cernius
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -30,12 +30,15 @@
 namespace gnote {
 namespace sync {
 
+class NotePackWriter;
+
 
 class FileSystemSyncServer
   : public SyncServer
 {
 public:
   static SyncServer::Ptr create(const std::string & path);
+  virtual ~FileSystemSyncServer();
   virtual bool begin_sync_transaction() override;
   virtual bool commit_sync_transaction() override;
   virtual bool cancel_sync_transaction() override;
@@ -43,29 +46,119 @@ public:
   virtual std::map<std::string, NoteUpdate> get_note_updates_since(int revision) override;
   virtual void delete_notes(const std::list<std::string> & deletedNoteUUIDs) override;
   virtual void upload_notes(const std::list<Note::Ptr> & notes) override;
+  /** Path of note file -> NoteHash of the note, can be empty. */
+  typedef std::map<std::string, std::string> NoteFileMap;
+  /** Upload the note files in %note_files, the way upload_notes() does. */
+  void upload_note_files(const NoteFileMap & note_files);
   virtual int latest_revision() override; // NOTE: Only reliable during a transaction
   virtual SyncLockInfo current_sync_lock() override;
   virtual std::string id() override;
   virtual bool updates_available_since(int revision) override;
+
+  /** Number of notes copied or read at the same time. */
+  unsigned transfer_threads() const
+    {
+      return m_transfer_threads;
+    }
+  void set_transfer_threads(unsigned threads)
+    {
+      m_transfer_threads = threads;
+    }
+  /**
+   * Whether notes are uploaded to a compressed pack in the revision
+   * directory instead of a file per note. Notes in either layout are
+   * read, but clients of older versions can not read packed notes.
+   */
+  bool use_packs() const
+    {
+      return m_use_packs;
+    }
+  void set_use_packs(bool use_packs)
+    {
+      m_use_packs = use_packs;
+    }
 private:
+  /** Every this many revisions, directories of revisions without notes are removed. */
+  static const int COMPACT_INTERVAL;
+  /** More revision directories with notes than this are packed into one. */
+  static const size_t MAX_NOTE_REVISIONS;
+  /** Version of manifest.xml, older clients write it without pack attributes. */
+  static const int MANIFEST_FORMAT;
+
+  typedef unordered_map<std::string, std::string> NoteHashMap;
+  typedef unordered_set<std::string> NoteIdSet;
+
+  struct NoteRevision
+  {
+    NoteRevision()
+      : revision(0)
+      , pack(-1)
+      {}
+
+    int revision;
+    // NoteHash of the note, empty if written by a client, that did not publish it
+    std::string hash;
+    // revision, that has the note in its pack, -1 if the note is a file
+    // in the directory of its own revision
+    int pack;
+  };
+  typedef unordered_map<std::string, NoteRevision> NoteRevisionMap;
+
+  /**
+   * Contents of manifest.xml. The file is parsed once per transaction,
+   * after the lock is taken, and the model is updated on commit.
+   */
+  struct Manifest
+  {
+    Manifest()
+      : loaded(false)
+      , valid(false)
+      , revision(-1)
+      , format(MANIFEST_FORMAT)
+      {}
+
+    bool loaded;
+    // false if the file is missing or is not well-formed XML
+    bool valid;
+    int revision;
+    // lower than MANIFEST_FORMAT, if the last commit was made by an older client
+    int format;
+    std::string server_id;
+    // note id -> revision, the note was last changed in, and its hash
+    NoteRevisionMap notes;
+  };
+
   explicit FileSystemSyncServer(const std::string & path);
 
+  const Manifest & manifest();
+  static bool read_manifest(const std::string & path, Manifest & manifest);
+  static void write_manifest(const std::string & path, const Manifest & manifest);
+  void repair_pack_references();
   std::string get_revision_dir_path(int rev);
+  NotePackWriter & pack_writer();
+  bool pack_notes();
+  void delete_unused_revisions();
   void cleanup_old_sync(const SyncLockInfo & syncLockInfo);
   void update_lock_file(const SyncLockInfo & syncLockInfo);
   bool is_valid_xml_file(const std::string & xmlFilePath);
   void lock_timeout();
 
-  std::list<std::string> m_updated_notes;
-  std::list<std::string> m_deleted_notes;
+  // note id -> hash of the uploaded note
+  NoteHashMap m_updated_notes;
+  NoteIdSet m_deleted_notes;
+  // uploaded notes, that are in the pack of the new revision
+  NoteIdSet m_packed_notes;
+  NotePackWriter *m_pack_writer;
 
   std::string m_server_id;
 
   std::string m_server_path;
-  std::string m_cache_path;
   std::string m_lock_path;
   std::string m_manifest_path;
+  Manifest m_manifest;
 
+  unsigned m_transfer_threads;
+  bool m_use_packs;
   int m_new_revision;
   std::string m_new_revision_path;
 
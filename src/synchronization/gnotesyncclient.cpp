@@ -27,6 +27,7 @@
 #include "debug.hpp"
 #include "ignote.hpp"
 #include "gnotesyncclient.hpp"
+#include "notehash.hpp"
 #include "notemanager.hpp"
 #include "sharp/files.hpp"
 #include "sharp/xmlreader.hpp"
@@ -60,6 +61,7 @@ namespace sync {
   {
     m_deleted_notes[deletedNote->id()] = deletedNote->get_title();
     m_file_revisions.erase(deletedNote->id());
+    m_file_hashes.erase(deletedNote->id());
 
     write(m_local_manifest_file_path);
   }
@@ -74,7 +76,7 @@ namespace sync {
 
   void GnoteSyncClient::read_updated_note_atts(sharp::XmlReader & reader)
   {
-    std::string guid, rev;
+    std::string guid, rev, hash;
     while(reader.move_to_next_attribute()) {
       if(reader.get_name() == "guid") {
 	guid = reader.get_value();
@@ -82,6 +84,9 @@ namespace sync {
       else if(reader.get_name() == "latest-revision") {
 	rev = reader.get_value();
       }
+      else if(reader.get_name() == "content-hash") {
+	hash = reader.get_value();
+      }
     }
     int revision = -1;
     try {
@@ -90,6 +95,9 @@ namespace sync {
     catch(...) {}
     if(guid != "") {
       m_file_revisions[guid] = revision;
+      if(hash != "") {
+        m_file_hashes[guid] = hash;
+      }
     }
   }
 
@@ -133,6 +141,7 @@ namespace sync {
     m_last_sync_date = sharp::DateTime::now().add_days(-1);
     m_last_sync_rev = -1;
     m_file_revisions.clear();
+    m_file_hashes.clear();
     m_deleted_notes.clear();
     m_server_id = "";
 
@@ -205,6 +214,10 @@ namespace sync {
 	xml.write_start_element("", "note", "");
 	xml.write_attribute_string("", "guid", "", noteGuid->first);
 	xml.write_attribute_string("", "latest-revision", "", TO_STRING(noteGuid->second));
+	std::map<std::string, std::string>::iterator hash = m_file_hashes.find(noteGuid->first);
+	if(hash != m_file_hashes.end()) {
+	  xml.write_attribute_string("", "content-hash", "", hash->second);
+	}
 	xml.write_end_element();
       }
 
@@ -264,11 +277,22 @@ namespace sync {
   void GnoteSyncClient::set_revision(const Note::Ptr & note, int revision)
   {
     m_file_revisions[note->id()] = revision;
+    m_file_hashes[note->id()] = NoteHash::note_hash(note);
     // TODO: Should we write on each of these or no?
     write(m_local_manifest_file_path);
   }
 
 
+  std::string GnoteSyncClient::get_content_hash(const Note::Ptr & note)
+  {
+    std::map<std::string, std::string>::const_iterator iter = m_file_hashes.find(note->id());
+    if(iter != m_file_hashes.end()) {
+      return iter->second;
+    }
+    return "";
+  }
+
+
   void GnoteSyncClient::reset()
   {
     if(sharp::file_exists(m_local_manifest_file_path)) {
@@ -46,6 +46,7 @@ namespace sync {
     virtual void last_synchronized_revision(int) override;
     virtual int get_revision(const Note::Ptr & note) override;
     virtual void set_revision(const Note::Ptr & note, int revision) override;
+    virtual std::string get_content_hash(const Note::Ptr & note) override;
     virtual std::map<std::string, std::string> deleted_note_titles() override
       {
         return m_deleted_notes;
@@ -74,6 +75,7 @@ namespace sync {
     std::string m_server_id;
     std::string m_local_manifest_file_path;
     std::map<std::string, int> m_file_revisions;
+    std::map<std::string, std::string> m_file_hashes;
     std::map<std::string, std::string> m_deleted_notes;
   };
 
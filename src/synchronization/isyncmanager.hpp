@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2012-2013 Aurimas Cernius
+ * Copyright (C) 2012-2014 Aurimas Cernius
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -57,7 +57,10 @@ public:
   virtual sharp::DateTime last_sync_date() = 0;
   virtual void last_sync_date(const sharp::DateTime &) = 0;
   virtual int get_revision(const Note::Ptr & note) = 0;
+  /** Record the revision of %note, that is on the server now, with the note hash. */
   virtual void set_revision(const Note::Ptr & note, int revision) = 0;
+  /** NoteHash of %note, when its revision was last set, empty if unknown. */
+  virtual std::string get_content_hash(const Note::Ptr & note) = 0;
   virtual std::map<std::string, std::string> deleted_note_titles() = 0;
   virtual void reset() = 0;
   virtual std::string associated_server_id() = 0;
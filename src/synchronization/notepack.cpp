@@ -0,0 +1,280 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <gio/gio.h>
+
+#include "notepack.hpp"
+
+
+namespace gnote {
+namespace sync {
+
+namespace {
+
+const char PACK_MAGIC[8] = { 'g', 'n', 'o', 't', 'e', '-', 'p', 'k' };
+// index offset, note count and magic
+const size_t TRAILER_SIZE = 8 + 4 + sizeof(PACK_MAGIC);
+// deflate can not compress better than about 1032:1
+const guint64 MAX_COMPRESSION_RATIO = 1032;
+
+void put_uint(std::string & out, guint64 value, int bytes)
+{
+  for(int i = 0; i < bytes; ++i) {
+    out += char((value >> (8 * i)) & 0xff);
+  }
+}
+
+guint64 get_uint(const std::string & in, size_t & pos, int bytes)
+{
+  if(pos + bytes > in.size()) {
+    throw std::runtime_error("Truncated note pack");
+  }
+  guint64 value = 0;
+  for(int i = 0; i < bytes; ++i) {
+    value |= guint64(guchar(in[pos + i])) << (8 * i);
+  }
+  pos += bytes;
+  return value;
+}
+
+std::string convert(GConverter *converter, const std::string & input, size_t output_size)
+{
+  std::string output(std::max<size_t>(output_size, 64), '\0');
+  gsize input_pos = 0;
+  gsize output_pos = 0;
+  while(true) {
+    gsize bytes_read = 0;
+    gsize bytes_written = 0;
+    GError *error = NULL;
+    GConverterResult result = g_converter_convert(converter,
+      input.data() + input_pos, input.size() - input_pos,
+      &output[output_pos], output.size() - output_pos,
+      G_CONVERTER_INPUT_AT_END, &bytes_read, &bytes_written, &error);
+    if(result == G_CONVERTER_ERROR) {
+      if(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NO_SPACE)) {
+        g_error_free(error);
+        output.resize(output.size() * 2);
+        continue;
+      }
+      std::string message = error->message;
+      g_error_free(error);
+      throw std::runtime_error(message);
+    }
+    input_pos += bytes_read;
+    output_pos += bytes_written;
+    if(result == G_CONVERTER_FINISHED) {
+      break;
+    }
+    if(output_pos == output.size()) {
+      output.resize(output.size() * 2);
+    }
+  }
+  output.resize(output_pos);
+  return output;
+}
+
+}
+
+
+const char *NotePack::FILE_NAME = "notes.pack";
+
+
+std::string NotePack::compress(const std::string & data)
+{
+  GZlibCompressor *compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, -1);
+  try {
+    std::string result = convert(G_CONVERTER(compressor), data, data.size() / 2);
+    g_object_unref(compressor);
+    return result;
+  }
+  catch(...) {
+    g_object_unref(compressor);
+    throw;
+  }
+}
+
+
+std::string NotePack::decompress(const std::string & data, guint32 size)
+{
+  // the size is only read from the pack, do not allocate what the data can not hold
+  if(size > (data.size() + 64) * MAX_COMPRESSION_RATIO) {
+    throw std::runtime_error("Note pack entry has wrong size");
+  }
+  GZlibDecompressor *decompressor = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+  try {
+    std::string result = convert(G_CONVERTER(decompressor), data, size);
+    g_object_unref(decompressor);
+    if(result.size() != size) {
+      throw std::runtime_error("Note pack entry has wrong size");
+    }
+    return result;
+  }
+  catch(...) {
+    g_object_unref(decompressor);
+    throw;
+  }
+}
+
+
+NotePackWriter::NotePackWriter(const std::string & path)
+  : m_path(path)
+  , m_file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc)
+  , m_offset(sizeof(PACK_MAGIC))
+{
+  if(!m_file) {
+    throw std::runtime_error("Failed to create note pack " + path);
+  }
+  m_file.write(PACK_MAGIC, sizeof(PACK_MAGIC));
+}
+
+
+void NotePackWriter::add(const std::string & id, const std::string & compressed, guint32 size)
+{
+  NotePack::Entry & entry = m_index[id];
+  entry.offset = m_offset;
+  entry.compressed_size = compressed.size();
+  entry.size = size;
+  m_file.write(compressed.data(), compressed.size());
+  m_offset += compressed.size();
+}
+
+
+void NotePackWriter::close()
+{
+  std::string index;
+  for(std::map<std::string, NotePack::Entry>::iterator iter = m_index.begin(); iter != m_index.end(); ++iter) {
+    put_uint(index, iter->first.size(), 4);
+    index += iter->first;
+    put_uint(index, iter->second.offset, 8);
+    put_uint(index, iter->second.compressed_size, 4);
+    put_uint(index, iter->second.size, 4);
+  }
+  put_uint(index, m_offset, 8);
+  put_uint(index, m_index.size(), 4);
+  index.append(PACK_MAGIC, sizeof(PACK_MAGIC));
+  m_file.write(index.data(), index.size());
+  m_file.close();
+  if(m_file.fail()) {
+    throw std::runtime_error("Failed to write note pack " + m_path);
+  }
+}
+
+
+NotePackReader::NotePackReader(const std::string & path)
+  : m_path(path)
+{
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if(!file) {
+    throw std::runtime_error("Failed to open note pack " + path);
+  }
+  file.seekg(0, std::ios::end);
+  guint64 file_size = file.tellg();
+  if(file_size < sizeof(PACK_MAGIC) + TRAILER_SIZE) {
+    throw std::runtime_error("Invalid note pack " + path);
+  }
+
+  std::string trailer(TRAILER_SIZE, '\0');
+  file.seekg(file_size - TRAILER_SIZE);
+  file.read(&trailer[0], TRAILER_SIZE);
+  size_t pos = 0;
+  guint64 index_offset = get_uint(trailer, pos, 8);
+  guint32 count = get_uint(trailer, pos, 4);
+  if(!file || memcmp(trailer.data() + pos, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0
+     || index_offset < sizeof(PACK_MAGIC) || index_offset > file_size - TRAILER_SIZE) {
+    throw std::runtime_error("Invalid note pack " + path);
+  }
+
+  std::string index(file_size - TRAILER_SIZE - index_offset, '\0');
+  file.seekg(index_offset);
+  if(!index.empty()) {
+    file.read(&index[0], index.size());
+  }
+  if(!file) {
+    throw std::runtime_error("Failed to read note pack " + path);
+  }
+  pos = 0;
+  for(guint32 i = 0; i < count; ++i) {
+    guint32 id_size = get_uint(index, pos, 4);
+    if(pos + id_size > index.size()) {
+      throw std::runtime_error("Invalid note pack " + path);
+    }
+    std::string id = index.substr(pos, id_size);
+    pos += id_size;
+    NotePack::Entry & entry = m_index[id];
+    entry.offset = get_uint(index, pos, 8);
+    entry.compressed_size = get_uint(index, pos, 4);
+    entry.size = get_uint(index, pos, 4);
+    if(entry.offset < sizeof(PACK_MAGIC) || entry.offset + entry.compressed_size > index_offset) {
+      throw std::runtime_error("Invalid note pack " + path);
+    }
+  }
+}
+
+
+const NotePack::Entry & NotePackReader::entry(const std::string & id) const
+{
+  std::map<std::string, NotePack::Entry>::const_iterator iter = m_index.find(id);
+  if(iter == m_index.end()) {
+    throw std::runtime_error("Note " + id + " not found in " + m_path);
+  }
+  return iter->second;
+}
+
+
+std::string NotePackReader::read_compressed(const std::string & id, guint32 & size) const
+{
+  const NotePack::Entry & note = entry(id);
+  std::ifstream file(m_path.c_str(), std::ios::in | std::ios::binary);
+  std::string data(note.compressed_size, '\0');
+  file.seekg(note.offset);
+  if(!data.empty()) {
+    file.read(&data[0], data.size());
+  }
+  if(!file) {
+    throw std::runtime_error("Failed to read note " + id + " from " + m_path);
+  }
+  size = note.size;
+  return data;
+}
+
+
+std::string NotePackReader::read(const std::string & id) const
+{
+  guint32 size;
+  std::string data = read_compressed(id, size);
+  return NotePack::decompress(data, size);
+}
+
+
+void NotePackReader::get_ids(std::vector<std::string> & ids) const
+{
+  ids.clear();
+  for(std::map<std::string, NotePack::Entry>::const_iterator iter = m_index.begin(); iter != m_index.end(); ++iter) {
+    ids.push_back(iter->first);
+  }
+}
+
+}
+}
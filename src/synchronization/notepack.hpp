@@ -0,0 +1,119 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SYNCHRONIZATION_NOTEPACK_HPP_
+#define _SYNCHRONIZATION_NOTEPACK_HPP_
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glib.h>
+
+
+namespace gnote {
+namespace sync {
+
+/**
+ * Pack of compressed notes in a single file, written once and read by
+ * note id. The file is:
+ *   magic
+ *   notes, each compressed with zlib, back to back
+ *   index: per note id length (4 bytes), id, offset (8), compressed size (4), size (4)
+ *   index offset (8), note count (4), magic
+ * Numbers are little endian.
+ */
+class NotePack
+{
+public:
+  static const char *FILE_NAME;
+
+  struct Entry
+  {
+    guint64 offset;
+    guint32 compressed_size;
+    guint32 size;
+  };
+
+  static std::string compress(const std::string & data);
+  static std::string decompress(const std::string & data, guint32 size);
+};
+
+
+/** Writes a note pack, notes are appended and the index is written at the end. */
+class NotePackWriter
+{
+public:
+  /** Create the pack at %path, throws std::runtime_error on failure. */
+  explicit NotePackWriter(const std::string & path);
+
+  /** Append a note compressed with NotePack::compress(), %size is the size before compression. */
+  void add(const std::string & id, const std::string & compressed, guint32 size);
+  /** Write the index. The pack is not readable before this. */
+  void close();
+
+  const std::string & path() const
+    {
+      return m_path;
+    }
+  size_t size() const
+    {
+      return m_index.size();
+    }
+private:
+  std::string m_path;
+  std::ofstream m_file;
+  guint64 m_offset;
+  // a note added twice is read from its last copy
+  std::map<std::string, NotePack::Entry> m_index;
+};
+
+
+/**
+ * Reads notes from a pack. The index is read once, notes are read from
+ * the file on every call, so several threads can read at the same time.
+ */
+class NotePackReader
+{
+public:
+  /** Read the index of the pack at %path, throws std::runtime_error, if it is not valid. */
+  explicit NotePackReader(const std::string & path);
+
+  bool contains(const std::string & id) const
+    {
+      return m_index.find(id) != m_index.end();
+    }
+  /** Contents of note %id, throws std::runtime_error, if it can not be read. */
+  std::string read(const std::string & id) const;
+  /** Compressed contents of note %id and its size before compression. */
+  std::string read_compressed(const std::string & id, guint32 & size) const;
+  void get_ids(std::vector<std::string> & ids) const;
+private:
+  const NotePack::Entry & entry(const std::string & id) const;
+
+  std::string m_path;
+  std::map<std::string, NotePack::Entry> m_index;
+};
+
+}
+}
+
+#endif
@@ -31,7 +31,9 @@
 #include "filesystemsyncserver.hpp"
 #include "ignote.hpp"
 #include "gnotesyncclient.hpp"
+#include "notehash.hpp"
 #include "notemanager.hpp"
+#include "notesavequeue.hpp"
 #include "preferences.hpp"
 #include "silentui.hpp"
 #include "syncmanager.hpp"
@@ -42,6 +44,36 @@
 namespace gnote {
 namespace sync {
 
+  namespace {
+
+    // Logs the time taken by each phase of a synchronization
+    class PhaseTimer
+    {
+    public:
+      PhaseTimer()
+        : m_start(g_get_monotonic_time())
+        , m_phase_start(m_start)
+      {}
+
+      void phase_done(const char *phase)
+      {
+        gint64 now = g_get_monotonic_time();
+        DBG_OUT("Sync: %s took %d ms", phase, int((now - m_phase_start) / 1000));
+        m_phase_start = now;
+      }
+
+      int total_ms() const
+      {
+        return int((g_get_monotonic_time() - m_start) / 1000);
+      }
+    private:
+      gint64 m_start;
+      gint64 m_phase_start;
+    };
+
+  }
+
+
   SyncManager::SyncManager(NoteManager & m)
     : m_note_manager(m)
     , m_state(IDLE)
@@ -158,6 +190,7 @@ namespace sync {
       //       For now, only saving before uploading (not sufficient for note conflict handling)
 
       set_state(ACQUIRING_LOCK);
+      PhaseTimer timer;
       // TODO: We should really throw exceptions from BeginSyncTransaction ()
       if(!server->begin_sync_transaction()) {
         set_state(LOCKED);
@@ -167,7 +200,7 @@ namespace sync {
         f.addin->post_sync_cleanup();
         return;
       }
-      DBG_OUT("8");
+      timer.phase_done("Acquiring lock");
       int latestServerRevision = server->latest_revision();
       int newRevision = latestServerRevision + 1;
 
@@ -187,6 +220,7 @@ namespace sync {
       DBG_OUT("Sync: GetNoteUpdatesSince rev %d", m_client->last_synchronized_revision());
       std::map<std::string, NoteUpdate> noteUpdates = server->get_note_updates_since(m_client->last_synchronized_revision());
       DBG_OUT("Sync: %d updates since rev %d", int(noteUpdates.size()), m_client->last_synchronized_revision());
+      timer.phase_done("Downloading updates");
 
       // Gather list of new/updated note titles
       // for title conflict handling purposes.
@@ -239,7 +273,7 @@ namespace sync {
           }
           create_note_in_main_thread(iter->second);
         }
-        else if(existingNote->metadata_change_date() <= m_client->last_sync_date()
+        else if(!is_changed_since_sync(static_pointer_cast<Note>(existingNote))
                 || iter->second.basically_equal_to(static_pointer_cast<Note>(existingNote))) {
           // Existing note hasn't been modified since last sync; simply update it from server
           update_note_in_main_thread(static_pointer_cast<Note>(existingNote), iter->second);
@@ -267,6 +301,7 @@ namespace sync {
       // and then rethrown in the synchronization thread.
       utils::main_context_call(boost::bind(
         sigc::mem_fun(*this, &SyncManager::delete_notes), server));
+      timer.phase_done("Applying server changes");
 
       // TODO: Add following updates to syncDialog treeview
 
@@ -286,7 +321,7 @@ namespace sync {
             m_sync_ui->note_synchronized_th(note->get_title(), UPLOAD_NEW);
         }
         else if(m_client->get_revision(note) <= m_client->last_synchronized_revision()
-                && note->metadata_change_date() > m_client->last_sync_date()) {
+                && is_changed_since_sync(note)) {
           note_save(note);
           newOrModifiedNotes.push_back(note);
           if(m_sync_ui != 0) {
@@ -297,9 +332,12 @@ namespace sync {
 
       DBG_OUT("Sync: Uploading %d note updates", int(newOrModifiedNotes.size()));
       if(newOrModifiedNotes.size() > 0) {
+        // Note files are copied to the server, they have to be written first
+        note_mgr().save_queue().flush();
         set_state(UPLOADING);
         server->upload_notes(newOrModifiedNotes); // TODO: Callbacks to update GUI as upload progresses
       }
+      timer.phase_done("Uploading notes");
 
       // Handle notes deleted on client
       std::list<std::string> locallyDeletedUUIDs;
@@ -322,9 +360,11 @@ namespace sync {
         set_state(DELETE_SERVER_NOTES);
         server->delete_notes(locallyDeletedUUIDs);
       }
+      timer.phase_done("Finding deleted notes");
 
       set_state(COMMITTING_CHANGES);
       bool commitResult = server->commit_sync_transaction();
+      timer.phase_done("Committing");
       if(commitResult) {
         // Apply this revision number to all new/modified notes since last sync
         // TODO: Is this the best place to do this (after successful server commit)
@@ -344,7 +384,7 @@ namespace sync {
 
       m_client->last_sync_date(sharp::DateTime::now());
 
-      DBG_OUT("Sync: New revision: %d", m_client->last_synchronized_revision());
+      DBG_OUT("Sync: New revision: %d, synchronized in %d ms", m_client->last_synchronized_revision(), timer.total_ms());
 
       set_state(IDLE);
 
@@ -471,7 +511,7 @@ namespace sync {
       if(!client_has_updates) {
         FOREACH(const NoteBase::Ptr & iter, note_mgr().get_notes()) {
           Note::Ptr note = static_pointer_cast<Note>(iter);
-          if(m_client->get_revision(note) == -1 || note->metadata_change_date() > m_client->last_sync_date()) {
+          if(m_client->get_revision(note) == -1 || is_changed_since_sync(note)) {
             client_has_updates = true;
             break;
           }
@@ -605,6 +645,17 @@ namespace sync {
   }
 
 
+  bool SyncManager::is_changed_since_sync(const Note::Ptr & note)
+  {
+    if(note->metadata_change_date() <= m_client->last_sync_date()) {
+      return false;
+    }
+    // Touched since, compare the contents, if they were recorded
+    std::string synchronized_hash = m_client->get_content_hash(note);
+    return synchronized_hash.empty() || synchronized_hash != NoteHash::note_hash(note);
+  }
+
+
   NoteManager & SyncManager::note_mgr()
   {
     return m_note_manager;
@@ -70,6 +70,7 @@ namespace sync {
     void delete_note_in_main_thread(const Note::Ptr & existingNote);
     void update_local_note(const NoteBase::Ptr & localNote, const NoteUpdate & serverNote, NoteSyncType syncType);
     NoteBase::Ptr find_note_by_uuid(const std::string & uuid);
+    bool is_changed_since_sync(const Note::Ptr & note);
     NoteManager & note_mgr();
     void get_synchronized_xml_bits(const std::string & noteXml, std::string & title, std::string & tags, std::string & content);
     void delete_notes(const SyncServer::Ptr & server);
@@ -26,6 +26,7 @@
 #include <glibmm/i18n.h>
 
 #include "debug.hpp"
+#include "notehash.hpp"
 #include "syncutils.hpp"
 #include "utils.hpp"
 #include "sharp/files.hpp"
@@ -36,15 +37,19 @@
 namespace gnote {
 namespace sync {
 
-  NoteUpdate::NoteUpdate(const std::string & xml_content, const std::string & title, const std::string & uuid, int latest_revision)
+  NoteUpdate::NoteUpdate(const std::string & xml_content, const std::string & title, const std::string & uuid, int latest_revision,
+                         const std::string & content_hash)
   {
     m_xml_content = xml_content;
     m_title = title;
     m_uuid = uuid;
     m_latest_revision = latest_revision;
+    m_content_hash = content_hash;
 
     // TODO: Clean this up (and remove title parameter?)
     if(m_xml_content.length() > 0) {
+      std::string text;
+      std::vector<std::string> tags;
       sharp::XmlReader xml;
       xml.load_buffer(m_xml_content);
       //xml.Namespaces = false;
@@ -54,56 +59,28 @@ namespace sync {
           if(xml.get_name() == "title") {
             m_title = xml.read_string();
           }
+          else if(m_content_hash.empty()) {
+            if(xml.get_name() == "text") {
+              text = xml.read_inner_xml();
+            }
+            else if(xml.get_name() == "tag") {
+              tags.push_back(xml.read_string());
+            }
+          }
         }
       }
-    }
-  }
-
-
-  bool NoteUpdate::basically_equal_to(const Note::Ptr & existing_note)
-  {
-    // NOTE: This would be so much easier if NoteUpdate
-    //       was not just a container for a big XML string
-    sharp::XmlReader xml;
-    xml.load_buffer(m_xml_content);
-    NoteData *data = new NoteData(m_uuid);
-    NoteArchiver::obj().read(xml, *data);
-    std::auto_ptr<NoteData> update_data(data);
-    xml.close();
-
-    // NOTE: Mostly a hack to ignore missing version attributes
-    std::string existing_inner_content = get_inner_content(existing_note->data().text());
-    std::string update_inner_content = get_inner_content(update_data->text());
-
-    return existing_inner_content == update_inner_content &&
-           existing_note->data().title() == update_data->title() &&
-           compare_tags(existing_note->data().tags(), update_data->tags());
-           // TODO: Compare open-on-startup, pinned
-  }
-
 
-  std::string NoteUpdate::get_inner_content(const std::string & full_content_element) const
-  {
-    sharp::XmlReader xml;
-    xml.load_buffer(full_content_element);
-    if(xml.read() && xml.get_name() == "note-content") {
-      return xml.read_inner_xml();
+      if(m_content_hash.empty()) {
+        m_content_hash = NoteHash::note_hash(m_title, NoteHash::content_hash(text), tags);
+      }
     }
-    return "";
   }
 
 
-  bool NoteUpdate::compare_tags(const std::map<std::string, Tag::Ptr> set1, const std::map<std::string, Tag::Ptr> set2) const
+  bool NoteUpdate::basically_equal_to(const Note::Ptr & existing_note)
   {
-    if(set1.size() != set2.size()) {
-      return false;
-    }
-    for(std::map<std::string, Tag::Ptr>::const_iterator iter = set1.begin(); iter != set1.end(); ++iter) {
-      if(set2.find(iter->first) == set2.end()) {
-        return false;
-      }
-    }
-    return true;
+    // Title, contents and tags are compared through their hashes
+    return m_content_hash == NoteHash::note_hash(existing_note);
   }
 
 
@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2012-2013 Aurimas Cernius
+ * Copyright (C) 2012-2014 Aurimas Cernius
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -73,12 +73,12 @@ namespace sync {
     std::string m_title;
     std::string m_uuid; //needed?
     int m_latest_revision;
+    // NoteHash of the note, computed from the XML, if not given
+    std::string m_content_hash;
 
-    NoteUpdate(const std::string & xml_content, const std::string & title, const std::string & uuid, int latest_revision);
+    NoteUpdate(const std::string & xml_content, const std::string & title, const std::string & uuid, int latest_revision,
+               const std::string & content_hash = "");
     bool basically_equal_to(const Note::Ptr & existing_note);
-  private:
-    std::string get_inner_content(const std::string & full_content_element) const;
-    bool compare_tags(const std::map<std::string, Tag::Ptr> set1, const std::map<std::string, Tag::Ptr> set2) const;
   };
 
 
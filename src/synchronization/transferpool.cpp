@@ -0,0 +1,124 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <glibmm/exception.h>
+
+#include "base/macros.hpp"
+#include "transferpool.hpp"
+
+
+namespace gnote {
+namespace sync {
+
+const unsigned TransferPool::MAX_THREADS = 32;
+
+
+TransferPool::TransferPool(unsigned thread_count)
+  : m_thread_count(std::max(1u, std::min(thread_count, MAX_THREADS)))
+  , m_count(0)
+  , m_next(0)
+{
+}
+
+
+void TransferPool::run(size_t count, const Job & job)
+{
+  m_job = job;
+  m_count = count;
+  m_next = 0;
+  m_error.clear();
+
+  size_t thread_count = std::min(size_t(m_thread_count), count);
+  if(thread_count <= 1) {
+    work();
+  }
+  else {
+    std::vector<Glib::Threads::Thread*> threads;
+    try {
+      for(size_t i = 0; i < thread_count; ++i) {
+        threads.push_back(Glib::Threads::Thread::create(sigc::mem_fun(*this, &TransferPool::work)));
+      }
+    }
+    catch(...) {
+      // Threads already started stop after the items they are at
+      {
+        Glib::Threads::Mutex::Lock lock(m_mutex);
+        m_next = m_count;
+      }
+      FOREACH(Glib::Threads::Thread *thread, threads) {
+        thread->join();
+      }
+      m_job = Job();
+      throw;
+    }
+    FOREACH(Glib::Threads::Thread *thread, threads) {
+      thread->join();
+    }
+  }
+
+  m_job = Job();
+  if(!m_error.empty()) {
+    throw std::runtime_error(m_error);
+  }
+}
+
+
+void TransferPool::work()
+{
+  while(true) {
+    size_t item;
+    {
+      Glib::Threads::Mutex::Lock lock(m_mutex);
+      if(m_next == m_count || !m_error.empty()) {
+        return;
+      }
+      item = m_next++;
+    }
+
+    std::string error;
+    try {
+      m_job(item);
+      continue;
+    }
+    catch(const Glib::Exception & e) {
+      error = e.what();
+    }
+    catch(const std::exception & e) {
+      error = e.what();
+    }
+    catch(...) {
+    }
+
+    if(error.empty()) {
+      error = "transfer failed";
+    }
+    Glib::Threads::Mutex::Lock lock(m_mutex);
+    if(m_error.empty()) {
+      m_error = error;
+    }
+  }
+}
+
+}
+}
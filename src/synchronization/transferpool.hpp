@@ -0,0 +1,77 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SYNCHRONIZATION_TRANSFERPOOL_HPP_
+#define _SYNCHRONIZATION_TRANSFERPOOL_HPP_
+
+#include <stddef.h>
+
+#include <string>
+
+#include <glibmm/threads.h>
+#include <sigc++/sigc++.h>
+
+
+namespace gnote {
+namespace sync {
+
+/**
+ * Runs a job for each item of a transfer on a bounded number of worker
+ * threads, so that copying or reading one note does not wait for the
+ * previous one. This matters most on network mounts, where every file
+ * costs a round trip.
+ */
+class TransferPool
+{
+public:
+  /** Job for the item with the given index, called on a worker thread. */
+  typedef sigc::slot<void, size_t> Job;
+
+  static const unsigned MAX_THREADS;
+
+  explicit TransferPool(unsigned thread_count);
+
+  /**
+   * Run %job for the items 0 to %count - 1 and wait for all of them.
+   * Items are taken in order, the jobs have to guard shared state.
+   * If a job throws, the remaining items are skipped and the error is
+   * thrown from here as std::runtime_error.
+   */
+  void run(size_t count, const Job & job);
+
+  unsigned thread_count() const
+    {
+      return m_thread_count;
+    }
+private:
+  void work();
+
+  unsigned m_thread_count;
+  Job m_job;
+  size_t m_count;
+  size_t m_next;
+  std::string m_error;
+  Glib::Threads::Mutex m_mutex;
+};
+
+}
+}
+
+#endif
@@ -45,6 +45,7 @@ namespace gnote {
   {
     if(m_notes.find(note.uri()) == m_notes.end()) {
       m_notes[note.uri()] = &note;
+      m_note_bitmap.set(note.dense_id());
     }
   }
 
@@ -54,6 +55,7 @@ namespace gnote {
     NoteMap::iterator iter = m_notes.find(note.uri());
     if(iter != m_notes.end()) {
       m_notes.erase(iter);
+      m_note_bitmap.reset(note.dense_id());
     }
   }
 
@@ -87,5 +89,11 @@ namespace gnote {
     return m_notes.size();
   }
 
+
+  bool Tag::has_note(const NoteBase & note) const
+  {
+    return m_note_bitmap.test(note.dense_id());
+  }
+
 }
 
@@ -29,6 +29,7 @@
 #include <string>
 
 #include "base/macros.hpp"
+#include "notebitmap.hpp"
 
 namespace gnote {
 
@@ -96,6 +97,14 @@ namespace gnote {
     // Returns the number of notes this is currently tagging.
     // </summary>
     int popularity() const;
+    bool has_note(const NoteBase & note) const;
+    // <summary>
+    // Dense ids of the notes this tag is associated with.
+    // </summary>
+    const NoteBitmap & note_bitmap() const
+      {
+        return m_note_bitmap;
+      }
 /////
 
   private:
@@ -109,6 +118,7 @@ namespace gnote {
     // </summary>
     typedef std::map<std::string, NoteBase*> NoteMap;
     NoteMap m_notes;
+    NoteBitmap m_note_bitmap;
   };
 
 
@@ -56,7 +56,8 @@ namespace gnote {
   {
     m_sorted_tags->set_sort_func (0, sigc::ptr_fun(&compare_tags_sort_func));
     m_sorted_tags->set_sort_column(0, Gtk::SORT_ASCENDING);
-    
+    m_main_thread = Glib::Threads::Thread::self();
+    m_pending_rows_dispatcher.connect(sigc::mem_fun(*this, &TagManager::add_pending_rows));
   }
 
 
@@ -75,18 +76,17 @@ namespace gnote {
 
     std::vector<std::string> splits;
     sharp::string_split(splits, normalized_tag_name, ":");
+    Glib::Mutex::Lock lock(m_locker);
     if ((splits.size() > 2) || Glib::str_has_prefix(normalized_tag_name, Tag::SYSTEM_TAG_PREFIX)) {
-      Glib::Mutex::Lock lock(m_locker);
       std::map<std::string, Tag::Ptr>::const_iterator iter = m_internal_tags.find(normalized_tag_name);
       if(iter != m_internal_tags.end()) {
         return iter->second;
       }
       return Tag::Ptr();
     }
-    std::map<std::string, Gtk::TreeIter>::const_iterator iter = m_tag_map.find(normalized_tag_name);
+    TagMap::const_iterator iter = m_tag_map.find(normalized_tag_name);
     if (iter != m_tag_map.end()) {
-      Gtk::TreeIter tree_iter = iter->second;
-      return (*tree_iter)[m_columns.m_tag];
+      return iter->second;
     }
 
     return Tag::Ptr();
@@ -94,6 +94,7 @@ namespace gnote {
   
   // <summary>
   // Same as GetTag () but will create a new tag if one doesn't already exist.
+  // Can be called from any thread.
   // </summary>
   Tag::Ptr TagManager::get_or_create_tag(const std::string & tag_name)
   {
@@ -106,8 +107,8 @@ namespace gnote {
 
     std::vector<std::string> splits;
     sharp::string_split(splits, normalized_tag_name, ":");
+    Glib::Mutex::Lock lock(m_locker);
     if ((splits.size() > 2) || Glib::str_has_prefix(normalized_tag_name, Tag::SYSTEM_TAG_PREFIX)){
-      Glib::Mutex::Lock lock(m_locker);
       std::map<std::string, Tag::Ptr>::iterator iter;
       iter = m_internal_tags.find(normalized_tag_name);
       if(iter != m_internal_tags.end()) {
@@ -119,26 +120,25 @@ namespace gnote {
         return t;
       }
     }
-    Gtk::TreeIter iter;
-    bool tag_added = false;
-    Tag::Ptr tag = get_tag (normalized_tag_name);
-    if (!tag) {
-
-      Glib::Mutex::Lock lock(m_locker);
-
-      tag = get_tag (normalized_tag_name);
-      if (!tag) {
-        tag.reset(new Tag (sharp::string_trim(tag_name)));
-        iter = m_tags->append ();
-        (*iter)[m_columns.m_tag] = tag;
-        m_tag_map [tag->normalized_name()] = iter;
 
-        tag_added = true;
-      }
+    TagMap::iterator iter = m_tag_map.find(normalized_tag_name);
+    if (iter != m_tag_map.end()) {
+      return iter->second;
     }
 
-    if (tag_added) {
-      m_signal_tag_added(tag, iter);
+    Tag::Ptr tag(new Tag (sharp::string_trim(tag_name)));
+    m_tag_map [tag->normalized_name()] = tag;
+    if(Glib::Threads::Thread::self() == m_main_thread) {
+      lock.release();
+      add_row(tag);
+    }
+    else {
+      // List store is not thread safe, the row is added on the main thread
+      bool notify = m_pending_rows.empty();
+      m_pending_rows[tag->normalized_name()] = tag;
+      if(notify) {
+        m_pending_rows_dispatcher.emit();
+      }
     }
 
     return tag;
@@ -184,22 +184,27 @@ namespace gnote {
     if (!tag)
       throw sharp::Exception ("TagManager.RemoveTag () called with a null tag");
 
-    if(tag->is_property() || tag->is_system()){
-
-      Glib::Mutex::Lock lock(m_locker);
-
-      m_internal_tags.erase(tag->normalized_name());
-    }
     bool tag_removed = false;
-    std::map<std::string, Gtk::TreeIter>::iterator map_iter;
-    map_iter = m_tag_map.find(tag->normalized_name());
-    if (map_iter != m_tag_map.end()) {
-
+    {
       Glib::Mutex::Lock lock(m_locker);
 
-      map_iter = m_tag_map.find(tag->normalized_name());
+      if(tag->is_property() || tag->is_system()){
+        m_internal_tags.erase(tag->normalized_name());
+      }
+
+      TagMap::iterator map_iter = m_tag_map.find(tag->normalized_name());
       if (map_iter != m_tag_map.end()) {
-        Gtk::TreeIter iter = map_iter->second;
+        m_tag_map.erase(map_iter);
+        m_pending_rows.erase(tag->normalized_name());
+        DBG_OUT("Removed tag from tag_map: %s", tag->normalized_name().c_str());
+        tag_removed = true;
+      }
+    }
+
+    if (tag_removed) {
+      TagRowMap::iterator row_iter = m_tag_rows.find(tag->normalized_name());
+      if (row_iter != m_tag_rows.end()) {
+        Gtk::TreeIter iter = row_iter->second;
         if (!m_tags->erase(iter)) {
           DBG_OUT("TagManager: Removed tag: %s", tag->normalized_name().c_str());
         } 
@@ -207,37 +212,58 @@ namespace gnote {
           // FIXME: For some really weird reason, this block actually gets called sometimes!
           DBG_OUT("TagManager: Call to remove tag from ListStore failed: %s", tag->normalized_name().c_str());
         }
+        m_tag_rows.erase(row_iter);
+      }
 
-        m_tag_map.erase(map_iter);
-        DBG_OUT("Removed TreeIter from tag_map: %s", tag->normalized_name().c_str());
-        tag_removed = true;
-
-        std::list<NoteBase*> notes;
-        tag->get_notes(notes);
-        FOREACH(NoteBase *note_iter, notes) {
-          note_iter->remove_tag(tag);
-        }
+      std::list<NoteBase*> notes;
+      tag->get_notes(notes);
+      FOREACH(NoteBase *note_iter, notes) {
+        note_iter->remove_tag(tag);
       }
-    }
 
-    if (tag_removed) {
       m_signal_tag_removed(tag->normalized_name());
     }
   }
   
   void TagManager::all_tags(std::list<Tag::Ptr> & tags) const
   {
+    Glib::Mutex::Lock lock(m_locker);
+
     // Add in the system tags first
     sharp::map_get_values(m_internal_tags, tags);
     
     // Now all the other tags
     for(TagMap::const_iterator iter = m_tag_map.begin();
         iter != m_tag_map.end(); ++iter) {
-      Tag::Ptr tag;
-      iter->second->get_value(0, tag);      
-      tags.push_back(tag);
+      tags.push_back(iter->second);
     }
   }
 
-}
+  Glib::RefPtr<Gtk::TreeModel> TagManager::get_tags() const
+  {
+    add_pending_rows();
+    return m_sorted_tags;
+  }
 
+  void TagManager::add_pending_rows() const
+  {
+    TagMap tags;
+    {
+      Glib::Mutex::Lock lock(m_locker);
+      tags.swap(m_pending_rows);
+    }
+
+    for(TagMap::iterator iter = tags.begin(); iter != tags.end(); ++iter) {
+      add_row(iter->second);
+    }
+  }
+
+  void TagManager::add_row(const Tag::Ptr & tag) const
+  {
+    Gtk::TreeIter iter = m_tags->append();
+    (*iter)[m_columns.m_tag] = tag;
+    m_tag_rows[tag->normalized_name()] = iter;
+    m_signal_tag_added(tag, iter);
+  }
+
+}
@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2013 Aurimas Cernius
+ * Copyright (C) 2013-2014 Aurimas Cernius
  * Copyright (C) 2009 Hubert Figuiere
  *
  * This program is free software: you can redistribute it and/or modify
@@ -27,7 +27,9 @@
 
 #include <sigc++/signal.h>
 
+#include <glibmm/dispatcher.h>
 #include <glibmm/thread.h>
+#include <glibmm/threads.h>
 #include <gtkmm/liststore.h>
 #include <gtkmm/treemodelsort.h>
 
@@ -49,12 +51,12 @@ public:
   virtual Tag::Ptr get_system_tag(const std::string & tag_name) const override;
   virtual Tag::Ptr get_or_create_system_tag(const std::string & name) override;
   virtual void remove_tag(const Tag::Ptr & tag) override;
-  Glib::RefPtr<Gtk::TreeModel> get_tags() const
-    {
-      return m_sorted_tags;
-    }
+  Glib::RefPtr<Gtk::TreeModel> get_tags() const;
   virtual void all_tags(std::list<Tag::Ptr> &) const override;
 private:
+  void add_pending_rows() const;
+  void add_row(const Tag::Ptr & tag) const;
+
   class ColumnRecord
     : public Gtk::TreeModelColumnRecord
   {
@@ -68,12 +70,21 @@ private:
   ColumnRecord                     m_columns;
   Glib::RefPtr<Gtk::ListStore>     m_tags;
   Glib::RefPtr<Gtk::TreeModelSort> m_sorted_tags;
-  // The key for this dictionary is Tag.Name.ToLower ().
-  typedef std::map<std::string, Gtk::TreeIter> TagMap;
+  // The key for these dictionaries is Tag.Name.ToLower ().
+  // Tags can be created from any thread, so maps are protected by m_locker.
+  typedef std::map<std::string, Tag::Ptr> TagMap;
   TagMap                           m_tag_map;
   typedef std::map<std::string, Tag::Ptr> InternalMap;
   InternalMap                      m_internal_tags;
+  // Tags, created on other threads, that are not in the list store yet.
+  // They are added, when the main loop runs the dispatcher.
+  mutable TagMap                   m_pending_rows;
   mutable Glib::Mutex              m_locker;
+  Glib::Dispatcher                 m_pending_rows_dispatcher;
+  Glib::Threads::Thread           *m_main_thread;
+  // Rows of the list store, only accessed from the main thread
+  typedef std::map<std::string, Gtk::TreeIter> TagRowMap;
+  mutable TagRowMap                m_tag_rows;
   
   sigc::signal<void, Tag::Ptr, const Gtk::TreeIter &> m_signal_tag_added;
   sigc::signal<void, const std::string &> m_signal_tag_removed;
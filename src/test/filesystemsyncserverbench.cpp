@@ -0,0 +1,173 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Benchmark of a first sync against a file system server with many notes.
+// Usage: filesystemsyncserverbench [server notes] [new notes],
+// 20000 of each by default.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <list>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <giomm.h>
+#include <glibmm.h>
+
+#include "preferences.hpp"
+#include "sharp/directory.hpp"
+#include "sharp/files.hpp"
+#include "synchronization/filesystemsyncserver.hpp"
+
+namespace {
+
+const int DEFAULT_NUM_NOTES = 20000;
+
+std::string note_id(int i)
+{
+  char id[40];
+  snprintf(id, sizeof(id), "%08d-0000-0000-0000-000000000000", i);
+  return id;
+}
+
+std::string note_xml(int i)
+{
+  std::ostringstream xml;
+  xml << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      << "<note version=\"0.3\" xmlns=\"http://beatniksoftware.com/tomboy\">"
+      << "<title>Note " << i << "</title>"
+      << "<text xml:space=\"preserve\"><note-content version=\"0.1\">Note " << i
+      << "\n\nBody</note-content></text>"
+      << "<tags><tag>Tag" << i % 10 << "</tag></tags></note>\n";
+  return xml.str();
+}
+
+}
+
+int main(int argc, char **argv)
+{
+  int num_server_notes = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_NOTES;
+  int num_new_notes = argc > 2 ? atoi(argv[2]) : DEFAULT_NUM_NOTES;
+  if(num_server_notes < 0 || num_new_notes < 0) {
+    fprintf(stderr, "Usage: %s [server notes] [new notes]\n", argv[0]);
+    return 1;
+  }
+
+  // Sync locks need the client id from the settings
+  g_setenv("GSETTINGS_BACKEND", "memory", TRUE);
+  Gio::init();
+  GSettingsSchemaSource *source = g_settings_schema_source_get_default();
+  GSettingsSchema *schema = source
+    ? g_settings_schema_source_lookup(source, gnote::Preferences::SCHEMA_SYNC, TRUE) : NULL;
+  if(!schema) {
+    fprintf(stderr, "Gnote settings schemas are not installed\n");
+    return 1;
+  }
+  g_settings_schema_unref(schema);
+  gnote::Preferences preferences;
+
+  gchar *tmp_dir = g_dir_make_tmp("gnote-bench-XXXXXX", NULL);
+  if(!tmp_dir) {
+    fprintf(stderr, "Failed to create a temporary directory\n");
+    return 1;
+  }
+  std::string dir = tmp_dir;
+  g_free(tmp_dir);
+  std::string server_dir = Glib::build_filename(dir, "server");
+  std::string notes_dir = Glib::build_filename(dir, "notes");
+  sharp::directory_create(server_dir);
+  sharp::directory_create(notes_dir);
+
+  // Server at revision 0. The client updates half of its notes, deletes
+  // a tenth and uploads new notes of its own.
+  int num_deleted = num_server_notes / 10;
+  {
+    std::string rev_dir = Glib::build_filename(server_dir, "0", "0");
+    sharp::directory_create(rev_dir);
+    std::ofstream manifest(Glib::build_filename(server_dir, "manifest.xml").c_str());
+    manifest << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+             << "<sync revision=\"0\" server-id=\"bench-server\">\n";
+    for(int i = 0; i < num_server_notes; ++i) {
+      manifest << "<note id=\"" << note_id(i) << "\" rev=\"0\" />\n";
+    }
+    manifest << "</sync>\n";
+    manifest.close();
+    sharp::file_copy(Glib::build_filename(server_dir, "manifest.xml"),
+                     Glib::build_filename(rev_dir, "manifest.xml"));
+  }
+
+  gnote::sync::FileSystemSyncServer::NoteFileMap uploads;
+  for(int i = num_server_notes / 2; i < num_server_notes + num_new_notes; ++i) {
+    std::string path = Glib::build_filename(notes_dir, note_id(i) + ".note");
+    std::ofstream fout(path.c_str());
+    fout << note_xml(i);
+    fout.close();
+    uploads[path] = "";
+  }
+  std::list<std::string> deletes;
+  for(int i = 0; i < num_deleted; ++i) {
+    deletes.push_back(note_id(i));
+  }
+
+  Glib::Timer timer;
+  shared_ptr<gnote::sync::FileSystemSyncServer> server = static_pointer_cast<gnote::sync::FileSystemSyncServer>(
+    gnote::sync::FileSystemSyncServer::create(server_dir));
+  size_t server_notes = server->get_all_note_uuids().size();
+  double read_time = timer.elapsed();
+
+  bool ok = server_notes == size_t(num_server_notes) && server->begin_sync_transaction();
+  timer.start();
+  server->upload_note_files(uploads);
+  server->delete_notes(deletes);
+  double upload_time = timer.elapsed();
+  timer.start();
+  ok = ok && server->commit_sync_transaction();
+  double commit_time = timer.elapsed();
+
+  printf("Server of %d notes, %d uploaded, %d deleted: "
+         "reading manifest %fs, uploading %fs, commit %fs\n",
+         num_server_notes, int(uploads.size()), num_deleted, read_time, upload_time, commit_time);
+
+  // A new client reads the uploaded notes, one at a time and on the worker pool
+  server = static_pointer_cast<gnote::sync::FileSystemSyncServer>(
+    gnote::sync::FileSystemSyncServer::create(server_dir));
+  unsigned transfer_threads = server->transfer_threads();
+  server->set_transfer_threads(1);
+  timer.start();
+  size_t serial_updates = server->get_note_updates_since(0).size();
+  double serial_time = timer.elapsed();
+  server->set_transfer_threads(transfer_threads);
+  timer.start();
+  size_t parallel_updates = server->get_note_updates_since(0).size();
+  double parallel_time = timer.elapsed();
+  ok = ok && serial_updates == uploads.size() && parallel_updates == uploads.size();
+
+  printf("Reading %d updates: %fs on 1 thread, %fs on %u threads\n",
+         int(parallel_updates), serial_time, parallel_time, transfer_threads);
+
+  sharp::directory_delete_recursive(dir);
+  if(!ok) {
+    fprintf(stderr, "Synchronization failed\n");
+    return 1;
+  }
+  return 0;
+}
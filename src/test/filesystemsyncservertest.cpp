@@ -0,0 +1,271 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <list>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/minimal.hpp>
+#include <giomm.h>
+#include <glibmm.h>
+
+#include "notehash.hpp"
+#include "preferences.hpp"
+#include "sharp/directory.hpp"
+#include "sharp/files.hpp"
+#include "synchronization/filesystemsyncserver.hpp"
+#include "synchronization/notepack.hpp"
+
+namespace {
+
+std::string note_id(int i)
+{
+  char id[40];
+  snprintf(id, sizeof(id), "%08d-0000-0000-0000-000000000000", i);
+  return id;
+}
+
+std::string note_xml(int i)
+{
+  std::ostringstream xml;
+  xml << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      << "<note version=\"0.3\" xmlns=\"http://beatniksoftware.com/tomboy\">"
+      << "<title>Note " << i << "</title>"
+      << "<text xml:space=\"preserve\"><note-content version=\"0.1\">Note " << i
+      << "\n\nBody</note-content></text>"
+      << "<tags><tag>Tag" << i % 10 << "</tag></tags></note>\n";
+  return xml.str();
+}
+
+std::string note_hash(int i)
+{
+  std::ostringstream title, content, tag;
+  title << "Note " << i;
+  content << "<note-content version=\"0.1\">Note " << i << "\n\nBody</note-content>";
+  tag << "tag" << i % 10;
+  return gnote::NoteHash::note_hash(title.str(), gnote::NoteHash::content_hash(content.str()),
+                                    std::vector<std::string>(1, tag.str()));
+}
+
+}
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  // Sync locks need the client id from the settings
+  g_setenv("GSETTINGS_BACKEND", "memory", TRUE);
+  Gio::init();
+  GSettingsSchemaSource *source = g_settings_schema_source_get_default();
+  GSettingsSchema *schema = source
+    ? g_settings_schema_source_lookup(source, gnote::Preferences::SCHEMA_SYNC, TRUE) : NULL;
+  if(!schema || !g_settings_schema_has_key(schema, gnote::Preferences::SYNC_TRANSFER_THREADS)
+     || !g_settings_schema_has_key(schema, gnote::Preferences::SYNC_PACK_NOTES)) {
+    // Automake treats 77 as a skipped test
+    printf("Gnote settings schemas are not installed, skipping\n");
+    exit(77);
+  }
+  g_settings_schema_unref(schema);
+  gnote::Preferences preferences;
+
+  gchar *tmp_dir = g_dir_make_tmp("gnote-test-XXXXXX", NULL);
+  BOOST_CHECK(tmp_dir != NULL);
+  std::string dir = tmp_dir;
+  g_free(tmp_dir);
+  std::string server_dir = Glib::build_filename(dir, "server");
+  std::string notes_dir = Glib::build_filename(dir, "notes");
+  sharp::directory_create(server_dir);
+  sharp::directory_create(notes_dir);
+
+  // Synthetic server at revision 0 with NUM_SERVER_NOTES notes.
+  // The client updates half of them, deletes a tenth and uploads
+  // NUM_NEW_NOTES notes of its own, like a first sync against
+  // an existing server. filesystemsyncserverbench times the same
+  // with many notes.
+  const int NUM_SERVER_NOTES = 200;
+  const int NUM_NEW_NOTES = 200;
+  const int NUM_DELETED = NUM_SERVER_NOTES / 10;
+  {
+    std::string rev_dir = Glib::build_filename(server_dir, "0", "0");
+    sharp::directory_create(rev_dir);
+    std::ofstream manifest(Glib::build_filename(server_dir, "manifest.xml").c_str());
+    manifest << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+             << "<sync revision=\"0\" server-id=\"test-server\">\n";
+    for(int i = 0; i < NUM_SERVER_NOTES; ++i) {
+      manifest << "<note id=\"" << note_id(i) << "\" rev=\"0\" />\n";
+    }
+    manifest << "</sync>\n";
+    manifest.close();
+    sharp::file_copy(Glib::build_filename(server_dir, "manifest.xml"),
+                     Glib::build_filename(rev_dir, "manifest.xml"));
+  }
+
+  gnote::sync::FileSystemSyncServer::NoteFileMap uploads;
+  for(int i = NUM_SERVER_NOTES / 2; i < NUM_SERVER_NOTES + NUM_NEW_NOTES; ++i) {
+    std::string path = Glib::build_filename(notes_dir, note_id(i) + ".note");
+    std::ofstream fout(path.c_str());
+    fout << note_xml(i);
+    fout.close();
+    uploads[path] = i % 2 ? note_hash(i) : "";
+  }
+  std::list<std::string> deletes;
+  for(int i = 0; i < NUM_DELETED; ++i) {
+    deletes.push_back(note_id(i));
+  }
+
+  gnote::sync::SyncServer::Ptr server = gnote::sync::FileSystemSyncServer::create(server_dir);
+  BOOST_CHECK(server->latest_revision() == 0);
+  BOOST_CHECK(server->id() == "test-server");
+  BOOST_CHECK(server->get_all_note_uuids().size() == unsigned(NUM_SERVER_NOTES));
+
+  BOOST_CHECK(server->begin_sync_transaction());
+  static_pointer_cast<gnote::sync::FileSystemSyncServer>(server)->upload_note_files(uploads);
+  server->delete_notes(deletes);
+  BOOST_CHECK(server->commit_sync_transaction());
+  BOOST_CHECK(server->latest_revision() == 1);
+
+  // A new client sees the committed revision
+  server = gnote::sync::FileSystemSyncServer::create(server_dir);
+  BOOST_CHECK(server->latest_revision() == 1);
+  BOOST_CHECK(server->id() == "test-server");
+  std::list<std::string> uuids = server->get_all_note_uuids();
+  BOOST_CHECK(uuids.size() == unsigned(NUM_SERVER_NOTES + NUM_NEW_NOTES - NUM_DELETED));
+  BOOST_CHECK(!server->updates_available_since(1));
+  BOOST_CHECK(server->updates_available_since(0));
+
+  // Read the uploaded notes back, one at a time and on the worker pool
+  shared_ptr<gnote::sync::FileSystemSyncServer> fs_server
+    = static_pointer_cast<gnote::sync::FileSystemSyncServer>(server);
+  unsigned transfer_threads = fs_server->transfer_threads();
+  BOOST_CHECK(transfer_threads >= 1);
+  fs_server->set_transfer_threads(1);
+  std::map<std::string, gnote::sync::NoteUpdate> updates = fs_server->get_note_updates_since(0);
+  BOOST_CHECK(updates.size() == uploads.size());
+  fs_server->set_transfer_threads(transfer_threads);
+  updates = fs_server->get_note_updates_since(0);
+  BOOST_CHECK(updates.size() == uploads.size());
+  std::map<std::string, gnote::sync::NoteUpdate>::iterator update = updates.find(note_id(NUM_SERVER_NOTES));
+  BOOST_CHECK(update != updates.end());
+  std::ostringstream new_title;
+  new_title << "Note " << NUM_SERVER_NOTES;
+  BOOST_CHECK(update->second.m_title == new_title.str());
+  BOOST_CHECK(update->second.m_latest_revision == 1);
+  // hashes are published in the manifest or computed from the note
+  BOOST_CHECK(update->second.m_content_hash == note_hash(NUM_SERVER_NOTES));
+  update = updates.find(note_id(NUM_SERVER_NOTES + 1));
+  BOOST_CHECK(update != updates.end());
+  BOOST_CHECK(update->second.m_content_hash == note_hash(NUM_SERVER_NOTES + 1));
+  BOOST_CHECK(updates.find(note_id(0)) == updates.end());
+
+  // Packed server: a revision of plain files, followed by enough packed
+  // revisions to get compacted. Each commit needs a new server object.
+  const int NUM_PACKED_NOTES = 100;
+  const int NUM_PACKED_REVISIONS = 24;
+  std::string packed_dir = Glib::build_filename(dir, "packed");
+  sharp::directory_create(packed_dir);
+  for(int rev = 0; rev <= NUM_PACKED_REVISIONS; ++rev) {
+    fs_server = static_pointer_cast<gnote::sync::FileSystemSyncServer>(
+      gnote::sync::FileSystemSyncServer::create(packed_dir));
+    BOOST_CHECK(fs_server->latest_revision() == rev - 1);
+    fs_server->set_use_packs(rev > 0);
+    gnote::sync::FileSystemSyncServer::NoteFileMap files;
+    // all notes in the first revision, a few of them later
+    for(int i = 0; i < NUM_PACKED_NOTES; ++i) {
+      if(rev == 0 || i % NUM_PACKED_REVISIONS == rev - 1) {
+        files[Glib::build_filename(notes_dir, note_id(i + NUM_SERVER_NOTES) + ".note")] = "";
+      }
+    }
+    BOOST_CHECK(fs_server->begin_sync_transaction());
+    fs_server->upload_note_files(files);
+    BOOST_CHECK(fs_server->commit_sync_transaction());
+  }
+
+  fs_server = static_pointer_cast<gnote::sync::FileSystemSyncServer>(
+    gnote::sync::FileSystemSyncServer::create(packed_dir));
+  BOOST_CHECK(fs_server->latest_revision() == NUM_PACKED_REVISIONS);
+  updates = fs_server->get_note_updates_since(-1);
+  BOOST_CHECK(updates.size() == unsigned(NUM_PACKED_NOTES));
+  for(int i = 0; i < NUM_PACKED_NOTES; ++i) {
+    update = updates.find(note_id(i + NUM_SERVER_NOTES));
+    BOOST_CHECK(update != updates.end());
+    if(update == updates.end()) {
+      continue;
+    }
+    std::ostringstream title;
+    title << "Note " << i + NUM_SERVER_NOTES;
+    BOOST_CHECK(update->second.m_title == title.str());
+    BOOST_CHECK(update->second.m_xml_content == note_xml(i + NUM_SERVER_NOTES));
+    BOOST_CHECK(update->second.m_content_hash == note_hash(i + NUM_SERVER_NOTES));
+  }
+  // compaction at revision 20 dropped the older revisions
+  std::list<std::string> revision_dirs;
+  sharp::directory_get_directories(Glib::build_filename(packed_dir, "0"), revision_dirs);
+  BOOST_CHECK(revision_dirs.size() == unsigned(NUM_PACKED_REVISIONS - 20 + 1));
+  BOOST_CHECK(!sharp::directory_exists(Glib::build_filename(packed_dir, "0", "0")));
+  std::string manifest = Glib::file_get_contents(Glib::build_filename(packed_dir, "manifest.xml"));
+  BOOST_CHECK(manifest.find("pack=\"20\"") != std::string::npos);
+
+  // An older client rewrites the manifest without format and pack attributes
+  const char *new_attributes[] = { " format=\"", " pack=\"" };
+  for(int i = 0; i < 2; ++i) {
+    std::string::size_type pos;
+    while((pos = manifest.find(new_attributes[i])) != std::string::npos) {
+      manifest.erase(pos, manifest.find('"', pos + strlen(new_attributes[i])) + 1 - pos);
+    }
+  }
+  {
+    std::ofstream fout(Glib::build_filename(packed_dir, "manifest.xml").c_str());
+    fout << manifest;
+  }
+  fs_server = static_pointer_cast<gnote::sync::FileSystemSyncServer>(
+    gnote::sync::FileSystemSyncServer::create(packed_dir));
+  updates = fs_server->get_note_updates_since(-1);
+  BOOST_CHECK(updates.size() == unsigned(NUM_PACKED_NOTES));
+  for(int i = 0; i < NUM_PACKED_NOTES; ++i) {
+    update = updates.find(note_id(i + NUM_SERVER_NOTES));
+    BOOST_CHECK(update != updates.end()
+                && update->second.m_xml_content == note_xml(i + NUM_SERVER_NOTES));
+  }
+  // the next commit neither packs nor deletes revisions
+  fs_server->set_use_packs(true);
+  gnote::sync::FileSystemSyncServer::NoteFileMap files;
+  files[Glib::build_filename(notes_dir, note_id(NUM_SERVER_NOTES) + ".note")] = "";
+  BOOST_CHECK(fs_server->begin_sync_transaction());
+  fs_server->upload_note_files(files);
+  BOOST_CHECK(fs_server->commit_sync_transaction());
+  std::string new_revision_dir = Glib::build_filename(packed_dir, "0", TO_STRING(NUM_PACKED_REVISIONS + 1));
+  BOOST_CHECK(sharp::file_exists(Glib::build_filename(new_revision_dir, note_id(NUM_SERVER_NOTES) + ".note")));
+  BOOST_CHECK(!sharp::file_exists(Glib::build_filename(new_revision_dir, gnote::sync::NotePack::FILE_NAME)));
+  revision_dirs.clear();
+  sharp::directory_get_directories(Glib::build_filename(packed_dir, "0"), revision_dirs);
+  BOOST_CHECK(revision_dirs.size() == unsigned(NUM_PACKED_REVISIONS - 20 + 2));
+  manifest = Glib::file_get_contents(Glib::build_filename(packed_dir, "manifest.xml"));
+  BOOST_CHECK(manifest.find("format=\"2\"") != std::string::npos);
+  BOOST_CHECK(manifest.find("pack=\"20\"") != std::string::npos);
+
+  sharp::directory_delete_recursive(dir);
+  BOOST_CHECK(!sharp::directory_exists(dir));
+
+  return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <vector>
+
+#include <boost/test/minimal.hpp>
+
+#include "notebitmap.hpp"
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  gnote::NoteBitmap a, b;
+  BOOST_CHECK(a.empty());
+  a.set(1);
+  a.set(64);
+  a.set(200);
+  b.set(64);
+  b.set(65);
+  BOOST_CHECK(a.test(64));
+  BOOST_CHECK(!a.test(65));
+  BOOST_CHECK(!a.test(100000));
+  BOOST_CHECK(a.count() == 3);
+
+  gnote::NoteBitmap c(a);
+  c &= b;
+  BOOST_CHECK(c.count() == 1 && c.test(64));
+  c = a;
+  c |= b;
+  BOOST_CHECK(c.count() == 4 && c.test(65));
+  c = a;
+  c.and_not(b);
+  BOOST_CHECK(c.count() == 2 && !c.test(64) && c.test(200));
+  std::vector<unsigned> ids;
+  c.get_ids(ids);
+  BOOST_CHECK(ids.size() == 2 && ids[0] == 1 && ids[1] == 200);
+  c.reset(1);
+  c.reset(200);
+  c.reset(5000);
+  BOOST_CHECK(c.empty());
+
+  // Released ids are reused, smallest first
+  unsigned first = gnote::NoteBitmap::allocate_id();
+  unsigned second = gnote::NoteBitmap::allocate_id();
+  unsigned third = gnote::NoteBitmap::allocate_id();
+  gnote::NoteBitmap::release_id(third);
+  gnote::NoteBitmap::release_id(first);
+  BOOST_CHECK(gnote::NoteBitmap::allocate_id() == first);
+  BOOST_CHECK(gnote::NoteBitmap::allocate_id() == third);
+  BOOST_CHECK(gnote::NoteBitmap::allocate_id() == second + 2);
+
+  return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include <boost/test/minimal.hpp>
+#include <gtkmm.h>
+
+#include "notebuffer.hpp"
+#include "notetag.hpp"
+
+namespace {
+
+// Block archiver has to give the same XML as serializing the whole buffer
+bool same_as_full(gnote::NoteBufferBlockArchiver & archiver, const Glib::RefPtr<Gtk::TextBuffer> & buffer)
+{
+  std::string blocks = archiver.serialize();
+  std::string full = gnote::NoteBufferArchiver::serialize(buffer);
+  if(blocks != full) {
+    printf("Block XML differs from full XML:\n%s\n%s\n", blocks.c_str(), full.c_str());
+    return false;
+  }
+  return true;
+}
+
+void add_bullet(const Glib::RefPtr<Gtk::TextBuffer> & buffer, int line, int depth)
+{
+  gnote::NoteTagTable::Ptr table = gnote::NoteTagTable::instance();
+  buffer->insert_with_tag(buffer->get_iter_at_line(line), "\xe2\x80\xa2 ",
+                          table->get_depth_tag(depth, Pango::DIRECTION_LTR));
+}
+
+}
+
+int test_main(int argc, char ** argv)
+{
+  if(!gtk_init_check(&argc, &argv)) {
+    // Automake treats 77 as a skipped test
+    printf("No display to initialize GTK+, skipping\n");
+    exit(77);
+  }
+  Gtk::Main kit(argc, argv);
+
+  Glib::RefPtr<Gtk::TextBuffer> buffer = Gtk::TextBuffer::create(gnote::NoteTagTable::instance());
+  Glib::RefPtr<Gtk::TextTag> bold = buffer->get_tag_table()->lookup("bold");
+  Glib::RefPtr<Gtk::TextTag> italic = buffer->get_tag_table()->lookup("italic");
+  BOOST_CHECK(bold && italic);
+
+  gnote::NoteBufferBlockArchiver archiver(*(buffer.operator->()));
+  BOOST_CHECK(same_as_full(archiver, buffer));
+
+  // Several blocks of a few thousand characters
+  std::ostringstream text;
+  text << "Title\n\n";
+  for(int i = 0; i < 400; ++i) {
+    text << "Line " << i << " with some text to fill the blocks <&>\n";
+  }
+  buffer->insert(buffer->end(), text.str());
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  BOOST_CHECK(same_as_full(archiver, buffer));
+
+  // Typing inside a line and inserting a line at the start of lines,
+  // around the places, where blocks are split
+  for(int line = 60; line < 260; line += 50) {
+    buffer->insert(buffer->get_iter_at_line_offset(line, 3), "typed");
+    BOOST_CHECK(same_as_full(archiver, buffer));
+    buffer->insert(buffer->get_iter_at_line(line + 1), "new line\n");
+    BOOST_CHECK(same_as_full(archiver, buffer));
+  }
+
+  // Erasing across block boundaries joins blocks
+  buffer->erase(buffer->get_iter_at_line_offset(80, 5), buffer->get_iter_at_line_offset(200, 7));
+  BOOST_CHECK(same_as_full(archiver, buffer));
+
+  // Multi-line tags: applied across lines, typed into and removed again
+  buffer->apply_tag(bold, buffer->get_iter_at_line_offset(70, 4), buffer->get_iter_at_line_offset(150, 2));
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->apply_tag(italic, buffer->get_iter_at_line(100), buffer->get_iter_at_line(101));
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->insert(buffer->get_iter_at_line(110), "inside bold\n");
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->erase(buffer->get_iter_at_line_offset(69, 0), buffer->get_iter_at_line_offset(71, 0));
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->remove_tag(bold, buffer->get_iter_at_line(90), buffer->get_iter_at_line(120));
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->remove_tag(bold, buffer->begin(), buffer->end());
+  BOOST_CHECK(same_as_full(archiver, buffer));
+
+  // Lists: lines turned into list items, nested, edited and turned back
+  for(int line = 140; line < 200; ++line) {
+    add_bullet(buffer, line, (line / 10) % 3);
+  }
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->insert(buffer->get_iter_at_line_offset(170, 4), "list text");
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->insert(buffer->get_iter_at_line(171), "not in list\n");
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->apply_tag(bold, buffer->get_iter_at_line_offset(150, 3), buffer->get_iter_at_line_offset(180, 3));
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  for(int line = 160; line < 165; ++line) {
+    buffer->erase(buffer->get_iter_at_line(line), buffer->get_iter_at_line_offset(line, 2));
+  }
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->erase(buffer->get_iter_at_line(130), buffer->get_iter_at_line(145));
+  BOOST_CHECK(same_as_full(archiver, buffer));
+
+  // Random edits anywhere
+  srand(1);
+  for(int i = 0; i < 300; ++i) {
+    int size = buffer->end().get_offset();
+    int start = size > 0 ? rand() % size : 0;
+    int end = std::min(size, start + rand() % 200);
+    switch(rand() % 6) {
+    case 0:
+      buffer->insert(buffer->get_iter_at_offset(start), "random text");
+      break;
+    case 1:
+      buffer->insert(buffer->get_iter_at_offset(start), "\n");
+      break;
+    case 2:
+      buffer->erase(buffer->get_iter_at_offset(start), buffer->get_iter_at_offset(end));
+      break;
+    case 3:
+      buffer->apply_tag(bold, buffer->get_iter_at_offset(start), buffer->get_iter_at_offset(end));
+      break;
+    case 4:
+      buffer->remove_tag(bold, buffer->get_iter_at_offset(start), buffer->get_iter_at_offset(end));
+      break;
+    case 5:
+      add_bullet(buffer, buffer->get_iter_at_offset(start).get_line(), rand() % 3);
+      break;
+    }
+    if(i % 10 == 0) {
+      BOOST_CHECK(same_as_full(archiver, buffer));
+    }
+  }
+  BOOST_CHECK(same_as_full(archiver, buffer));
+
+  buffer->erase(buffer->begin(), buffer->end());
+  BOOST_CHECK(same_as_full(archiver, buffer));
+  buffer->insert(buffer->end(), text.str());
+  BOOST_CHECK(same_as_full(archiver, buffer));
+
+  return 0;
+}
+
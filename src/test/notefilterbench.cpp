@@ -0,0 +1,179 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Benchmark of refiltering the note list by notebook, template and
+// selected tag, with tag lookups of each note and with tag bitmaps.
+// Usage: notefilterbench [number of notes], 100000 by default.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <list>
+#include <set>
+#include <vector>
+
+#include <glibmm.h>
+
+#include "notebase.hpp"
+#include "notemanagerbase.hpp"
+#include "searchnoteswidget.hpp"
+#include "notebooks/notebook.hpp"
+
+namespace {
+
+const int DEFAULT_NUM_NOTES = 100000;
+const int NUM_REFILTERS = 20;
+
+// Notes are only looked at, never created or loaded by the manager
+class BenchNoteManager
+  : public gnote::NoteManagerBase
+{
+public:
+  BenchNoteManager()
+    : gnote::NoteManagerBase("")
+    {}
+  virtual gnote::NoteBase::Ptr note_create_new(const Glib::ustring &, const Glib::ustring &) override
+    {
+      return gnote::NoteBase::Ptr();
+    }
+  virtual gnote::NoteBase::Ptr note_load(const Glib::ustring &) override
+    {
+      return gnote::NoteBase::Ptr();
+    }
+};
+
+class BenchNote
+  : public gnote::NoteBase
+{
+public:
+  BenchNote(gnote::NoteData *data, gnote::NoteManagerBase & manager)
+    : gnote::NoteBase(data, "", manager)
+    , m_synchronizer(data)
+    {}
+  // Tags are added to the data directly, adding them to a note queues a save
+  void add_tag(const gnote::Tag::Ptr & tag)
+    {
+      tag->add_note(*this);
+      data().tags()[tag->normalized_name()] = tag;
+    }
+  virtual const gnote::NoteDataBufferSynchronizerBase & data_synchronizer() const override
+    {
+      return m_synchronizer;
+    }
+  virtual gnote::NoteDataBufferSynchronizerBase & data_synchronizer() override
+    {
+      return m_synchronizer;
+    }
+private:
+  gnote::NoteDataBufferSynchronizerBase m_synchronizer;
+};
+
+// The filter as it was, looking up the tags of each note
+bool lookup_filter(const gnote::NoteBase & note, const gnote::Tag::Ptr & notebook_tag,
+                   const gnote::Tag::Ptr & template_tag, const std::set<gnote::Tag::Ptr> & selected_tags)
+{
+  if(!note.contains_tag(notebook_tag) || note.contains_tag(template_tag)) {
+    return false;
+  }
+  std::list<gnote::Tag::Ptr> tags;
+  note.get_tags(tags);
+  for(std::list<gnote::Tag::Ptr>::const_iterator iter = tags.begin(); iter != tags.end(); ++iter) {
+    if(selected_tags.find(*iter) != selected_tags.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The filter of the search window, with tag bitmaps
+bool bitmap_filter(const gnote::NoteBase & note, const gnote::Tag::Ptr & notebook_tag,
+                   const gnote::Tag::Ptr & template_tag, const std::set<gnote::Tag::Ptr> & selected_tags)
+{
+  return gnote::notebooks::Notebook::contains_note(notebook_tag, template_tag, note, false)
+    && gnote::SearchNotesWidget::has_selected_tag(selected_tags, note);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+  int num_notes = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_NOTES;
+  if(num_notes <= 0) {
+    fprintf(stderr, "Usage: %s [number of notes]\n", argv[0]);
+    return 1;
+  }
+
+  BenchNoteManager manager;
+  gnote::Tag::Ptr notebook_tag(new gnote::Tag("system:notebook:work"));
+  gnote::Tag::Ptr template_tag(new gnote::Tag("system:template"));
+  gnote::Tag::Ptr todo_tag(new gnote::Tag("todo"));
+  gnote::Tag::Ptr other_tag(new gnote::Tag("other"));
+  std::set<gnote::Tag::Ptr> selected_tags;
+  selected_tags.insert(todo_tag);
+
+  std::vector<shared_ptr<BenchNote> > notes;
+  for(int i = 0; i < num_notes; ++i) {
+    char uri[64];
+    snprintf(uri, sizeof(uri), "note://gnote/%08d", i);
+    shared_ptr<BenchNote> note(new BenchNote(new gnote::NoteData(uri), manager));
+    if(i % 3 == 0) {
+      note->add_tag(notebook_tag);
+    }
+    if(i % 101 == 0) {
+      note->add_tag(template_tag);
+    }
+    if(i % 2 == 0) {
+      note->add_tag(todo_tag);
+    }
+    note->add_tag(other_tag);
+    notes.push_back(note);
+  }
+
+  Glib::Timer timer;
+  int expected = 0;
+  for(int n = 0; n < NUM_REFILTERS; ++n) {
+    expected = 0;
+    for(int i = 0; i < num_notes; ++i) {
+      if(lookup_filter(*notes[i], notebook_tag, template_tag, selected_tags)) {
+        ++expected;
+      }
+    }
+  }
+  double lookup_time = timer.elapsed();
+
+  timer.start();
+  int visible = 0;
+  for(int n = 0; n < NUM_REFILTERS; ++n) {
+    visible = 0;
+    for(int i = 0; i < num_notes; ++i) {
+      if(bitmap_filter(*notes[i], notebook_tag, template_tag, selected_tags)) {
+        ++visible;
+      }
+    }
+  }
+  double bitmap_time = timer.elapsed();
+
+  printf("%d refilters of %d notes, %d visible: tag lookup %.4fs, bitmap %.4fs\n",
+         NUM_REFILTERS, num_notes, visible, lookup_time, bitmap_time);
+  if(visible != expected) {
+    fprintf(stderr, "Bitmap filter shows %d notes, tag lookup %d\n", visible, expected);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string>
+#include <vector>
+
+#include <boost/test/minimal.hpp>
+
+#include "notehash.hpp"
+
+using gnote::NoteHash;
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  // Attributes of note-content do not count
+  std::string content = NoteHash::content_hash("<note-content version=\"0.1\">Title\n\nText</note-content>");
+  BOOST_CHECK(!content.empty());
+  BOOST_CHECK(content == NoteHash::content_hash(
+    "<note-content xmlns=\"http://beatniksoftware.com/tomboy\" version=\"0.2\">Title\n\nText</note-content>"));
+  BOOST_CHECK(content != NoteHash::content_hash("<note-content version=\"0.1\">Title\n\nText.</note-content>"));
+  BOOST_CHECK(NoteHash::content_hash("<note-content version=\"0.1\" />")
+              == NoteHash::content_hash("<note-content version=\"0.1\"></note-content>"));
+
+  // Text written by the editor and the same text, read from a file
+  std::string escaped = NoteHash::content_hash(
+    "<note-content version=\"0.1\" xmlns:link=\"http://beatniksoftware.com/tomboy/link\">"
+    "Title\r\n\n&quot;Quoted&quot; &apos;text&apos;\r<bold>&amp;</bold><link:internal>Other</link:internal>"
+    "<italic></italic></note-content>");
+  BOOST_CHECK(escaped == NoteHash::content_hash(
+    "<note-content xmlns:link=\"http://beatniksoftware.com/tomboy/link\" version=\"0.2\">"
+    "Title\n\n\"Quoted\" 'text'\n<bold>&amp;</bold><link:internal>Other</link:internal>"
+    "<italic /></note-content>"));
+  BOOST_CHECK(escaped != NoteHash::content_hash(
+    "<note-content version=\"0.1\" xmlns:link=\"http://beatniksoftware.com/tomboy/link\">"
+    "Title\n\n\"Quoted\" 'text'\n<italic>&amp;</italic><link:internal>Other</link:internal>"
+    "<italic /></note-content>"));
+
+  std::vector<std::string> tags;
+  tags.push_back("Work");
+  tags.push_back("system:notebook:Gnote");
+  std::string hash = NoteHash::note_hash("Title", content, tags);
+  BOOST_CHECK(hash.size() == 40);
+
+  // Titles are trimmed, tags are normalized and unordered
+  std::vector<std::string> other_tags;
+  other_tags.push_back("system:notebook:gnote");
+  other_tags.push_back(" work ");
+  BOOST_CHECK(hash == NoteHash::note_hash(" Title ", content, other_tags));
+
+  BOOST_CHECK(hash != NoteHash::note_hash("Title 2", content, tags));
+  other_tags.pop_back();
+  BOOST_CHECK(hash != NoteHash::note_hash("Title", content, other_tags));
+  BOOST_CHECK(hash != NoteHash::note_hash("Title",
+    NoteHash::content_hash("<note-content version=\"0.1\">Title\n\nText.</note-content>"), tags));
+
+  return 0;
+}
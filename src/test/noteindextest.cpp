@@ -0,0 +1,56 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string>
+
+#include <boost/test/minimal.hpp>
+
+#include "noteindex.hpp"
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  gnote::NoteIndex<std::string> index;
+  index.add("note://gnote/1", "Start Here", "start");
+  index.add("note://gnote/2", "Using Links in Gnote", "links");
+  index.add("note://gnote/3", "ąČęĖ", "unicode");
+
+  BOOST_CHECK(index.size() == 3);
+  BOOST_CHECK(index.find_by_title("start here") == "start");
+  BOOST_CHECK(index.find_by_title("START HERE") == "start");
+  BOOST_CHECK(index.find_by_title("ĄčĘė") == "unicode");
+  BOOST_CHECK(index.find_by_title("Start") == "");
+  BOOST_CHECK(index.find_by_uri("note://gnote/2") == "links");
+  BOOST_CHECK(index.find_by_uri("note://gnote/4") == "");
+
+  index.rename("note://gnote/1", "Start There");
+  BOOST_CHECK(index.find_by_title("Start Here") == "");
+  BOOST_CHECK(index.find_by_title("start there") == "start");
+  BOOST_CHECK(index.find_by_uri("note://gnote/1") == "start");
+
+  // Same title in different case
+  index.add("note://gnote/5", "USING LINKS IN GNOTE", "links2");
+  index.remove("note://gnote/2");
+  BOOST_CHECK(index.find_by_title("Using Links in Gnote") == "links2");
+  BOOST_CHECK(index.find_by_uri("note://gnote/2") == "");
+  BOOST_CHECK(index.size() == 3);
+
+  return 0;
+}
+
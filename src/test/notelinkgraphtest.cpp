@@ -0,0 +1,74 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string>
+
+#include <boost/test/minimal.hpp>
+
+#include "notelinkgraph.hpp"
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  gnote::NoteLinkGraph::LinkSet links;
+  gnote::NoteLinkGraph::extract_links(
+    "<note-content version=\"0.1\">Title\n\n"
+    "<link:internal>Start Here</link:internal> and "
+    "<link:internal>Tom &amp; Jerry &lt;3</link:internal>, "
+    "<link:internal><bold>Formatted</bold></link:internal> "
+    "<link:url>http://example.com</link:url> "
+    "<link:internal>Start Here</link:internal>"
+    "</note-content>", links);
+  BOOST_CHECK(links.size() == 2);
+  BOOST_CHECK(links.count("Start Here") == 1);
+  BOOST_CHECK(links.count("Tom & Jerry <3") == 1);
+
+  gnote::NoteLinkGraph::extract_links("<note-content>No links</note-content>", links);
+  BOOST_CHECK(links.empty());
+
+  gnote::NoteLinkGraph graph;
+  links.insert("Start Here");
+  links.insert("Missing");
+  graph.set_links("note://gnote/1", links);
+  links.clear();
+  links.insert("Start Here");
+  graph.set_links("note://gnote/2", links);
+
+  BOOST_CHECK(graph.contains("note://gnote/1"));
+  BOOST_CHECK(!graph.contains("note://gnote/3"));
+  BOOST_CHECK(graph.get_links("note://gnote/1").size() == 2);
+  BOOST_CHECK(graph.get_linking_notes("Start Here").size() == 2);
+  BOOST_CHECK(graph.get_linking_notes("Missing").count("note://gnote/1") == 1);
+  BOOST_CHECK(graph.get_linking_notes("Other").empty());
+
+  // Replacing links drops old backlinks
+  links.clear();
+  links.insert("Other");
+  graph.set_links("note://gnote/1", links);
+  BOOST_CHECK(graph.get_linking_notes("Missing").empty());
+  BOOST_CHECK(graph.get_linking_notes("Start Here").size() == 1);
+  BOOST_CHECK(graph.get_linking_notes("Other").count("note://gnote/1") == 1);
+
+  graph.remove_note("note://gnote/2");
+  BOOST_CHECK(!graph.contains("note://gnote/2"));
+  BOOST_CHECK(graph.get_linking_notes("Start Here").empty());
+  BOOST_CHECK(graph.get_links("note://gnote/2").empty());
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string>
+
+#include <boost/test/minimal.hpp>
+
+#include "noteorder.hpp"
+#include "base/macros.hpp"
+
+typedef gnote::NoteOrder<std::string, int> Order;
+
+std::string join(const Order & order)
+{
+  std::string result;
+  for(Order::List::const_iterator iter = order.list().begin(); iter != order.list().end(); ++iter) {
+    result += *iter;
+  }
+  return result;
+}
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  Order order;
+  order.add("note://gnote/1", 10, "a");
+  order.add("note://gnote/2", 30, "b");
+  order.add("note://gnote/3", 20, "c");
+  order.add("note://gnote/4", 20, "d");
+  BOOST_CHECK(order.size() == 4);
+  BOOST_CHECK(join(order) == "bcda");
+
+  // Saved note becomes the most recent one
+  order.update("note://gnote/1", 40);
+  BOOST_CHECK(join(order) == "abcd");
+  order.update("note://gnote/3", 20);
+  BOOST_CHECK(join(order) == "abdc");
+  order.update("note://gnote/2", 5);
+  BOOST_CHECK(join(order) == "adcb");
+  order.update("note://gnote/5", 50);
+  BOOST_CHECK(join(order) == "adcb");
+
+  order.remove("note://gnote/4");
+  order.remove("note://gnote/4");
+  BOOST_CHECK(join(order) == "acb");
+  order.add("note://gnote/3", 1, "e");
+  BOOST_CHECK(join(order) == "abe");
+  BOOST_CHECK(order.size() == 3);
+
+  // Moving notes keeps the list ordered
+  const int NUM_NOTES = 10000;
+  Order notes;
+  for(int i = 0; i < NUM_NOTES; ++i) {
+    notes.add(TO_STRING(i), (i * 7919) % NUM_NOTES, TO_STRING(i));
+  }
+  for(int i = 0; i < NUM_NOTES; ++i) {
+    notes.update(TO_STRING((i * 31) % NUM_NOTES), NUM_NOTES + i);
+  }
+  BOOST_CHECK(notes.size() == NUM_NOTES);
+  BOOST_CHECK(notes.list().front() == TO_STRING((NUM_NOTES - 1) * 31 % NUM_NOTES));
+  BOOST_CHECK(notes.list().back() == "0");
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <boost/test/minimal.hpp>
+#include <glibmm.h>
+
+#include "notesavequeue.hpp"
+#include "sharp/directory.hpp"
+#include "sharp/files.hpp"
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  gchar *tmp_dir = g_dir_make_tmp("gnote-test-XXXXXX", NULL);
+  BOOST_CHECK(tmp_dir != NULL);
+  std::string dir = tmp_dir;
+  g_free(tmp_dir);
+  std::string file = Glib::build_filename(dir, "note.note");
+
+  {
+    gnote::NoteSaveQueue queue;
+    gnote::NoteData data("note://gnote/1");
+    data.text() = "<note-content version=\"0.1\">Title\n\nBody</note-content>";
+
+    // Saves before the write are merged, the last one wins
+    for(int i = 0; i < 100; ++i) {
+      data.title() = Glib::ustring::compose("Title %1", i);
+      queue.queue(file, data);
+    }
+    queue.flush();
+    BOOST_CHECK(!queue.is_pending(file));
+    BOOST_CHECK(sharp::file_exists(file));
+    BOOST_CHECK(!sharp::file_exists(file + ".tmp"));
+
+    gnote::NoteData read("note://gnote/1");
+    gnote::NoteArchiver::read(file, read);
+    BOOST_CHECK(read.title() == "Title 99");
+    BOOST_CHECK(read.text() == data.text());
+
+    // Changes after queueing do not end up in the file
+    data.title() = "Queued";
+    queue.queue(file, data);
+    data.title() = "Not queued";
+    queue.flush();
+    gnote::NoteArchiver::read(file, read);
+    BOOST_CHECK(read.title() == "Queued");
+
+    queue.queue(file, data);
+    queue.cancel(file);
+    BOOST_CHECK(!queue.is_pending(file));
+    queue.flush();
+
+    // Destructor writes what is left
+    data.title() = "Last";
+    queue.queue(file, data);
+  }
+  gnote::NoteData read("note://gnote/1");
+  gnote::NoteArchiver::read(file, read);
+  BOOST_CHECK(read.title() == "Last");
+
+  sharp::file_delete(file);
+  sharp::directory_delete(dir, false);
+
+  return 0;
+}
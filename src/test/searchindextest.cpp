@@ -0,0 +1,131 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/minimal.hpp>
+
+#include "searchindex.hpp"
+
+namespace {
+
+gnote::TermIndex::UriSet find(const gnote::TermIndex & index, const std::string & word)
+{
+  std::vector<std::string> terms;
+  gnote::SearchIndex::tokenize(word, terms);
+  gnote::TermIndex::UriSet result;
+  index.find_word_candidates(terms, result);
+  return result;
+}
+
+bool found(const gnote::TermIndex & index, const std::string & word, const std::string & uri)
+{
+  gnote::TermIndex::UriSet result = find(index, word);
+  return result.find(uri) != result.end();
+}
+
+}
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  std::vector<std::string> terms;
+  gnote::SearchIndex::tokenize("Hello, World! Ąžuolas 42", terms);
+  BOOST_CHECK(terms.size() == 4);
+  BOOST_CHECK(terms[0] == "hello");
+  BOOST_CHECK(terms[1] == "world");
+  BOOST_CHECK(terms[2] == "ąžuolas");
+  BOOST_CHECK(terms[3] == "42");
+
+  gnote::TermIndex index;
+  index.add_note("note://gnote/1", "2014-01-01", "Start Here\n\nWelcome to Gnote");
+  index.add_note("note://gnote/2", "2014-01-02", "Using Links\n\nLinks in Gnote start with a title");
+  index.add_note("note://gnote/3", "2014-01-03", "Ąžuolas\n\nDidelis ąžuolas");
+
+  BOOST_CHECK(index.note_count() == 3);
+  BOOST_CHECK(index.note_length("note://gnote/1") == 5);
+  BOOST_CHECK(index.total_length() == 5 + 9 + 3);
+  BOOST_CHECK(index.change_date("note://gnote/2") == "2014-01-02");
+  BOOST_CHECK(index.change_date("note://gnote/4") == "");
+
+  // Words match anywhere in a term
+  BOOST_CHECK(find(index, "gnote").size() == 2);
+  BOOST_CHECK(found(index, "not", "note://gnote/1"));
+  BOOST_CHECK(found(index, "elcom", "note://gnote/1"));
+  BOOST_CHECK(found(index, "inks", "note://gnote/2"));
+  BOOST_CHECK(find(index, "start").size() == 2);
+  BOOST_CHECK(found(index, "žuol", "note://gnote/3"));
+  BOOST_CHECK(found(index, "ĄŽUOLAS", "note://gnote/3"));
+  BOOST_CHECK(find(index, "missing").empty());
+
+  // Phrases: first term ends a term, last one starts a term, the rest match whole terms
+  BOOST_CHECK(found(index, "to gno", "note://gnote/1"));
+  BOOST_CHECK(found(index, "elcome to", "note://gnote/1"));
+  BOOST_CHECK(found(index, "links in gnote start", "note://gnote/2"));
+  BOOST_CHECK(find(index, "elcom to").empty());
+  BOOST_CHECK(find(index, "to gnote start").empty());
+  BOOST_CHECK(find(index, "links gnote").empty());
+
+  // Replacing and removing notes drops terms no note has
+  index.add_note("note://gnote/1", "2014-02-01", "Start There");
+  BOOST_CHECK(index.change_date("note://gnote/1") == "2014-02-01");
+  BOOST_CHECK(find(index, "elcom").empty());
+  BOOST_CHECK(found(index, "here", "note://gnote/1"));
+  BOOST_CHECK(find(index, "gnote").size() == 1);
+  index.remove_note("note://gnote/2");
+  BOOST_CHECK(index.note_count() == 2);
+  BOOST_CHECK(find(index, "gnote").empty());
+  BOOST_CHECK(find(index, "inks").empty());
+  BOOST_CHECK(find(index, "start").size() == 1);
+  BOOST_CHECK(index.total_length() == 2 + 3);
+
+  // Written index reads back the same
+  std::ostringstream out;
+  index.write(out);
+  std::istringstream in(out.str());
+  gnote::TermIndex read_index;
+  BOOST_CHECK(read_index.read(in));
+  BOOST_CHECK(read_index.note_count() == 2);
+  BOOST_CHECK(read_index.total_length() == index.total_length());
+  BOOST_CHECK(read_index.note_length("note://gnote/3") == 3);
+  BOOST_CHECK(read_index.change_date("note://gnote/1") == "2014-02-01");
+  BOOST_CHECK(found(read_index, "ther", "note://gnote/1"));
+  BOOST_CHECK(found(read_index, "didelis ąž", "note://gnote/3"));
+  std::ostringstream out2;
+  read_index.write(out2);
+  BOOST_CHECK(out2.str() == out.str());
+
+  // Swapped indexes keep working
+  gnote::TermIndex swapped;
+  swapped.swap(read_index);
+  BOOST_CHECK(read_index.note_count() == 0);
+  BOOST_CHECK(find(read_index, "start").empty());
+  BOOST_CHECK(found(swapped, "start", "note://gnote/1"));
+  swapped.remove_note("note://gnote/1");
+  BOOST_CHECK(find(swapped, "start").empty());
+
+  std::istringstream bad("gnote-search-index 1\nT\tterm\t5:1\n");
+  BOOST_CHECK(!read_index.read(bad));
+  std::istringstream unknown("gnote-search-index 0\n");
+  BOOST_CHECK(!read_index.read(unknown));
+
+  return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * gnote
+ *
+ * Copyright (C) 2014 Aurimas Cernius
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/test/minimal.hpp>
+
+#include "searchrank.hpp"
+
+int test_main(int /*argc*/, char ** /*argv*/)
+{
+  gnote::Bm25 rank(1000, 100);
+  // Rare words weigh more
+  BOOST_CHECK(rank.idf(1) > rank.idf(10));
+  BOOST_CHECK(rank.idf(1000) > 0);
+  BOOST_CHECK(rank.idf(5000) == rank.idf(1000));
+  double idf = rank.idf(10);
+  BOOST_CHECK(rank.text_score(idf, 0, 100) == 0);
+  // More occurrences score more, but never more than idf * (K1 + 1)
+  BOOST_CHECK(rank.text_score(idf, 2, 100) > rank.text_score(idf, 1, 100));
+  BOOST_CHECK(rank.text_score(idf, 1000, 100) < idf * (gnote::Bm25::K1 + 1));
+  BOOST_CHECK(gnote::Bm25::TITLE_BOOST > gnote::Bm25::K1 + 1);
+  // Shorter notes with the same occurrences score more
+  BOOST_CHECK(rank.text_score(idf, 2, 50) > rank.text_score(idf, 2, 200));
+  gnote::Bm25 no_lengths(1000, 0);
+  BOOST_CHECK(no_lengths.text_score(idf, 2, 50) == no_lengths.text_score(idf, 2, 200));
+
+  std::vector<gnote::TopHits<std::string>::Hit> hits;
+  gnote::TopHits<std::string> top(3);
+  top.push(1, "a");
+  top.push(5, "b");
+  top.push(3, "c");
+  BOOST_CHECK(!top.truncated());
+  top.push(0.5, "d");
+  top.push(4, "e");
+  BOOST_CHECK(top.size() == 3);
+  BOOST_CHECK(top.truncated());
+  top.take_sorted(hits);
+  BOOST_CHECK(hits.size() == 3);
+  BOOST_CHECK(hits[0].second == "b");
+  BOOST_CHECK(hits[1].second == "e");
+  BOOST_CHECK(hits[2].second == "c");
+  BOOST_CHECK(top.size() == 0 && !top.truncated());
+
+  gnote::TopHits<std::string> all(0);
+  all.push(1, "a");
+  all.push(2, "b");
+  all.take_sorted(hits);
+  BOOST_CHECK(hits.size() == 2 && hits[0].second == "b");
+
+  // The best results of many hits are the highest scores, in order
+  const int NUM_HITS = 1000;
+  const size_t K = 20;
+  std::multimap<double, int> ordered;
+  gnote::TopHits<int> best(K);
+  for(int i = 0; i < NUM_HITS; ++i) {
+    double score = (i * 7919) % NUM_HITS / double(NUM_HITS);
+    ordered.insert(std::make_pair(score, i));
+    best.push(score, i);
+  }
+  std::vector<gnote::TopHits<int>::Hit> best_hits;
+  best.take_sorted(best_hits);
+  BOOST_CHECK(best_hits.size() == K);
+  std::multimap<double, int>::reverse_iterator expected = ordered.rbegin();
+  for(size_t i = 0; i < K && i < best_hits.size(); ++i, ++expected) {
+    BOOST_CHECK(best_hits[i].first == expected->first);
+  }
+
+  return 0;
+}
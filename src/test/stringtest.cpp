@@ -94,5 +94,55 @@ int test_main(int /*argc*/, char ** /*argv*/)
   BOOST_CHECK(string_last_index_of(test1, "ba") == 8);
   BOOST_CHECK(string_last_index_of(test1, "Camel") == -1);
 
+  BOOST_CHECK(string_contains_nocase(test4, "camelcase"));
+  BOOST_CHECK(string_contains_nocase("Grüße aus KÖLN", "köln"));
+  BOOST_CHECK(!string_contains_nocase(test4, "camels"));
+
+  // Long enough text for the vectorized scan, with matches in the
+  // blocks, across block boundaries and in the scalar tail
+  std::string text;
+  for(int i = 0; i < 20; ++i) {
+    text += "Lorem ipsum dolor sit amet, <bold>Consectetur</bold> adipiscing elit. ";
+  }
+  text += "Tail NEEDLE";
+  std::vector<std::string> needles;
+  needles.push_back("consectetur");
+  needles.push_back("needle");
+  needles.push_back("t, <");
+  needles.push_back("l");
+  needles.push_back("");
+  StringMatcher matcher(needles, false);
+  BOOST_CHECK(matcher.ascii_only());
+  BOOST_CHECK(matcher.contains_all(text));
+  std::vector<int> counts;
+  matcher.count(text, counts);
+  BOOST_CHECK(counts.size() == 5);
+  BOOST_CHECK(counts[0] == 20);
+  BOOST_CHECK(counts[1] == 1);
+  BOOST_CHECK(counts[2] == 20);
+  BOOST_CHECK(counts[3] == 20 * 5 + 2);
+  BOOST_CHECK(counts[4] == 0);
+  BOOST_CHECK(matcher.find(text, 1) == text.size() - 6);
+  BOOST_CHECK(matcher.find(text, 0, 40) == text.find("Consectetur", 40));
+  BOOST_CHECK(matcher.find(text, 1, text.size()) == std::string::npos);
+
+  StringMatcher case_matcher(needles, true);
+  BOOST_CHECK(!case_matcher.contains_all(text));
+  case_matcher.count(text, counts);
+  BOOST_CHECK(counts[0] == 0 && counts[1] == 0 && counts[2] == 20);
+
+  // Only ASCII letters match in other case, '@' is not '`'
+  needles.clear();
+  needles.push_back("`a");
+  StringMatcher symbol_matcher(needles, false);
+  BOOST_CHECK(!symbol_matcher.contains_all("@A @a"));
+  BOOST_CHECK(symbol_matcher.contains_all("@A `A"));
+
+  needles.clear();
+  needles.push_back("grüße");
+  StringMatcher utf8_matcher(needles, false);
+  BOOST_CHECK(!utf8_matcher.ascii_only());
+  BOOST_CHECK(utf8_matcher.contains_all("viele GRüße"));
+
   return 0;
 }
@@ -1,7 +1,9 @@
 
 
 #include <stdio.h>
+#include <set>
 #include <string>
+#include <vector>
 
 #include <boost/test/minimal.hpp>
 
@@ -42,7 +44,111 @@ int test_main(int /*argc*/, char ** /*argv*/)
     gnote::TrieHit<std::string>::Ptr hit(*hit_iter);
     printf ("*** Match: '%s' at %d-%d\n",
             hit->key().c_str(), hit->start(), hit->end());
+    BOOST_CHECK( src.substr(hit->byte_start(), hit->byte_end() - hit->byte_start()) == hit->key().raw() );
   }
+  BOOST_CHECK( matches->back()->start() == 72 );
+  BOOST_CHECK( matches->back()->byte_start() == 72 );
+  BOOST_CHECK( matches->back()->byte_end() == 90 );
   printf ("Search finished!\n");
+
+  // Removed keywords are no longer found, the others still are
+  trie.remove_keyword("bazar");
+  trie.remove_keyword("FOO");
+  trie.add_keyword("zar", "zar");
+  matches = trie.find_matches(src);
+  BOOST_CHECK( matches->size() == 13 );
+  for(gnote::TrieHit<std::string>::List::const_iterator hit_iter = matches->begin();
+      hit_iter != matches->end(); ++hit_iter) {
+    BOOST_CHECK( (*hit_iter)->value() != "bazar" );
+    BOOST_CHECK( (*hit_iter)->value() != "foo" );
+  }
+
+  // Keywords changed after the automaton is compiled are found the
+  // same way as by an automaton built from scratch
+  const char *words[] = { "a", "ab", "abc", "b", "bc", "bca", "cab", "aa", "aaa", "ca", "abca", "ąb", "bą" };
+  const int NUM_WORDS = sizeof(words) / sizeof(words[0]);
+  const std::string haystack = "abcabcaabcaaabbcab cab ąbąb Abca";
+  gnote::TrieTree<std::string> incremental(false);
+  incremental.compute_failure_graph();
+  std::set<std::string> present;
+  for(int step = 0; step < 400; ++step) {
+    std::string word = words[(step * 7 + step / 5) % NUM_WORDS];
+    if(present.erase(word)) {
+      incremental.remove_keyword(word);
+    }
+    else {
+      present.insert(word);
+      incremental.add_keyword(word, word);
+    }
+
+    gnote::TrieTree<std::string> rebuilt(false);
+    for(std::set<std::string>::const_iterator word_iter = present.begin(); word_iter != present.end(); ++word_iter) {
+      rebuilt.add_keyword(*word_iter, *word_iter);
+    }
+    rebuilt.compute_failure_graph();
+
+    gnote::TrieHit<std::string>::ListPtr expected = rebuilt.find_matches(haystack);
+    matches = incremental.find_matches(haystack);
+    BOOST_CHECK( matches->size() == expected->size() );
+    gnote::TrieHit<std::string>::List::const_iterator expected_iter = expected->begin();
+    for(iter = matches->begin(); iter != matches->end() && expected_iter != expected->end(); ++iter, ++expected_iter) {
+      BOOST_CHECK( (*iter)->start() == (*expected_iter)->start() );
+      BOOST_CHECK( (*iter)->end() == (*expected_iter)->end() );
+      BOOST_CHECK( (*iter)->value() == (*expected_iter)->value() );
+    }
+  }
+
+  // Case is folded the same way for keywords and text, even where
+  // folding the whole text would depend on the context
+  gnote::TrieTree<std::string> greek_trie(false);
+  greek_trie.add_keyword("ΟΔΟΣ", "road");
+  matches = greek_trie.find_matches("ΜΙΑ ΟΔΟΣ");
+  BOOST_CHECK( matches->size() == 1 );
+  BOOST_CHECK( matches->size() == 1 && matches->front()->start() == 4 );
+
+  // Many titles found at once, the same as searching for each of them,
+  // timings are only printed for reference
+  const int NUM_TITLES = 2000;
+  const char *syllables[] = { "ka", "lo", "mi", "ne", "su", "ta", "ri", "po" };
+  std::vector<std::string> titles;
+  for(int i = 0; i < NUM_TITLES; ++i) {
+    std::string title;
+    for(int n = i, j = 0; j < 6; n /= 8, ++j) {
+      title += syllables[n % 8];
+    }
+    titles.push_back(title);
+  }
+  std::string text;
+  for(int i = 0; i < NUM_TITLES; i += 250) {
+    text += "Some text with a link to " + titles[i] + ".\n";
+  }
+
+  Glib::Timer timer;
+  gnote::TrieTree<int> title_trie(false);
+  for(int i = 0; i < NUM_TITLES; ++i) {
+    title_trie.add_keyword(titles[i], i);
+  }
+  title_trie.compute_failure_graph();
+  double build_time = timer.elapsed();
+
+  timer.start();
+  gnote::TrieHit<int>::ListPtr title_matches(title_trie.find_matches(text));
+  double trie_time = timer.elapsed();
+
+  // Compare against searching for every title separately
+  timer.start();
+  std::vector<std::string>::size_type expected_matches = 0;
+  for(int i = 0; i < NUM_TITLES; ++i) {
+    for(std::string::size_type pos = text.find(titles[i]); pos != std::string::npos;
+        pos = text.find(titles[i], pos + 1)) {
+      ++expected_matches;
+    }
+  }
+  double naive_time = timer.elapsed();
+
+  BOOST_CHECK( title_matches->size() == expected_matches );
+  printf ("%d titles: build %.3fs, trie search %.4fs, per title search %.4fs\n",
+          NUM_TITLES, build_time, trie_time, naive_time);
+
   return 0;
 }
@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2013 Aurimas Cernius
+ * Copyright (C) 2013-2014 Aurimas Cernius
  * Copyright (C) 2011 Debarshi Ray
  * Copyright (C) 2009 Hubert Figuiere
  *
@@ -22,8 +22,9 @@
 #ifndef __TRIE_HPP_
 #define __TRIE_HPP_
 
-#include <list>
+#include <algorithm>
 #include <queue>
+#include <vector>
 
 #include <glibmm.h>
 
@@ -32,221 +33,273 @@
 
 namespace gnote {
 
+/**
+ * Aho-Corasick automaton for finding keywords in text.
+ *
+ * States are kept in a flat array and refer to each other by index.
+ * Transitions of all states are in a single table, every state has a
+ * range in it, sorted by value. compute_failure_graph() builds the
+ * failure links of all states at once, after keywords have been added
+ * in bulk. Once it is done, adding or removing a keyword only repairs
+ * the failure and output links of the states affected by the change.
+ */
 template<class value_t>
 class TrieTree
 {
 
 private:
 
-  class TrieState;
-  typedef shared_ptr<TrieState> TrieStatePtr;
-  typedef std::list<TrieStatePtr> TrieStateList;
-  typedef std::queue<TrieStatePtr> TrieStateQueue;
+  enum {
+    NO_STATE = -1,
+    ROOT_STATE = 0
+  };
 
-  class TrieState
+  struct Transition
   {
-  public:
-
-    TrieState(gunichar v, int d, const TrieStatePtr & s)
-      : m_value(v)
-      , m_depth(d)
-      , m_fail_state(s)
-      , m_transitions()
-      , m_payload()
-      , m_payload_present(false)
-    {
-    }
-
-    gunichar value() const
-    {
-      return m_value;
-    }
-
-    int depth() const
-    {
-      return m_depth;
-    }
-
-    TrieStatePtr fail_state()
-    {
-      return m_fail_state;
-    }
-
-    void fail_state(const TrieStatePtr & s)
-    {
-      m_fail_state = s;
-    }
-
-    TrieStateList & transitions()
-    {
-      return m_transitions;
-    }
-
-    value_t payload() const
+    Transition(gunichar v, int t)
+      : value(v)
+      , target(t)
     {
-      return m_payload;
     }
 
-    void payload(const value_t & p)
+    bool operator<(const Transition & other) const
     {
-      m_payload = p;
+      return value < other.value;
     }
 
-    bool payload_present() const
-    {
-      return m_payload_present;
-    }
+    gunichar value;
+    int target;
+  };
+  typedef std::vector<Transition> TransitionList;
 
-    void payload_present(bool pp)
+  struct TrieState
+  {
+    TrieState(int d)
+      : depth(d)
+      , fail_state(NO_STATE)
+      , output_state(NO_STATE)
+      , payload(NO_STATE)
+      , first_transition(0)
+      , transition_count(0)
+      , transition_capacity(0)
+      , fail_child(NO_STATE)
+      , fail_next(NO_STATE)
+      , fail_prev(NO_STATE)
     {
-      m_payload_present = pp;
     }
 
-  private:
-
-    gunichar m_value;
-    int m_depth;
-    TrieStatePtr m_fail_state;
-    TrieStateList m_transitions;
-    value_t m_payload;
-    bool m_payload_present;
+    // length of the matched text minus one, -1 for root
+    int depth;
+    int fail_state;
+    // closest state in the chain of fail states having a payload
+    int output_state;
+    int payload;
+    // range in the transition table, with room for capacity transitions
+    int first_transition;
+    int transition_count;
+    int transition_capacity;
+    // list of states failing to this one
+    int fail_child;
+    int fail_next;
+    int fail_prev;
   };
 
   const bool m_case_sensitive;
-  const TrieStatePtr m_root;
+  std::vector<TrieState> m_states;
+  // transitions of all states, sorted by value within each state
+  TransitionList m_transitions;
+  // transitions in use, the rest of the table is free room
+  size_t m_transition_count;
+  std::vector<value_t> m_payloads;
+  // states and payloads of removed keywords, reused for new ones
+  std::vector<int> m_free_states;
+  std::vector<int> m_free_payloads;
+  // whether failure links are valid
+  bool m_compiled;
+  // upper bound, it only drops when the automaton is compiled
   size_t m_max_length;
 
 public:
 
   TrieTree(bool case_sensitive)
     : m_case_sensitive(case_sensitive)
-    , m_root(new TrieState('\0', -1, TrieStatePtr()))
+    , m_transition_count(0)
+    , m_compiled(false)
     , m_max_length(0)
   {
+    m_states.push_back(TrieState(-1));
   }
 
   void add_keyword(const Glib::ustring & keyword, const value_t & pattern_id)
   {
-    TrieStatePtr current_state = m_root;
+    int current_state = ROOT_STATE;
+    int depth = 0;
 
-    for (Glib::ustring::size_type i = 0; i < keyword.size(); i++) {
-      gunichar c = keyword[i];
+    for (Glib::ustring::const_iterator iter = keyword.begin();
+         keyword.end() != iter; ++iter, ++depth) {
+      gunichar c = *iter;
       if (!m_case_sensitive)
         c = Glib::Unicode::tolower(c);
 
-      TrieStatePtr target_state = find_state_transition(current_state, c);
-      if (0 == target_state) {
-        target_state = TrieStatePtr(new TrieState(c, i, m_root));
-        current_state->transitions().push_front(target_state);
+      int next_state = find_state_transition(current_state, c);
+      if (NO_STATE == next_state) {
+        next_state = new_state(depth);
+        add_transition(current_state, c, next_state);
+        if (m_compiled)
+          link_new_state(current_state, c, next_state);
       }
-
-      current_state = target_state;
+      current_state = next_state;
     }
 
-    current_state->payload(pattern_id);
-    current_state->payload_present(true);
+    TrieState & state = m_states[current_state];
+    if (NO_STATE == state.payload) {
+      state.payload = new_payload(pattern_id);
+      if (m_compiled)
+        refresh_outputs(current_state);
+    }
+    else {
+      m_payloads[state.payload] = pattern_id;
+    }
     m_max_length = std::max(m_max_length, keyword.size());
   }
 
+  void remove_keyword(const Glib::ustring & keyword)
+  {
+    // States on the way from root to the keyword and the values leading to them
+    std::vector<int> path;
+    std::vector<gunichar> values;
+    path.push_back(ROOT_STATE);
+
+    for (Glib::ustring::const_iterator iter = keyword.begin();
+         keyword.end() != iter; ++iter) {
+      gunichar c = *iter;
+      if (!m_case_sensitive)
+        c = Glib::Unicode::tolower(c);
+
+      int next_state = find_state_transition(path.back(), c);
+      if (NO_STATE == next_state)
+        return;
+      path.push_back(next_state);
+      values.push_back(c);
+    }
+
+    int keyword_state = path.back();
+    int payload = m_states[keyword_state].payload;
+    if (NO_STATE == payload)
+      return;
+    m_states[keyword_state].payload = NO_STATE;
+    m_payloads[payload] = value_t();
+    m_free_payloads.push_back(payload);
+    if (m_compiled)
+      refresh_outputs(keyword_state);
+
+    // Drop states, that no longer lead to any keyword
+    for (std::vector<int>::size_type i = path.size() - 1; i > 0; --i) {
+      int current_state = path[i];
+      if (NO_STATE != m_states[current_state].payload
+          || 0 != m_states[current_state].transition_count)
+        break;
+
+      remove_transition(path[i - 1], values[i - 1]);
+      if (m_compiled)
+        unlink_state(current_state);
+      m_free_states.push_back(current_state);
+    }
+  }
+
   void compute_failure_graph()
   {
+    compact_states();
+
     // Failure state is computed breadth-first (-> Queue)
-    TrieStateQueue state_queue;
+    std::queue<int> state_queue;
 
     // For each direct child of the root state
     // * Set the fail state to the root state
     // * Enqueue the state for failure graph computing
-    for (typename TrieStateList::iterator iter = m_root->transitions().begin();
-         m_root->transitions().end() != iter; iter++) {
-      TrieStatePtr & transition = *iter;
-      transition->fail_state(m_root);
-      state_queue.push(transition);
+    const TrieState & root = m_states[ROOT_STATE];
+    for (int i = 0; i < root.transition_count; ++i) {
+      int child = m_transitions[root.first_transition + i].target;
+      set_fail_state(child, ROOT_STATE);
+      m_states[child].output_state = NO_STATE;
+      state_queue.push(child);
     }
 
     while (false == state_queue.empty()) {
       // Current state already has a valid fail state at this point
-      TrieStatePtr current_state = state_queue.front();
+      int current_state = state_queue.front();
       state_queue.pop();
 
-      for (typename TrieStateList::iterator iter
-             = current_state->transitions().begin();
-           current_state->transitions().end() != iter; iter++) {
-        TrieStatePtr & transition = *iter;
-        state_queue.push(transition);
+      const TrieState & current = m_states[current_state];
+      for (int i = 0; i < current.transition_count; ++i) {
+        const Transition & transition = m_transitions[current.first_transition + i];
+        state_queue.push(transition.target);
 
-        TrieStatePtr fail_state = current_state->fail_state();
-        while ((0 != fail_state)
-               && 0 == find_state_transition(fail_state, transition->value())) {
-          fail_state = fail_state->fail_state();
-        }
-
-        if (0 == fail_state)
-          transition->fail_state(m_root);
-        else
-          transition->fail_state(find_state_transition(fail_state, transition->value()));
+        int fail_state = find_fail_state(current_state, transition.value);
+        set_fail_state(transition.target, fail_state);
+        m_states[transition.target].output_state = output_of(fail_state);
       }
     }
-  }
-
-  static TrieStatePtr find_state_transition(const TrieStatePtr & state,
-                                            gunichar value)
-  {
-    if (true == state->transitions().empty())
-      return TrieStatePtr();
-
-    for (typename TrieStateList::const_iterator iter
-           = state->transitions().begin();
-         state->transitions().end() != iter; iter++) {
-      const TrieStatePtr & transition = *iter;
-      if (transition->value() == value)
-        return transition;
-
-    }
 
-    return TrieStatePtr();
+    m_compiled = true;
   }
 
   typename TrieHit<value_t>::ListPtr find_matches (const Glib::ustring & haystack)
   {
-    TrieStatePtr current_state = m_root;
+    if (!m_compiled)
+      compute_failure_graph();
+
+    int current_state = ROOT_STATE;
     typename TrieHit<value_t>::ListPtr matches(
       new typename TrieHit<value_t>::List());
-    int start_index = 0;
 
-    for (Glib::ustring::size_type i = 0; i < haystack.size(); i++) {
-      gunichar c = haystack[i];
+    const char *text = haystack.c_str();
+    const char *text_end = text + haystack.bytes();
+
+    // Byte offsets of the last characters, enough for the longest keyword
+    std::vector<int> byte_offsets(m_max_length + 1);
+
+    int char_index = 0;
+    for (const char *p = text; p < text_end; p = g_utf8_next_char(p), ++char_index) {
+      // Case is folded a character at a time, the same way as for keywords
+      gunichar c = g_utf8_get_char(p);
       if (!m_case_sensitive)
         c = Glib::Unicode::tolower(c);
-
-      if (current_state == m_root)
-        start_index = i;
+      byte_offsets[char_index % byte_offsets.size()] = p - text;
 
       // While there's no matching transition, follow the fail states
-      // Because we're potentially changing the depths (aka length of
-      // matched characters) in the tree we're updating the start_index
-      // accordingly
-      while ((current_state != m_root)
-             && 0 == find_state_transition(current_state, c)) {
-        TrieStatePtr old_state = current_state;
-        current_state = current_state->fail_state();
-        start_index += old_state->depth() - current_state->depth();
+      int next_state = find_state_transition(current_state, c);
+      while (NO_STATE == next_state && ROOT_STATE != current_state) {
+        current_state = m_states[current_state].fail_state;
+        next_state = find_state_transition(current_state, c);
       }
+      current_state = NO_STATE == next_state ? ROOT_STATE : next_state;
 
-      current_state = find_state_transition (current_state, c);
-      if (0 == current_state)
-        current_state = m_root;
-
-      // If the state contains a payload: We've got a hit
+      // If the state or any of it's suffixes contains a payload:
+      // We've got a hit.
       // Return a TrieHit with the start and end index, the matched
       // string and the payload object
-      if (current_state->payload_present()) {
-        int hit_length = i - start_index + 1;
+      int hit_state = current_state;
+      if (NO_STATE == m_states[hit_state].payload)
+        hit_state = m_states[hit_state].output_state;
+      if (NO_STATE == hit_state)
+        continue;
+
+      int byte_end = g_utf8_next_char(p) - text;
+      while (NO_STATE != hit_state) {
+        const TrieState & state = m_states[hit_state];
+        int hit_length = state.depth + 1;
+        int start_index = char_index + 1 - hit_length;
+        int byte_start = byte_offsets[start_index % byte_offsets.size()];
         typename TrieHit<value_t>::Ptr hit(
           new TrieHit<value_t>(start_index,
                                start_index + hit_length,
-                               haystack.substr(start_index, hit_length),
-                               current_state->payload()));
+                               byte_start,
+                               byte_end,
+                               haystack.raw().substr(byte_start, byte_end - byte_start),
+                               m_payloads[state.payload]));
         matches->push_back(hit);
+        hit_state = state.output_state;
       }
     }
 
@@ -258,6 +311,269 @@ public:
     return m_max_length;
   }
 
+private:
+
+  int new_state(int depth)
+  {
+    if (m_free_states.empty()) {
+      m_states.push_back(TrieState(depth));
+      return m_states.size() - 1;
+    }
+    int state = m_free_states.back();
+    m_free_states.pop_back();
+    m_states[state] = TrieState(depth);
+    return state;
+  }
+
+  int new_payload(const value_t & value)
+  {
+    if (m_free_payloads.empty()) {
+      m_payloads.push_back(value);
+      return m_payloads.size() - 1;
+    }
+    int payload = m_free_payloads.back();
+    m_free_payloads.pop_back();
+    m_payloads[payload] = value;
+    return payload;
+  }
+
+  void add_transition(int state, gunichar value, int target)
+  {
+    if (m_states[state].transition_count == m_states[state].transition_capacity) {
+      // Move the transitions to the end of the table, with room to grow
+      if (m_transitions.size() > 2 * m_transition_count + 64)
+        pack_transitions();
+      TrieState & s = m_states[state];
+      int first = m_transitions.size();
+      int capacity = std::max(2, 2 * s.transition_capacity);
+      m_transitions.resize(first + capacity, Transition(0, NO_STATE));
+      std::copy(m_transitions.begin() + s.first_transition,
+                m_transitions.begin() + s.first_transition + s.transition_count,
+                m_transitions.begin() + first);
+      s.first_transition = first;
+      s.transition_capacity = capacity;
+    }
+
+    TrieState & s = m_states[state];
+    typename TransitionList::iterator begin = m_transitions.begin() + s.first_transition;
+    typename TransitionList::iterator end = begin + s.transition_count;
+    typename TransitionList::iterator pos
+      = std::lower_bound(begin, end, Transition(value, NO_STATE));
+    std::copy_backward(pos, end, end + 1);
+    *pos = Transition(value, target);
+    ++s.transition_count;
+    ++m_transition_count;
+  }
+
+  void remove_transition(int state, gunichar value)
+  {
+    TrieState & s = m_states[state];
+    typename TransitionList::iterator begin = m_transitions.begin() + s.first_transition;
+    typename TransitionList::iterator end = begin + s.transition_count;
+    typename TransitionList::iterator pos
+      = std::lower_bound(begin, end, Transition(value, NO_STATE));
+    if (end == pos || pos->value != value)
+      return;
+    std::copy(pos + 1, end, pos);
+    --s.transition_count;
+    --m_transition_count;
+  }
+
+  // Lay out the transitions again without free room, in state order
+  void pack_transitions()
+  {
+    TransitionList transitions;
+    transitions.reserve(m_transition_count);
+    for (typename std::vector<TrieState>::size_type i = 0; i < m_states.size(); ++i) {
+      TrieState & state = m_states[i];
+      int first = transitions.size();
+      transitions.insert(transitions.end(),
+                         m_transitions.begin() + state.first_transition,
+                         m_transitions.begin() + state.first_transition + state.transition_count);
+      state.first_transition = first;
+      state.transition_capacity = state.transition_count;
+    }
+    m_transitions.swap(transitions);
+  }
+
+  // Renumber the states reachable from root in breadth-first order,
+  // dropping the ones left behind by removed keywords.
+  void compact_states()
+  {
+    std::vector<int> new_index(m_states.size(), NO_STATE);
+    std::vector<int> order;
+    order.reserve(m_states.size());
+    order.push_back(ROOT_STATE);
+    new_index[ROOT_STATE] = 0;
+    for (std::vector<int>::size_type i = 0; i < order.size(); ++i) {
+      const TrieState & state = m_states[order[i]];
+      for (int j = 0; j < state.transition_count; ++j) {
+        int target = m_transitions[state.first_transition + j].target;
+        new_index[target] = order.size();
+        order.push_back(target);
+      }
+    }
+
+    std::vector<TrieState> states;
+    states.reserve(order.size());
+    TransitionList transitions;
+    transitions.reserve(m_transition_count);
+    std::vector<value_t> payloads;
+    m_max_length = 0;
+    for (std::vector<int>::size_type i = 0; i < order.size(); ++i) {
+      const TrieState & old_state = m_states[order[i]];
+      TrieState state(old_state.depth);
+      if (NO_STATE != old_state.payload) {
+        payloads.push_back(m_payloads[old_state.payload]);
+        state.payload = payloads.size() - 1;
+        m_max_length = std::max(m_max_length, size_t(state.depth + 1));
+      }
+      state.first_transition = transitions.size();
+      state.transition_count = old_state.transition_count;
+      state.transition_capacity = old_state.transition_count;
+      for (int j = 0; j < old_state.transition_count; ++j) {
+        const Transition & transition = m_transitions[old_state.first_transition + j];
+        transitions.push_back(Transition(transition.value, new_index[transition.target]));
+      }
+      states.push_back(state);
+    }
+
+    m_states.swap(states);
+    m_transitions.swap(transitions);
+    m_payloads.swap(payloads);
+    m_free_states.clear();
+    m_free_payloads.clear();
+  }
+
+  // Longest suffix of the text of the state reached from %parent by
+  // %value, that has a state of its own
+  int find_fail_state(int parent, gunichar value) const
+  {
+    if (ROOT_STATE == parent)
+      return ROOT_STATE;
+
+    int fail_state = m_states[parent].fail_state;
+    int target = find_state_transition(fail_state, value);
+    while (NO_STATE == target && ROOT_STATE != fail_state) {
+      fail_state = m_states[fail_state].fail_state;
+      target = find_state_transition(fail_state, value);
+    }
+    return NO_STATE == target ? ROOT_STATE : target;
+  }
+
+  int output_of(int state) const
+  {
+    return NO_STATE != m_states[state].payload ? state : m_states[state].output_state;
+  }
+
+  void set_fail_state(int state, int fail_state)
+  {
+    TrieState & s = m_states[state];
+    if (NO_STATE != s.fail_prev)
+      m_states[s.fail_prev].fail_next = s.fail_next;
+    else if (NO_STATE != s.fail_state && m_states[s.fail_state].fail_child == state)
+      m_states[s.fail_state].fail_child = s.fail_next;
+    if (NO_STATE != s.fail_next)
+      m_states[s.fail_next].fail_prev = s.fail_prev;
+
+    s.fail_state = fail_state;
+    s.fail_prev = NO_STATE;
+    s.fail_next = m_states[fail_state].fail_child;
+    if (NO_STATE != s.fail_next)
+      m_states[s.fail_next].fail_prev = state;
+    m_states[fail_state].fail_child = state;
+  }
+
+  // Set up failure links for %state, just added as a transition on
+  // %value from %parent, and fix the links of states, that now have
+  // %state as their longest suffix.
+  void link_new_state(int parent, gunichar value, int state)
+  {
+    int fail_state = find_fail_state(parent, value);
+    set_fail_state(state, fail_state);
+    m_states[state].output_state = output_of(fail_state);
+
+    // Such states are reached by %value from states, whose text ends
+    // with the text of %parent, that is states failing to %parent.
+    // Where a transition on %value exists, the states failing further
+    // down already have a longer suffix.
+    std::vector<int> stack;
+    for (int child = m_states[parent].fail_child; NO_STATE != child; child = m_states[child].fail_next)
+      stack.push_back(child);
+    while (false == stack.empty()) {
+      int current_state = stack.back();
+      stack.pop_back();
+
+      int target = find_state_transition(current_state, value);
+      if (NO_STATE == target) {
+        for (int child = m_states[current_state].fail_child; NO_STATE != child;
+             child = m_states[child].fail_next)
+          stack.push_back(child);
+        continue;
+      }
+      if (m_states[m_states[target].fail_state].depth < m_states[state].depth) {
+        set_fail_state(target, state);
+        m_states[target].output_state = output_of(state);
+        refresh_outputs(target);
+      }
+    }
+  }
+
+  // Drop %state, that has neither payload nor transitions, from the
+  // failure links. States failing to it fail to its own fail state now.
+  void unlink_state(int state)
+  {
+    int fail_state = m_states[state].fail_state;
+    while (NO_STATE != m_states[state].fail_child)
+      set_fail_state(m_states[state].fail_child, fail_state);
+
+    TrieState & s = m_states[state];
+    if (NO_STATE != s.fail_prev)
+      m_states[s.fail_prev].fail_next = s.fail_next;
+    else if (m_states[fail_state].fail_child == state)
+      m_states[fail_state].fail_child = s.fail_next;
+    if (NO_STATE != s.fail_next)
+      m_states[s.fail_next].fail_prev = s.fail_prev;
+    s.fail_state = NO_STATE;
+    s.fail_next = NO_STATE;
+    s.fail_prev = NO_STATE;
+  }
+
+  // Update output states of the states failing to %state, after
+  // output_of(%state) has changed
+  void refresh_outputs(int state)
+  {
+    std::vector<int> stack(1, state);
+    while (false == stack.empty()) {
+      int current_state = stack.back();
+      stack.pop_back();
+
+      int output_state = output_of(current_state);
+      for (int child = m_states[current_state].fail_child; NO_STATE != child;
+           child = m_states[child].fail_next) {
+        TrieState & s = m_states[child];
+        if (s.output_state != output_state) {
+          s.output_state = output_state;
+          if (NO_STATE == s.payload)
+            stack.push_back(child);
+        }
+      }
+    }
+  }
+
+  int find_state_transition(int state, gunichar value) const
+  {
+    const TrieState & s = m_states[state];
+    typename TransitionList::const_iterator begin = m_transitions.begin() + s.first_transition;
+    typename TransitionList::const_iterator end = begin + s.transition_count;
+    typename TransitionList::const_iterator iter
+      = std::lower_bound(begin, end, Transition(value, NO_STATE));
+    if (end != iter && iter->value == value)
+      return iter->target;
+
+    return NO_STATE;
+  }
+
 };
 
 }
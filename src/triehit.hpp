@@ -1,7 +1,7 @@
 /*
  * gnote
  *
- * Copyright (C) 2013 Aurimas Cernius
+ * Copyright (C) 2013-2014 Aurimas Cernius
  * Copyright (C) 2011 Debarshi Ray
  * Copyright (C) 2009 Hubert Figuiere
  *
@@ -41,6 +41,18 @@ public:
   TrieHit(int s, int e, const Glib::ustring & k, const value_t & v)
     : m_start(s)
     , m_end(e)
+    , m_byte_start(-1)
+    , m_byte_end(-1)
+    , m_key(k)
+    , m_value(v)
+    {
+    }
+
+  TrieHit(int s, int e, int bs, int be, const Glib::ustring & k, const value_t & v)
+    : m_start(s)
+    , m_end(e)
+    , m_byte_start(bs)
+    , m_byte_end(be)
     , m_key(k)
     , m_value(v)
     {
@@ -56,6 +68,17 @@ public:
     return m_end;
   }
 
+  // byte offsets in the searched text, -1 if unknown
+  int byte_start() const
+  {
+    return m_byte_start;
+  }
+
+  int byte_end() const
+  {
+    return m_byte_end;
+  }
+
   Glib::ustring key() const
   {
     return m_key;
@@ -70,6 +93,8 @@ private:
 
   int           m_start;
   int           m_end;
+  int           m_byte_start;
+  int           m_byte_end;
   Glib::ustring m_key;
   value_t       m_value;
 };
@@ -25,6 +25,7 @@
 #endif
 
 #include <string.h>
+#include <typeinfo>
 
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
@@ -39,7 +40,9 @@
 #include "notemanager.hpp"
 #include "notewindow.hpp"
 #include "preferences.hpp"
+#include "addinmanager.hpp"
 #include "itagmanager.hpp"
+#include "searchindex.hpp"
 #include "triehit.hpp"
 #include "watchers.hpp"
 
@@ -729,15 +732,14 @@ namespace gnote {
   }
 
 
-  void NoteLinkWatcher::initialize ()
+  NoteAddinManagerHook * NoteLinkWatcher::create_manager_hook(NoteManager & manager)
   {
-    m_on_note_deleted_cid = manager().signal_note_deleted.connect(
-      sigc::mem_fun(*this, &NoteLinkWatcher::on_note_deleted));
-    m_on_note_added_cid = manager().signal_note_added.connect(
-      sigc::mem_fun(*this, &NoteLinkWatcher::on_note_added));
-    m_on_note_renamed_cid = manager().signal_note_renamed.connect(
-      sigc::mem_fun(*this, &NoteLinkWatcher::on_note_renamed));
+    return new NoteLinkWatcherHook(manager);
+  }
+
 
+  void NoteLinkWatcher::initialize ()
+  {
     m_link_tag = get_note()->get_tag_table()->get_link_tag();
     m_broken_link_tag = get_note()->get_tag_table()->get_broken_link_tag();
   }
@@ -745,9 +747,6 @@ namespace gnote {
 
   void NoteLinkWatcher::shutdown ()
   {
-    m_on_note_deleted_cid.disconnect();
-    m_on_note_added_cid.disconnect();
-    m_on_note_renamed_cid.disconnect();
   }
 
 
@@ -775,39 +774,14 @@ namespace gnote {
   }
 
   
-  bool NoteLinkWatcher::contains_text(const Glib::ustring & text)
+  void NoteLinkWatcher::on_note_added(const NoteBase::Ptr &)
   {
-    Glib::ustring body = get_note()->text_content().lowercase();
-    Glib::ustring match = text.lowercase();
-
-    return sharp::string_index_of(body, match) > -1;
-  }
-
-
-  void NoteLinkWatcher::on_note_added(const NoteBase::Ptr & added)
-  {
-    if (added == get_note()) {
-      return;
-    }
-
-    if (!contains_text (added->get_title())) {
-      return;
-    }
-
     // Highlight previously unlinked text
     highlight_in_block (get_buffer()->begin(), get_buffer()->end());
   }
 
   void NoteLinkWatcher::on_note_deleted(const NoteBase::Ptr & deleted)
   {
-    if (deleted == get_note()) {
-      return;
-    }
-
-    if (!contains_text (deleted->get_title())) {
-      return;
-    }
-
     std::string old_title_lower = deleted->get_title().lowercase();
 
     // Turn all link:internal to link:broken for the deleted note.
@@ -823,16 +797,10 @@ namespace gnote {
   }
 
 
-  void NoteLinkWatcher::on_note_renamed(const NoteBase::Ptr& renamed, const Glib::ustring& /*old_title*/)
+  void NoteLinkWatcher::on_note_renamed(const NoteBase::Ptr& renamed)
   {
-    if (renamed == get_note()) {
-      return;
-    }
-
     // Highlight previously unlinked text
-    if (contains_text (renamed->get_title())) {
-      highlight_note_in_block(static_pointer_cast<Note>(renamed), get_buffer()->begin(), get_buffer()->end());
-    }
+    highlight_note_in_block(static_pointer_cast<Note>(renamed), get_buffer()->begin(), get_buffer()->end());
   }
 
   
@@ -1031,6 +999,94 @@ namespace gnote {
   }
 
 
+  NoteLinkWatcherHook::NoteLinkWatcherHook(NoteManager & manager)
+    : m_manager(manager)
+  {
+    m_on_note_deleted_cid = m_manager.signal_note_deleted.connect(
+      sigc::mem_fun(*this, &NoteLinkWatcherHook::on_note_deleted));
+    m_on_note_added_cid = m_manager.signal_note_added.connect(
+      sigc::mem_fun(*this, &NoteLinkWatcherHook::on_note_added));
+    m_on_note_renamed_cid = m_manager.signal_note_renamed.connect(
+      sigc::mem_fun(*this, &NoteLinkWatcherHook::on_note_renamed));
+  }
+
+
+  NoteLinkWatcherHook::~NoteLinkWatcherHook()
+  {
+    m_on_note_deleted_cid.disconnect();
+    m_on_note_added_cid.disconnect();
+    m_on_note_renamed_cid.disconnect();
+  }
+
+
+  bool NoteLinkWatcherHook::contains_text(const NoteBase::Ptr & note, const Glib::ustring & text)
+  {
+    return sharp::string_contains_nocase(note->text_content(), text);
+  }
+
+
+  void NoteLinkWatcherHook::get_watchers(const NoteBase::Ptr & changed,
+                                         std::list<NoteLinkWatcher*> & watchers)
+  {
+    AddinManager & addin_manager = m_manager.get_addin_manager();
+    const std::string id = typeid(NoteLinkWatcher).name();
+    // Notes in memory can have changes, that are not indexed yet, the rest
+    // is only read, if the index says, that it might contain the title
+    SearchIndex::UriSet indexed;
+    std::vector<std::string> words(1, changed->get_title());
+    bool use_index = m_manager.search_index().find_candidates(words, indexed);
+    // Addins are only loaded for notes, where links have to change
+    NoteBase::List notes(m_manager.get_notes());
+    FOREACH(const NoteBase::Ptr & note, notes) {
+      if(note == changed) {
+        continue;
+      }
+      if(use_index && !note->is_body_loaded() && indexed.find(note->uri()) == indexed.end()) {
+        continue;
+      }
+      if(!contains_text(note, changed->get_title())) {
+        continue;
+      }
+      Note::Ptr n = static_pointer_cast<Note>(note);
+      addin_manager.load_addins_for_note(n);
+      NoteLinkWatcher *watcher = dynamic_cast<NoteLinkWatcher*>(addin_manager.get_note_addin(n, id));
+      if(watcher) {
+        watchers.push_back(watcher);
+      }
+    }
+  }
+
+
+  void NoteLinkWatcherHook::on_note_added(const NoteBase::Ptr & added)
+  {
+    std::list<NoteLinkWatcher*> watchers;
+    get_watchers(added, watchers);
+    FOREACH(NoteLinkWatcher *watcher, watchers) {
+      watcher->on_note_added(added);
+    }
+  }
+
+
+  void NoteLinkWatcherHook::on_note_deleted(const NoteBase::Ptr & deleted)
+  {
+    std::list<NoteLinkWatcher*> watchers;
+    get_watchers(deleted, watchers);
+    FOREACH(NoteLinkWatcher *watcher, watchers) {
+      watcher->on_note_deleted(deleted);
+    }
+  }
+
+
+  void NoteLinkWatcherHook::on_note_renamed(const NoteBase::Ptr & renamed, const Glib::ustring &)
+  {
+    std::list<NoteLinkWatcher*> watchers;
+    get_watchers(renamed, watchers);
+    FOREACH(NoteLinkWatcher *watcher, watchers) {
+      watcher->on_note_renamed(renamed);
+    }
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
 
   // This is a PCRE regex.
@@ -1295,6 +1351,11 @@ namespace gnote {
     return new NoteTagsWatcher();
   }
 
+  NoteAddinManagerHook * NoteTagsWatcher::create_manager_hook(NoteManager & manager)
+  {
+    return new NoteTagsWatcherHook(manager);
+  }
+
 
   void NoteTagsWatcher::initialize ()
   {
@@ -1304,8 +1365,6 @@ namespace gnote {
     m_on_tag_removing_cid = get_note()->signal_tag_removing.connect(
       sigc::mem_fun(*this, &NoteTagsWatcher::on_tag_removing));
 #endif
-    m_on_tag_removed_cid = get_note()->signal_tag_removed.connect(
-      sigc::mem_fun(*this, &NoteTagsWatcher::on_tag_removed));      
   }
 
 
@@ -1313,7 +1372,6 @@ namespace gnote {
   {
     m_on_tag_added_cid.disconnect();
     m_on_tag_removing_cid.disconnect();
-    m_on_tag_removed_cid.disconnect();
   }
 
 
@@ -1340,7 +1398,20 @@ namespace gnote {
 #endif
 
 
-  void NoteTagsWatcher::on_tag_removed(const NoteBase::Ptr&, const std::string& tag_name)
+  NoteTagsWatcherHook::NoteTagsWatcherHook(NoteManager & manager)
+  {
+    m_on_tag_removed_cid = manager.signal_note_tag_removed.connect(
+      sigc::mem_fun(*this, &NoteTagsWatcherHook::on_tag_removed));
+  }
+
+
+  NoteTagsWatcherHook::~NoteTagsWatcherHook()
+  {
+    m_on_tag_removed_cid.disconnect();
+  }
+
+
+  void NoteTagsWatcherHook::on_tag_removed(const NoteBase::Ptr&, const std::string& tag_name)
   {
     Tag::Ptr tag = ITagManager::obj().get_tag(tag_name);
     DBG_OUT ("Watchers.OnTagRemoved popularity count: %d", tag ? tag->popularity() : 0);
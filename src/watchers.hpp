@@ -181,11 +181,14 @@ namespace gnote {
     virtual void shutdown() override;
     virtual void on_note_opened() override;
 
+    static NoteAddinManagerHook * create_manager_hook(NoteManager & manager);
+
   private:
-    bool contains_text(const Glib::ustring & text);
+    friend class NoteLinkWatcherHook;
+
     void on_note_added(const NoteBase::Ptr &);
     void on_note_deleted(const NoteBase::Ptr &);
-    void on_note_renamed(const NoteBase::Ptr&, const Glib::ustring&);
+    void on_note_renamed(const NoteBase::Ptr&);
     void do_highlight(const TrieHit<NoteBase::WeakPtr> & , const Gtk::TextIter &,const Gtk::TextIter &);
     void highlight_note_in_block (const NoteBase::Ptr &, const Gtk::TextIter &,
                                   const Gtk::TextIter &);
@@ -205,10 +208,32 @@ namespace gnote {
     NoteTag::Ptr m_link_tag;
     NoteTag::Ptr m_broken_link_tag;
 
+    static bool s_text_event_connected;
+  };
+
+
+  /**
+   * Updates links in all notes, when notes are added, deleted or renamed.
+   * NoteLinkWatcher is only created for notes containing the title,
+   * notes not in memory are looked up in the search index.
+   */
+  class NoteLinkWatcherHook
+    : public NoteAddinManagerHook
+  {
+  public:
+    NoteLinkWatcherHook(NoteManager & manager);
+    ~NoteLinkWatcherHook();
+  private:
+    static bool contains_text(const NoteBase::Ptr & note, const Glib::ustring & text);
+    void on_note_added(const NoteBase::Ptr &);
+    void on_note_deleted(const NoteBase::Ptr &);
+    void on_note_renamed(const NoteBase::Ptr&, const Glib::ustring&);
+    void get_watchers(const NoteBase::Ptr & changed, std::list<NoteLinkWatcher*> & watchers);
+
+    NoteManager & m_manager;
     sigc::connection m_on_note_deleted_cid;
     sigc::connection m_on_note_added_cid;
     sigc::connection m_on_note_renamed_cid;
-    static bool s_text_event_connected;
   };
 
 
@@ -271,6 +296,7 @@ namespace gnote {
   {
   public:
     static NoteAddin * create();
+    static NoteAddinManagerHook * create_manager_hook(NoteManager & manager);
     virtual void initialize() override;
     virtual void shutdown() override;
     virtual void on_note_opened() override;
@@ -278,10 +304,24 @@ namespace gnote {
   private:
     void on_tag_added(const NoteBase&, const Tag::Ptr&);
     void on_tag_removing(const NoteBase&, const Tag &);
-    void on_tag_removed(const NoteBase::Ptr&, const std::string&);
 
     sigc::connection m_on_tag_added_cid;
     sigc::connection m_on_tag_removing_cid;
+  };
+
+
+  /**
+   * Removes tags, that are no longer used by any note.
+   */
+  class NoteTagsWatcherHook
+    : public NoteAddinManagerHook
+  {
+  public:
+    NoteTagsWatcherHook(NoteManager & manager);
+    ~NoteTagsWatcherHook();
+  private:
+    void on_tag_removed(const NoteBase::Ptr&, const std::string&);
+
     sigc::connection m_on_tag_removed_cid;
   };
 